@@ -0,0 +1,272 @@
+#include "artin.h"
+#include "metrics.h"
+#include "modarith.h"
+#include "sieve.h"
+#include "simd.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    const uint64_t firstReport = 1 << 20;      // Density lines at 2^20, 2^21, ... and the limit
+    const unsigned maxPrimeFactors = 15;       // Distinct primes of any 64-bit p - 1
+    const double artinConstant = 0.3739558136192023;
+
+    MetricCounter &primesMetric = metricCounter("sh_artin_primes", "Primes checked by the Artin search.");
+
+    // Scratch of one worker for one segment: the primes of each p - 1
+    struct SegmentScratch
+    {
+        std::vector<int32_t> slot;       // Segment position -> index in primes, or -1
+        std::vector<uint64_t> rest;      // Unfactored part of p - 1
+        std::vector<uint64_t> factors;   // maxPrimeFactors entries per prime, ascending
+        std::vector<uint8_t> factorCount;
+        std::vector<uint8_t> next;       // Next factor to test; factorCount[j] + 1 once rejected
+        std::vector<uint32_t> owners, bases, moduli, exponents;
+        std::vector<uint8_t> results;
+    };
+
+    // Is base^exponent == 1 (mod modulus) for an odd modulus in [3, 2^64)?
+    bool powerIsOne(const Montgomery64 &arithmetic, uint64_t base, uint64_t exponent)
+    {
+        uint64_t result = arithmetic.one, square = arithmetic.convertIn(base);
+        for (; exponent; exponent >>= 1)
+        {
+            if (exponent & 1)
+                result = arithmetic.multiply(result, square);
+            square = arithmetic.multiply(square, square);
+        }
+        return arithmetic.convertOut(result) == 1;
+    }
+
+    // Matches among the odd primes of [low, high) (low odd, high <= limit + 1)
+    void searchSegment(uint64_t base, uint64_t low, uint64_t high, const std::vector<uint64_t> &primes,
+                       const std::vector<uint32_t> &sievingPrimes, SegmentScratch &scratch, std::vector<uint64_t> &matches,
+                       SimdLevel level)
+    {
+        uint64_t odds = (high - low + 1) / 2;
+        scratch.slot.assign(odds, -1);
+        size_t count = primes.size();
+        for (size_t j = 0; j < count; ++j)
+            scratch.slot[(primes[j] - low) / 2] = static_cast<int32_t>(j);
+        scratch.rest.resize(count);
+        scratch.factors.resize(count * maxPrimeFactors);
+        scratch.factorCount.assign(count, 1);
+        for (size_t j = 0; j < count; ++j)
+        {
+            uint64_t even = primes[j] - 1;
+            scratch.rest[j] = even >> __builtin_ctzll(even);
+            scratch.factors[j * maxPrimeFactors] = 2;
+        }
+
+        // p - 1 = low - 1 + 2i is a multiple of the odd prime q when i = (1 - low) / 2 (mod q)
+        for (uint32_t q : sievingPrimes)
+        {
+            if (static_cast<uint64_t>(q) * q > high)
+                break;
+            uint64_t first = (q - (low - 1) % q) % q * ((q + 1) / 2) % q;
+            for (uint64_t i = first; i < odds; i += q)
+            {
+                int32_t j = scratch.slot[i];
+                if (j < 0)
+                    continue;
+                scratch.factors[j * maxPrimeFactors + scratch.factorCount[j]++] = q;
+                do
+                    scratch.rest[j] /= q;
+                while (scratch.rest[j] % q == 0);
+            }
+        }
+        for (size_t j = 0; j < count; ++j)
+        {
+            if (scratch.rest[j] > 1)
+                scratch.factors[j * maxPrimeFactors + scratch.factorCount[j]++] = scratch.rest[j];
+        }
+
+        // One round per factor position, asking only the primes still in the running
+        scratch.next.assign(count, 0);
+        for (size_t j = 0; j < count; ++j)
+        {
+            if (base % primes[j] == 0)
+                scratch.next[j] = scratch.factorCount[j] + 1;
+        }
+        for (unsigned round = 0; round < maxPrimeFactors; ++round)
+        {
+            scratch.owners.clear();
+            scratch.bases.clear();
+            scratch.moduli.clear();
+            scratch.exponents.clear();
+            for (size_t j = 0; j < count; ++j)
+            {
+                if (scratch.next[j] != round || round >= scratch.factorCount[j])
+                    continue;
+                uint64_t p = primes[j];
+                uint64_t exponent = (p - 1) / scratch.factors[j * maxPrimeFactors + round];
+                if (p < (1ull << 32))
+                {
+                    scratch.owners.push_back(static_cast<uint32_t>(j));
+                    scratch.bases.push_back(static_cast<uint32_t>(base % p));
+                    scratch.moduli.push_back(static_cast<uint32_t>(p));
+                    scratch.exponents.push_back(static_cast<uint32_t>(exponent));
+                }
+                else if (!powerIsOne(Montgomery64(p), base % p, exponent))
+                    scratch.next[j] = round + 1;
+                else
+                    scratch.next[j] = scratch.factorCount[j] + 1;
+            }
+            if (scratch.owners.empty())
+                continue;
+            scratch.results.resize(scratch.owners.size());
+            powEqualsOneAcrossModuli(scratch.bases.data(), scratch.moduli.data(), scratch.exponents.data(), scratch.owners.size(),
+                                     scratch.results.data(), level);
+            for (size_t k = 0; k < scratch.owners.size(); ++k)
+            {
+                uint32_t j = scratch.owners[k];
+                scratch.next[j] = scratch.results[k] ? scratch.factorCount[j] + 1 : round + 1;
+            }
+        }
+        for (size_t j = 0; j < count; ++j)
+        {
+            if (scratch.next[j] == scratch.factorCount[j])
+                matches.push_back(primes[j]);
+        }
+        primesMetric.add(count);
+    }
+
+    // Finished segments waiting for every earlier one, so the stream stays in order
+    struct ArtinProgress
+    {
+        std::mutex mutex;
+        std::ofstream file;
+        bool toFile = false;
+        bool failed = false;
+        std::map<uint64_t, std::pair<std::vector<uint64_t>, uint64_t>> pending; // Segment -> matches, primes
+        uint64_t flushed = 0;
+        uint64_t primes = 0;
+        uint64_t matches = 0;
+        uint64_t nextReport = firstReport;
+    };
+
+    void appendDensity(std::string &text, uint64_t base, uint64_t bound, const ArtinProgress &progress)
+    {
+        double density = progress.primes ? static_cast<double>(progress.matches) / static_cast<double>(progress.primes) : 0.0;
+        text += "# p <= " + std::to_string(bound) + ": " + std::to_string(progress.primes) + " primes, " +
+                std::to_string(progress.matches) + " with " + std::to_string(base) + " as a primitive root, density " +
+                std::to_string(density) + "\n";
+    }
+
+    bool writeText(ArtinProgress &progress, const std::string &text)
+    {
+        TraceSpan span("write", "io");
+        if (progress.toFile)
+            progress.file << text;
+        else
+            std::cout << text;
+        statAdd(STAT_BYTES_WRITTEN, text.size());
+        return progress.toFile ? static_cast<bool>(progress.file) : static_cast<bool>(std::cout);
+    }
+
+    // Caller holds progress.mutex
+    void flushArtinPrefix(ArtinProgress &progress, uint64_t base, uint64_t low, uint64_t limit, uint64_t segments)
+    {
+        std::string text;
+        for (auto found = progress.pending.find(progress.flushed); found != progress.pending.end();
+             found = progress.pending.find(progress.flushed))
+        {
+            for (uint64_t p : found->second.first)
+            {
+                text += std::to_string(p);
+                text += '\n';
+            }
+            progress.primes += found->second.second;
+            progress.matches += found->second.first.size();
+            progress.pending.erase(found);
+            ++progress.flushed;
+            uint64_t covered = low + progress.flushed * sieveSegmentSpan - 1;
+            if (progress.nextReport < limit && covered >= progress.nextReport)
+            {
+                appendDensity(text, base, covered, progress);
+                while (progress.nextReport <= covered)
+                    progress.nextReport *= 2;
+            }
+            if (progress.flushed == segments)
+                appendDensity(text, base, limit, progress);
+        }
+        if (!text.empty() && !writeText(progress, text))
+            progress.failed = true;
+    }
+}
+
+int runArtinSearch(const ArtinOptions &options)
+{
+    if (options.limit < 2 || options.limit > maxArtinLimit)
+    {
+        std::cout << "\033[31mThe search limit must be between 2 and 2^50.\033[0m\n";
+        return 1;
+    }
+    ArtinProgress progress;
+    progress.toFile = !options.outputPath.empty();
+    if (progress.toFile)
+    {
+        progress.file.open(options.outputPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!progress.file)
+        {
+            std::cout << "\033[31mCannot open output file " << options.outputPath << ".\033[0m\n";
+            return 1;
+        }
+    }
+
+    PrimeSieve sieve(options.limit);
+
+    // 2 is the one even prime: base is a primitive root of 2 when it is odd
+    if (options.base & 1)
+    {
+        progress.matches = 1;
+        if (!writeText(progress, "2\n"))
+            progress.failed = true;
+    }
+    progress.primes = 1;
+
+    const uint64_t low = 3;
+    uint64_t segments = options.limit >= low ? (options.limit - low) / sieveSegmentSpan + 1 : 0;
+    SimdLevel level = activeSimdLevel();
+    std::vector<SegmentScratch> scratch(sharedThreadPool().size());
+    sieve.forEachSegment(low, options.limit, [&](uint64_t segment, const std::vector<uint64_t> &primes, unsigned worker)
+    {
+        TraceSpan span("segment", "artin");
+        uint64_t segmentLow = low + segment * sieveSegmentSpan;
+        uint64_t segmentHigh = std::min(segmentLow + sieveSegmentSpan, options.limit + 1);
+        std::vector<uint64_t> matches;
+        searchSegment(options.base, segmentLow, segmentHigh, primes, sieve.sievingPrimes(), scratch[worker], matches, level);
+
+        std::lock_guard<std::mutex> lock(progress.mutex);
+        progress.pending.emplace(segment, std::make_pair(std::move(matches), static_cast<uint64_t>(primes.size())));
+        flushArtinPrefix(progress, options.base, low, options.limit, segments);
+    });
+
+    if (segments == 0)
+    {
+        std::string text;
+        appendDensity(text, options.base, options.limit, progress);
+        if (!writeText(progress, text))
+            progress.failed = true;
+    }
+    if (progress.failed || progress.flushed != segments)
+    {
+        std::cout << "\033[31mWrite failed.\033[0m\n";
+        return 1;
+    }
+    if (progress.toFile)
+    {
+        progress.file.close();
+        std::cout << "Density " << static_cast<double>(progress.matches) / static_cast<double>(progress.primes) << " over "
+                  << progress.primes << " primes (Artin's constant " << artinConstant << ").\n";
+    }
+    return 0;
+}
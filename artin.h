@@ -0,0 +1,25 @@
+#ifndef ARTIN_H
+#define ARTIN_H
+
+#include <cstdint>
+#include <string>
+
+// Primes p <= limit for which base is a primitive root, i.e. base has order p - 1. The primes
+// come segment by segment from the parallel sieve of sieve.h; each segment then factors its
+// p - 1 by striding the sieving primes over it, so each order check is a handful of tests
+// base^((p - 1) / q) != 1, one per prime q of p - 1, batched through the lane-per-modulus
+// vector kernel for p < 2^32. Matching primes are streamed in order, one per
+// line, interleaved with "#" lines giving the running density (Artin's conjecture predicts
+// 0.3739558... for bases that are not perfect powers).
+struct ArtinOptions
+{
+    uint64_t base = 2;
+    uint64_t limit = 1000000;
+    std::string outputPath; // Empty = standard output
+};
+
+const uint64_t maxArtinLimit = 1ull << 50;
+
+int runArtinSearch(const ArtinOptions &options);
+
+#endif
@@ -0,0 +1,120 @@
+#include "checkpoint.h"
+#include "platform.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+namespace
+{
+    const char checkpointMagic[] = "SHCKPT1";
+
+    // FNV-1a over the payload, appended as the last eight bytes
+    uint64_t checksum(const std::string &bytes, size_t length)
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < length; ++i)
+        {
+            hash ^= static_cast<unsigned char>(bytes[i]);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    void appendU64(std::string &buffer, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+            buffer += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+CheckpointWriter::CheckpointWriter(const std::string &kind)
+{
+    buffer.append(checkpointMagic, sizeof(checkpointMagic));
+    putBytes(kind);
+}
+
+void CheckpointWriter::putU64(uint64_t value)
+{
+    appendU64(buffer, value);
+}
+
+void CheckpointWriter::putBytes(const std::string &bytes)
+{
+    putU64(bytes.size());
+    buffer += bytes;
+}
+
+// Write to path + ".tmp" and atomically replace path
+bool CheckpointWriter::commit(const std::string &path) const
+{
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::out | std::ios::trunc | std::ios::binary);
+        std::string sealed = buffer;
+        appendU64(sealed, checksum(buffer, buffer.size()));
+        file.write(sealed.data(), sealed.size());
+        file.flush();
+        if (!file)
+            return false;
+    }
+    // The data must reach the disk before the rename does, or a power loss could leave the
+    // new name pointing at an empty file
+    return syncFile(temporary) && replaceFile(temporary, path) && syncParentDirectory(path);
+}
+
+bool CheckpointReader::open(const std::string &path, const std::string &kind)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file)
+        return false;
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (buffer.size() < sizeof(checkpointMagic) + 8 ||
+        buffer.compare(0, sizeof(checkpointMagic), std::string(checkpointMagic, sizeof(checkpointMagic))) != 0)
+        return false;
+
+    // Verify and strip the trailing checksum
+    size_t payload = buffer.size() - 8;
+    position = payload;
+    uint64_t stored = 0;
+    getU64(stored);
+    if (stored != checksum(buffer, payload))
+        return false;
+    buffer.resize(payload);
+
+    position = sizeof(checkpointMagic);
+    std::string storedKind;
+    return getBytes(storedKind) && storedKind == kind;
+}
+
+bool CheckpointReader::getU64(uint64_t &value)
+{
+    if (buffer.size() - position < 8)
+        return false;
+    value = 0;
+    for (int i = 0; i < 8; ++i)
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(buffer[position + i])) << (8 * i);
+    position += 8;
+    return true;
+}
+
+bool CheckpointReader::getBytes(std::string &bytes)
+{
+    uint64_t length = 0;
+    if (!getU64(length) || buffer.size() - position < length)
+        return false;
+    bytes.assign(buffer, position, length);
+    position += length;
+    return true;
+}
+
+// Truncate a partially written output file back to the length recorded in a checkpoint
+bool truncateOutput(const std::string &path, uint64_t length)
+{
+    std::error_code error;
+    if (std::filesystem::file_size(path, error) < length || error)
+        return false;
+    std::filesystem::resize_file(path, length, error);
+    return !error;
+}
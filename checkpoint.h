@@ -0,0 +1,40 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+
+// Binary checkpoint files for long-running modes. A checkpoint is built in memory,
+// tagged with the kind of run that produced it and a checksum, and committed by
+// writing a temporary file, syncing it and renaming it over the previous checkpoint,
+// so a crash or power loss at any point leaves either the old or the new checkpoint intact.
+
+class CheckpointWriter
+{
+public:
+    explicit CheckpointWriter(const std::string &kind);
+    void putU64(uint64_t value);
+    void putBytes(const std::string &bytes);
+    bool commit(const std::string &path) const;
+
+private:
+    std::string buffer;
+};
+
+class CheckpointReader
+{
+public:
+    // Fails if the file is missing, damaged, or was written by a different kind of run
+    bool open(const std::string &path, const std::string &kind);
+    bool getU64(uint64_t &value);
+    bool getBytes(std::string &bytes);
+
+private:
+    std::string buffer;
+    size_t position = 0;
+};
+
+// Truncate a partially written output file back to the length recorded in a checkpoint
+bool truncateOutput(const std::string &path, uint64_t length);
+
+#endif
@@ -0,0 +1,396 @@
+#include "cluster.h"
+#include "engine.h"
+#include "metrics.h"
+#include "net.h"
+#include "stats.h"
+#include "sweep.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Every message is a 16-byte header (type, payload length) followed by the payload.
+    // All integers are little-endian; shapes in RESULT payloads are LEB128 varints.
+    enum MessageType : uint64_t
+    {
+        MESSAGE_HELLO = 1,  // worker -> coordinator: protocol tag, worker threads
+        MESSAGE_ASSIGN = 2, // coordinator -> worker: range id, base, first modulus, count
+        MESSAGE_RESULT = 3, // worker -> coordinator: range id, count, (tail, period) varints
+        MESSAGE_DONE = 4    // coordinator -> worker: no work left
+    };
+
+    const uint64_t protocolTag = 0x3157484853ull; // "SHHW1"
+    const int helloTimeoutMs = 10000;
+    const int workerIdleTimeoutMs = 24 * 3600 * 1000;
+    const uint64_t maxPayloadBytes = 1ull << 30;
+
+    MetricGauge &workersMetric = metricGauge("sh_cluster_workers", "Workers connected to the coordinator.");
+    MetricCounter &reassignedMetric = metricCounter("sh_cluster_reassigned_ranges", "Leases returned to the queue after a worker was lost.");
+    MetricGauge &clusterQueueMetric = metricGauge("sh_queue_depth", "Work items waiting to be started.", "queue=\"cluster\"");
+
+    void putU64(std::string &buffer, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+            buffer += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+
+    bool getU64(const std::string &buffer, size_t &position, uint64_t &value)
+    {
+        if (buffer.size() - position < 8)
+            return false;
+        value = 0;
+        for (int i = 0; i < 8; ++i)
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(buffer[position + i])) << (8 * i);
+        position += 8;
+        return true;
+    }
+
+    void putVarint(std::string &buffer, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            buffer += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        buffer += static_cast<char>(value);
+    }
+
+    bool getVarint(const std::string &buffer, size_t &position, uint64_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64 && position < buffer.size(); shift += 7)
+        {
+            unsigned char byte = static_cast<unsigned char>(buffer[position++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool sendMessage(SocketHandle socket, MessageType type, const std::string &payload)
+    {
+        TraceSpan span("send", "io");
+        std::string message;
+        putU64(message, type);
+        putU64(message, payload.size());
+        message += payload;
+        statAdd(STAT_BYTES_WRITTEN, message.size());
+        return netSendAll(socket, message.data(), message.size());
+    }
+
+    bool receiveMessage(SocketHandle socket, int timeoutMs, uint64_t &type, std::string &payload)
+    {
+        std::string header(16, '\0');
+        size_t position = 0;
+        uint64_t length = 0;
+        if (!netRecvAll(socket, &header[0], header.size(), timeoutMs) || !getU64(header, position, type) ||
+            !getU64(header, position, length) || length > maxPayloadBytes)
+            return false;
+        payload.assign(length, '\0');
+        return length == 0 || netRecvAll(socket, &payload[0], length, timeoutMs);
+    }
+
+    // Shared coordinator state; every field is guarded by mutex
+    struct Coordinator
+    {
+        const CoordinatorOptions &options;
+        uint64_t rangeCount;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<uint64_t> queue;              // Ranges nobody holds
+        std::map<uint64_t, std::string> pending; // Finished ranges waiting for earlier ones
+        uint64_t flushedRanges = 0;
+        std::ofstream file;
+        bool failed = false;
+        unsigned workers = 0;
+
+        explicit Coordinator(const CoordinatorOptions &options)
+            : options(options), rangeCount((options.last - options.first) / options.rangeSize + 1)
+        {
+            for (uint64_t range = 0; range < rangeCount; ++range)
+                queue.push_back(range);
+        }
+
+        bool finished() const { return flushedRanges == rangeCount || failed; }
+
+        // Write finished ranges that extend the written prefix; caller holds mutex
+        void flushPrefix()
+        {
+            TraceSpan span("write", "io");
+            auto next = pending.find(flushedRanges);
+            while (next != pending.end())
+            {
+                file << next->second;
+                statAdd(STAT_BYTES_WRITTEN, next->second.size());
+                if (!file)
+                    failed = true;
+                pending.erase(next);
+                next = pending.find(++flushedRanges);
+            }
+        }
+
+        // Lease the next range, waiting while others are still out; false once the sweep is done
+        bool takeRange(uint64_t &range)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return !queue.empty() || finished(); });
+            if (finished())
+                return false;
+            range = queue.front();
+            queue.pop_front();
+            clusterQueueMetric.set(static_cast<double>(queue.size()));
+            return true;
+        }
+
+        void returnRange(uint64_t range)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.push_front(range);
+                clusterQueueMetric.set(static_cast<double>(queue.size()));
+            }
+            reassignedMetric.add();
+            changed.notify_all();
+        }
+
+        void completeRange(uint64_t range, std::string text)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.emplace(range, std::move(text));
+                flushPrefix();
+            }
+            changed.notify_all();
+        }
+    };
+
+    // Decode a RESULT payload for the given lease into output lines
+    bool decodeResult(const std::string &payload, uint64_t range, uint64_t firstModulus, uint64_t count, std::string &text)
+    {
+        size_t position = 0;
+        uint64_t resultRange = 0, resultCount = 0;
+        if (!getU64(payload, position, resultRange) || !getU64(payload, position, resultCount) || resultRange != range ||
+            resultCount != count)
+            return false;
+
+        std::vector<SequenceShape> shapes(count);
+        for (SequenceShape &shape : shapes)
+        {
+            if (!getVarint(payload, position, shape.tail) || !getVarint(payload, position, shape.period))
+                return false;
+        }
+        text = formatSweepLines(firstModulus, shapes);
+        return position == payload.size();
+    }
+
+    // One thread per connected worker: hand out leases until the sweep is complete
+    void serveWorker(Coordinator &coordinator, SocketHandle socket, unsigned id)
+    {
+        traceSetThreadName("coordinator link " + std::to_string(id));
+        const CoordinatorOptions &options = coordinator.options;
+
+        uint64_t type = 0, tag = 0, threads = 0;
+        std::string payload;
+        size_t position = 0;
+        if (!receiveMessage(socket, helloTimeoutMs, type, payload) || type != MESSAGE_HELLO ||
+            !getU64(payload, position, tag) || tag != protocolTag || !getU64(payload, position, threads))
+        {
+            netClose(socket);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(coordinator.mutex);
+            workersMetric.set(++coordinator.workers);
+            std::cout << "Worker " << id << " joined (" << threads << " threads).\n";
+        }
+
+        uint64_t range;
+        while (coordinator.takeRange(range))
+        {
+            uint64_t firstModulus = options.first + range * options.rangeSize;
+            uint64_t count = options.last - firstModulus + 1 < options.rangeSize ? options.last - firstModulus + 1 : options.rangeSize;
+
+            std::string assignment;
+            putU64(assignment, range);
+            putU64(assignment, options.base);
+            putU64(assignment, firstModulus);
+            putU64(assignment, count);
+
+            std::string text;
+            if (!sendMessage(socket, MESSAGE_ASSIGN, assignment) ||
+                !receiveMessage(socket, static_cast<int>(options.leaseTimeout * 1000), type, payload) ||
+                type != MESSAGE_RESULT || !decodeResult(payload, range, firstModulus, count, text))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(coordinator.mutex);
+                    std::cout << "\033[31mWorker " << id << " lost; moduli " << firstModulus << ".." << firstModulus + count - 1
+                              << " reassigned.\033[0m\n";
+                    workersMetric.set(--coordinator.workers);
+                }
+                coordinator.returnRange(range);
+                netClose(socket);
+                return;
+            }
+            coordinator.completeRange(range, std::move(text));
+        }
+
+        sendMessage(socket, MESSAGE_DONE, "");
+        netClose(socket);
+        std::lock_guard<std::mutex> lock(coordinator.mutex);
+        workersMetric.set(--coordinator.workers);
+    }
+}
+
+// Hand out the sweep range to workers and write their results in order
+int runCoordinator(const CoordinatorOptions &options)
+{
+    if (options.first == 0 || options.last < options.first || options.rangeSize == 0)
+    {
+        std::cout << "\033[31mInvalid sweep range.\033[0m\n";
+        return 1;
+    }
+    if (options.outputPath.empty())
+    {
+        std::cout << "\033[31mThe coordinator requires --output.\033[0m\n";
+        return 1;
+    }
+
+    Coordinator coordinator(options);
+    coordinator.file.open(options.outputPath, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!coordinator.file)
+    {
+        std::cout << "\033[31mCannot open output file " << options.outputPath << ".\033[0m\n";
+        return 1;
+    }
+
+    SocketHandle listener = netListenAddress(options.address);
+    if (listener == invalidSocket)
+    {
+        std::cout << "\033[31mCannot listen on " << options.address << ".\033[0m\n";
+        return 1;
+    }
+    std::cout << "Coordinator listening on " << options.address << ": " << coordinator.rangeCount << " ranges of up to "
+              << options.rangeSize << " moduli.\n";
+
+    std::vector<std::thread> links;
+    unsigned nextId = 0;
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(coordinator.mutex);
+            if (coordinator.finished())
+                break;
+        }
+        SocketHandle client = netAccept(listener, 200);
+        if (client != invalidSocket)
+            links.emplace_back(serveWorker, std::ref(coordinator), client, nextId++);
+    }
+    netClose(listener);
+
+    coordinator.changed.notify_all();
+    for (std::thread &link : links)
+        link.join();
+
+    coordinator.file.close();
+    if (coordinator.failed)
+    {
+        std::cout << "\033[31mWrite failed.\033[0m\n";
+        return 1;
+    }
+    std::cout << "Sweep complete.\n";
+    return 0;
+}
+
+// Connect to a coordinator and compute leased ranges until it reports that the sweep is done
+int runWorker(const std::string &address)
+{
+    SocketHandle socket = invalidSocket;
+    for (int attempt = 0; attempt < 100 && socket == invalidSocket; ++attempt)
+    {
+        socket = netConnectAddress(address);
+        if (socket == invalidSocket)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    if (socket == invalidSocket)
+    {
+        std::cout << "\033[31mCannot connect to coordinator at " << address << ".\033[0m\n";
+        return 1;
+    }
+
+    WorkStealingPool &pool = sharedThreadPool();
+    std::string hello;
+    putU64(hello, protocolTag);
+    putU64(hello, pool.size());
+    if (!sendMessage(socket, MESSAGE_HELLO, hello))
+    {
+        netClose(socket);
+        return 1;
+    }
+
+    uint64_t leases = 0;
+    while (true)
+    {
+        uint64_t type = 0;
+        std::string payload;
+        if (!receiveMessage(socket, workerIdleTimeoutMs, type, payload))
+        {
+            std::cout << "\033[31mLost connection to coordinator.\033[0m\n";
+            netClose(socket);
+            return 1;
+        }
+        if (type == MESSAGE_DONE)
+            break;
+
+        size_t position = 0;
+        uint64_t range, base, firstModulus, count;
+        if (type != MESSAGE_ASSIGN || !getU64(payload, position, range) || !getU64(payload, position, base) ||
+            !getU64(payload, position, firstModulus) || !getU64(payload, position, count) || firstModulus == 0 ||
+            count == 0 || count > maxLeaseSize || firstModulus > UINT64_MAX - count)
+        {
+            std::cout << "\033[31mUnexpected message from coordinator.\033[0m\n";
+            netClose(socket);
+            return 1;
+        }
+
+        std::vector<SequenceShape> shapes(count);
+        pool.parallelFor(0, count, 64, [&](uint64_t begin, uint64_t end, unsigned)
+        {
+            std::vector<SequenceShape> piece(end - begin);
+            computeSweepShapes(base, firstModulus + begin, piece);
+            std::copy(piece.begin(), piece.end(), shapes.begin() + begin);
+        });
+
+        std::string result;
+        putU64(result, range);
+        putU64(result, count);
+        for (const SequenceShape &shape : shapes)
+        {
+            putVarint(result, shape.tail);
+            putVarint(result, shape.period);
+        }
+        if (!sendMessage(socket, MESSAGE_RESULT, result))
+        {
+            std::cout << "\033[31mLost connection to coordinator.\033[0m\n";
+            netClose(socket);
+            return 1;
+        }
+        ++leases;
+    }
+
+    netClose(socket);
+    std::cout << "Worker finished after " << leases << " ranges.\n";
+    return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <cstdint>
+#include <string>
+
+// Sharded sweep across processes. The coordinator owns the modulus range and the output
+// file; workers connect over TCP ("HOST:PORT") or a Unix socket ("unix:PATH"), lease one
+// range at a time, compute it on their own thread pool and stream back the shapes as
+// varints. A range whose worker disconnects or exceeds the lease timeout goes back to
+// the queue. The output is identical to --sweep over the same range. The coordinator does
+// not checkpoint; an interrupted sharded sweep starts over.
+
+struct CoordinatorOptions
+{
+    std::string address;
+    uint64_t base = 2;
+    uint64_t first = 1;
+    uint64_t last = 1;
+    std::string outputPath;
+    uint64_t rangeSize = 4096;      // Moduli per lease
+    unsigned leaseTimeout = 300;    // Seconds a worker may hold a lease
+};
+
+const uint64_t maxLeaseSize = 1ull << 24; // Workers refuse larger assignments
+
+int runCoordinator(const CoordinatorOptions &options);
+int runWorker(const std::string &address);
+
+#endif
@@ -0,0 +1,423 @@
+#include "dispatch.h"
+#include "engine.h"
+#include "metrics.h"
+#include "platform.h"
+#include "simd.h"
+#include "stats.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+namespace
+{
+    const char calibrationHeader[] = "simpleharmonics-calibration 1";
+    const double minimumSampleNanos = 1e6; // Length of one timing sample (1 ms)
+
+    double probeCosts[reductionWidthClasses];
+    bool probeMeasured[reductionWidthClasses] = {};
+
+    MetricCache cacheMetric = metricCache("calibration");
+
+    // Hash of the limbs of a non-negative value, for the hash-set strategy
+    struct MpzHash
+    {
+        size_t operator()(const mpz_class &value) const
+        {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (size_t i = 0; i < mpz_size(value.get_mpz_t()); ++i)
+            {
+                hash ^= mpz_getlimbn(value.get_mpz_t(), i);
+                hash *= 0x100000001b3ull;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    // Inserting one term into the seen set: hashing plus a node allocation
+    double probeCost(size_t modulusBits)
+    {
+        size_t widthClass = reductionWidthClass(modulusBits);
+        if (probeMeasured[widthClass])
+            return probeCosts[widthClass];
+        return modulusBits <= 64 ? 40.0 : 80.0 + 2.0 * static_cast<double>((modulusBits + 63) / 64);
+    }
+
+    std::string cpuSignature()
+    {
+        return std::string(simdLevelName(detectSimdLevel())) + " " + std::to_string(std::thread::hardware_concurrency());
+    }
+
+    // Nanoseconds per iteration of body(n): n doubles until one sample is long enough, then
+    // the fastest of three samples is kept to shrug off interrupts and frequency changes
+    template <class Body>
+    double nanosPerIteration(Body body)
+    {
+        auto sample = [&body](uint64_t n)
+        {
+            auto started = std::chrono::steady_clock::now();
+            body(n);
+            return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+        };
+        uint64_t n = 64;
+        while (sample(n) < minimumSampleNanos && n < (1ull << 26))
+            n *= 2;
+        double best = sample(n);
+        for (int repeat = 0; repeat < 2; ++repeat)
+        {
+            double elapsed = sample(n);
+            if (elapsed < best)
+                best = elapsed;
+        }
+        return best / static_cast<double>(n);
+    }
+
+    // Random odd modulus with exactly bits bits
+    mpz_class randomModulus(gmp_randclass &random, size_t bits)
+    {
+        mpz_class modulus = random.get_z_bits(bits);
+        mpz_setbit(modulus.get_mpz_t(), bits - 1);
+        mpz_setbit(modulus.get_mpz_t(), 0);
+        return modulus;
+    }
+
+    volatile uint64_t calibrationSink;
+
+    template <class Arithmetic>
+    ReductionCost measureKernel64(uint64_t modulus)
+    {
+        ReductionCost cost;
+        cost.setup = nanosPerIteration([modulus](uint64_t n)
+        {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < n; ++i)
+                sum += Arithmetic(modulus - 2 * (i & 1)).one;
+            calibrationSink = sum;
+        });
+        Arithmetic arithmetic(modulus);
+        cost.perStep = nanosPerIteration([&arithmetic](uint64_t n)
+        {
+            auto value = arithmetic.convertIn(3);
+            auto step = arithmetic.convertIn(5);
+            for (uint64_t i = 0; i < n; ++i)
+                value = arithmetic.multiply(value, step);
+            calibrationSink = arithmetic.convertOut(value);
+        });
+        return cost;
+    }
+
+    template <class Reducer>
+    ReductionCost measureKernelMpz(const mpz_class &modulus, const mpz_class &step)
+    {
+        ReductionCost cost;
+        cost.setup = nanosPerIteration([&modulus](uint64_t n)
+        {
+            for (uint64_t i = 0; i < n; ++i)
+                Reducer reducer(modulus);
+        });
+        Reducer reducer(modulus);
+        cost.perStep = nanosPerIteration([&](uint64_t n)
+        {
+            mpz_class value = 3;
+            for (uint64_t i = 0; i < n; ++i)
+                reducer.multiply(value, value, step);
+            calibrationSink = mpz_getlimbn(value.get_mpz_t(), 0);
+        });
+        return cost;
+    }
+
+    // Step through the sequence with one kernel, either until a term repeats (hash set) or
+    // for exactly count terms (count known from the shape)
+    template <class Arithmetic>
+    void collectTerms64(const Arithmetic &arithmetic, uint64_t start, bool hashSet, uint64_t count, std::vector<mpz_class> &terms)
+    {
+        auto step = arithmetic.convertIn(start);
+        auto value = step;
+        std::unordered_set<uint64_t> seen;
+        for (uint64_t i = 0; hashSet || i < count; ++i)
+        {
+            if (hashSet)
+            {
+                statAdd(STAT_SEEN_PROBES);
+                if (!seen.insert(value).second)
+                {
+                    statAdd(STAT_SEEN_COLLISIONS);
+                    break;
+                }
+                statAdd(STAT_ALLOCATIONS);
+            }
+            terms.push_back(uint64ToMpz(arithmetic.convertOut(value)));
+            value = arithmetic.multiply(value, step);
+            statAdd(STAT_MOD_MULS);
+            statAdd(STAT_REDUCTIONS);
+        }
+    }
+
+    template <class Reducer>
+    void collectTermsMpz(Reducer reducer, const mpz_class &start, bool hashSet, uint64_t count, std::vector<mpz_class> &terms)
+    {
+        mpz_class value = start;
+        std::unordered_set<mpz_class, MpzHash> seen;
+        for (uint64_t i = 0; hashSet || i < count; ++i)
+        {
+            if (hashSet)
+            {
+                statAdd(STAT_SEEN_PROBES);
+                if (!seen.insert(value).second)
+                {
+                    statAdd(STAT_SEEN_COLLISIONS);
+                    break;
+                }
+                statAdd(STAT_ALLOCATIONS);
+            }
+            terms.push_back(value);
+            reducer.multiply(value, value, start);
+            statAdd(STAT_MOD_MULS);
+            statAdd(STAT_REDUCTIONS);
+        }
+    }
+}
+
+const char *cycleStrategyName(CycleStrategy strategy)
+{
+    return strategy == CYCLE_HASH_SET ? "hash-set" : "stepping";
+}
+
+// One random odd modulus per width class; kernels that do not apply to it are skipped
+void runCalibration(std::ostream *report)
+{
+    gmp_randclass random(gmp_randinit_default);
+    random.seed(20240601);
+    std::mt19937_64 values(1);
+
+    if (report)
+        *report << "\nCalibrating reduction kernels (ns per setup / per step, ns per seen-set probe):\n"
+                << std::setw(8) << "bits" << std::setw(22) << "barrett" << std::setw(22) << "montgomery" << std::setw(22) << "gmp"
+                << std::setw(10) << "probe" << "\n";
+
+    for (size_t widthClass = 0; widthClass < reductionWidthClasses; ++widthClass)
+    {
+        size_t bits = reductionClassBits(widthClass);
+        mpz_class modulus = randomModulus(random, bits);
+        mpz_class step = random.get_z_range(modulus);
+        ReductionCost costs[REDUCE_KERNEL_COUNT];
+        bool available[REDUCE_KERNEL_COUNT] = {};
+
+        if (bits <= 64)
+        {
+            uint64_t modulus64 = mpzToUint64(modulus);
+            if (bits <= 32)
+            {
+                costs[REDUCE_BARRETT] = measureKernel64<Barrett32>(modulus64);
+                costs[REDUCE_MONTGOMERY] = measureKernel64<Montgomery32>(modulus64);
+            }
+            else
+            {
+                costs[REDUCE_BARRETT] = measureKernel64<Barrett64>(modulus64);
+                costs[REDUCE_MONTGOMERY] = measureKernel64<Montgomery64>(modulus64);
+            }
+            available[REDUCE_BARRETT] = available[REDUCE_MONTGOMERY] = true;
+            probeCosts[widthClass] = nanosPerIteration([&values](uint64_t n)
+            {
+                std::unordered_set<uint64_t> seen;
+                for (uint64_t i = 0; i < n; ++i)
+                    seen.insert(values());
+                calibrationSink = seen.size();
+            });
+        }
+        else
+        {
+            costs[REDUCE_BARRETT] = measureKernelMpz<BarrettMpz>(modulus, step);
+            available[REDUCE_BARRETT] = true;
+            // Values are drawn up front: generating wide random numbers costs more than the probe
+            std::vector<mpz_class> pool(1 << 14);
+            for (mpz_class &value : pool)
+                value = random.get_z_range(modulus);
+            auto started = std::chrono::steady_clock::now();
+            {
+                std::unordered_set<mpz_class, MpzHash> seen;
+                for (const mpz_class &value : pool)
+                    seen.insert(value);
+                calibrationSink = seen.size();
+            }
+            probeCosts[widthClass] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / pool.size();
+        }
+        costs[REDUCE_GMP] = measureKernelMpz<GmpReducer>(modulus, step);
+        available[REDUCE_GMP] = true;
+        probeMeasured[widthClass] = true;
+
+        if (report)
+            *report << std::setw(8) << bits;
+        for (int k = 0; k < REDUCE_KERNEL_COUNT; ++k)
+        {
+            ReductionKernel kernel = static_cast<ReductionKernel>(k);
+            if (available[k])
+                setMeasuredReductionCost(kernel, widthClass, costs[k]);
+            if (report)
+            {
+                std::ostringstream cell;
+                if (available[k])
+                    cell << std::fixed << std::setprecision(1) << costs[k].setup << " / " << costs[k].perStep;
+                else
+                    cell << "-";
+                *report << std::setw(22) << cell.str();
+            }
+        }
+        if (report)
+            *report << std::fixed << std::setprecision(1) << std::setw(10) << probeCosts[widthClass] << std::defaultfloat << "\n";
+    }
+    statNote("calibration", "measured");
+}
+
+// Text format: header, "cpu <signature>", then "cost <kernel> <class> <setup> <step>" and
+// "probe <class> <ns>" lines
+bool loadCalibration(const std::string &path)
+{
+    std::ifstream file(path);
+    std::string line;
+    if (!std::getline(file, line) || line != calibrationHeader || !std::getline(file, line) || line != "cpu " + cpuSignature())
+        return false;
+
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string kind;
+        size_t widthClass = 0;
+        fields >> kind;
+        if (kind == "cost")
+        {
+            int kernel = 0;
+            ReductionCost cost;
+            if (!(fields >> kernel >> widthClass >> cost.setup >> cost.perStep) || kernel < 0 || kernel >= REDUCE_KERNEL_COUNT ||
+                widthClass >= reductionWidthClasses)
+                return false;
+            setMeasuredReductionCost(static_cast<ReductionKernel>(kernel), widthClass, cost);
+        }
+        else if (kind == "probe")
+        {
+            double nanos = 0;
+            if (!(fields >> widthClass >> nanos) || widthClass >= reductionWidthClasses)
+                return false;
+            probeCosts[widthClass] = nanos;
+            probeMeasured[widthClass] = true;
+        }
+        else
+            return false;
+    }
+    statNote("calibration", "cached");
+    return true;
+}
+
+bool saveCalibration(const std::string &path)
+{
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::out | std::ios::trunc);
+        file << calibrationHeader << "\ncpu " << cpuSignature() << "\n";
+        for (size_t widthClass = 0; widthClass < reductionWidthClasses; ++widthClass)
+        {
+            size_t bits = reductionClassBits(widthClass);
+            for (int k = 0; k < REDUCE_KERNEL_COUNT; ++k)
+            {
+                ReductionKernel kernel = static_cast<ReductionKernel>(k);
+                if (!reductionAvailable(kernel, bits, true))
+                    continue;
+                ReductionCost cost = estimateReductionCost(kernel, bits);
+                file << "cost " << k << " " << widthClass << " " << cost.setup << " " << cost.perStep << "\n";
+            }
+            file << "probe " << widthClass << " " << probeCost(bits) << "\n";
+        }
+        file.flush();
+        if (!file)
+            return false;
+    }
+    return replaceFile(temporary, path);
+}
+
+std::string defaultCalibrationPath()
+{
+    const char *home = std::getenv("HOME");
+    if (!home)
+        home = std::getenv("USERPROFILE");
+    return home ? std::string(home) + "/.simpleharmonics_calibration" : std::string();
+}
+
+void initCalibration(const std::string &path)
+{
+    if (!path.empty())
+    {
+        bool cached = loadCalibration(path);
+        (cached ? cacheMetric.hits : cacheMetric.misses).add();
+        if (cached)
+            return;
+    }
+    runCalibration(nullptr);
+    if (!path.empty())
+        saveCalibration(path);
+}
+
+// Both strategies take one pass to produce the terms. Stepping first finds the shape in
+// constant memory: one pass for a unit (first return to 1) and about three with Brent;
+// the hash set instead pays a probe per term. The sequence is at most modulo terms long.
+SequencePlan planSequence(const mpz_class &base, const mpz_class &modulo)
+{
+    size_t bits = mpz_sizeinbase(modulo.get_mpz_t(), 2);
+    double length = modulo.get_d();
+    mpz_class start = base % modulo, g;
+    if (start < 0)
+        start += modulo;
+    mpz_gcd(g.get_mpz_t(), start.get_mpz_t(), modulo.get_mpz_t());
+
+    SequencePlan plan;
+    plan.kernel = chooseReduction(bits, mpz_odd_p(modulo.get_mpz_t()), length < 1.8e19 ? static_cast<uint64_t>(length) : UINT64_MAX);
+    double step = estimateReductionCost(plan.kernel, bits).perStep;
+    double steppingCost = (g == 1 ? 2.0 : 4.0) * step;
+    double hashCost = step + probeCost(bits);
+    plan.strategy = hashCost < steppingCost ? CYCLE_HASH_SET : CYCLE_STEPPING;
+    return plan;
+}
+
+void generateSequenceTerms(const mpz_class &base, const mpz_class &modulo, std::vector<mpz_class> &terms)
+{
+    SequencePlan plan = planSequence(base, modulo);
+    size_t bits = mpz_sizeinbase(modulo.get_mpz_t(), 2);
+    statNote("kernel", std::string(reductionKernelName(plan.kernel)) + (bits <= 32 ? "/32" : bits <= 64 ? "/64" : "/mpz"));
+    statNote("cycle", cycleStrategyName(plan.strategy));
+
+    mpz_class start = base % modulo;
+    if (start < 0)
+        start += modulo;
+    bool hashSet = plan.strategy == CYCLE_HASH_SET;
+    uint64_t count = 0;
+    if (!hashSet)
+    {
+        SequenceShape shape = computeSequenceShape(start, modulo);
+        count = shape.tail + shape.period;
+    }
+
+    terms.clear();
+    if (!hashSet)
+        terms.reserve(count);
+    if (bits <= 64)
+    {
+        uint64_t modulo64 = mpzToUint64(modulo);
+        if (modulo64 == 1)
+        {
+            terms.push_back(0);
+            return;
+        }
+        withReduction64(modulo64, plan.kernel, [&](const auto &arithmetic)
+        {
+            collectTerms64(arithmetic, mpzToUint64(start), hashSet, count, terms);
+        });
+    }
+    else if (plan.kernel == REDUCE_BARRETT)
+        collectTermsMpz(BarrettMpz(modulo), start, hashSet, count, terms);
+    else
+        collectTermsMpz(GmpReducer(modulo), start, hashSet, count, terms);
+}
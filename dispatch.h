@@ -0,0 +1,48 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <gmpxx.h>
+#include "modarith.h"
+
+// Kernel and cycle-detection dispatch for the interactive sequence, driven by a short
+// calibration of the reduction kernels on this CPU. The measurements are cached in a small
+// text file keyed by the CPU's vector level and thread count, so only the first start (or
+// an explicit --calibrate) pays for them.
+
+enum CycleStrategy
+{
+    CYCLE_HASH_SET, // One pass, remembering every term until one repeats
+    CYCLE_STEPPING  // Shape first in constant memory (see computeSequenceShape), then one pass
+};
+
+const char *cycleStrategyName(CycleStrategy strategy);
+
+struct SequencePlan
+{
+    ReductionKernel kernel;
+    CycleStrategy strategy;
+};
+
+// Time every kernel and a hash-set probe for each width class and feed the results to the
+// cost model; prints the table to report when one is given
+void runCalibration(std::ostream *report);
+bool loadCalibration(const std::string &path);
+bool saveCalibration(const std::string &path);
+
+// ~/.simpleharmonics_calibration (%USERPROFILE% on Windows), or empty when unknown
+std::string defaultCalibrationPath();
+
+// Use the cache at path, or calibrate (and rewrite the cache) when it is missing or was
+// written on a different CPU. An empty path calibrates without caching.
+void initCalibration(const std::string &path);
+
+SequencePlan planSequence(const mpz_class &base, const mpz_class &modulo);
+
+// Distinct terms base^1, base^2, ... (mod modulo), computed the way planSequence() picks;
+// the plan is recorded as stats notes
+void generateSequenceTerms(const mpz_class &base, const mpz_class &modulo, std::vector<mpz_class> &terms);
+
+#endif
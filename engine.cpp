@@ -0,0 +1,144 @@
+#include "engine.h"
+#include "groupseq.h"
+#include "modarith.h"
+#include "stats.h"
+
+// Low 64 bits of a non-negative mpz value
+uint64_t mpzToUint64(const mpz_class &value)
+{
+    mpz_class low;
+    mpz_fdiv_r_2exp(low.get_mpz_t(), value.get_mpz_t(), 64);
+    uint64_t result = 0;
+    mpz_export(&result, nullptr, -1, sizeof(result), 0, 0, low.get_mpz_t());
+    return result;
+}
+
+mpz_class uint64ToMpz(uint64_t value)
+{
+    mpz_class result;
+    mpz_import(result.get_mpz_t(), 1, -1, sizeof(value), 0, 0, &value);
+    return result;
+}
+
+// Greatest common divisor of two 64-bit values
+uint64_t gcd64(uint64_t a, uint64_t b)
+{
+    while (b != 0)
+    {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Right-to-left square-and-multiply; about two products per exponent bit, so the kernel is
+// chosen for that length (Barrett for most single queries)
+uint64_t powMod64(uint64_t base, uint64_t exponent, uint64_t mod)
+{
+    if (mod == 1)
+        return 0;
+    uint64_t result = 0;
+    uint64_t muls = 0;
+    size_t bits = 64 - __builtin_clzll(mod);
+    withReduction64(mod, chooseReduction(bits, mod & 1, 128), [&](const auto &arithmetic)
+    {
+        auto accumulator = arithmetic.one;
+        auto square = arithmetic.convertIn(base % mod);
+        for (uint64_t e = exponent; e > 0; e >>= 1)
+        {
+            if (e & 1)
+            {
+                accumulator = arithmetic.multiply(accumulator, square);
+                ++muls;
+            }
+            square = arithmetic.multiply(square, square);
+            ++muls;
+        }
+        result = arithmetic.convertOut(accumulator);
+    });
+    statAdd(STAT_MOD_MULS, muls);
+    statAdd(STAT_REDUCTIONS, muls);
+    return result;
+}
+
+namespace
+{
+    // Shape of start^i for a unit start (pure cycle through 1) or by Brent's cycle detection,
+    // with every product going through one reduction kernel (see modarith.h) viewed as a
+    // group (see groupseq.h). steps counts the multiplications.
+    template <class Arithmetic>
+    SequenceShape stepShape(const Arithmetic &arithmetic, uint64_t residue, bool unit, uint64_t &steps)
+    {
+        return stepGroupShape(ResidueGroup<Arithmetic>{arithmetic}, arithmetic.convertIn(residue), unit, steps);
+    }
+
+    // The same for multi-limb moduli; Reducer is BarrettMpz or GmpReducer
+    template <class Reducer>
+    SequenceShape stepShape(Reducer &reducer, const mpz_class &start, bool unit, uint64_t &steps)
+    {
+        return stepGroupShape(MpzResidueGroup<Reducer>{reducer}, start, unit, steps);
+    }
+}
+
+// Shape of base^i (mod modulo) for i >= 1, found by stepping the sequence. The reduction
+// kernel is chosen for the modulus with tail + period <= modulo as the expected length.
+SequenceShape computeSequenceShape(uint64_t base, uint64_t modulo)
+{
+    SequenceShape shape;
+    uint64_t start = base % modulo;
+    if (modulo == 1 || start == 0)
+    {
+        shape.period = 1;
+        return shape;
+    }
+
+    uint64_t steps = 0;
+    bool unit = gcd64(start, modulo) == 1;
+    size_t bits = 64 - __builtin_clzll(modulo);
+    withReduction64(modulo, chooseReduction(bits, modulo & 1, modulo), [&](const auto &arithmetic)
+    {
+        shape = stepShape(arithmetic, start, unit, steps);
+    });
+
+    statAdd(STAT_MOD_MULS, steps);
+    statAdd(STAT_REDUCTIONS, steps);
+    return shape;
+}
+
+// Arbitrary-precision variant of computeSequenceShape using the same strategy
+SequenceShape computeSequenceShape(const mpz_class &base, const mpz_class &modulo)
+{
+    mpz_class start = base % modulo;
+    if (start < 0)
+        start += modulo;
+    if (mpz_sizeinbase(modulo.get_mpz_t(), 2) <= 64)
+        return computeSequenceShape(mpzToUint64(start), mpzToUint64(modulo));
+
+    SequenceShape shape;
+    if (start == 0)
+    {
+        shape.period = 1;
+        return shape;
+    }
+
+    mpz_class g;
+    mpz_gcd(g.get_mpz_t(), start.get_mpz_t(), modulo.get_mpz_t());
+    uint64_t steps = 0;
+    // Such a sequence is far longer than any setup cost, so the per-step estimate decides
+    size_t bits = mpz_sizeinbase(modulo.get_mpz_t(), 2);
+    if (chooseReduction(bits, mpz_odd_p(modulo.get_mpz_t()), UINT64_MAX) == REDUCE_BARRETT)
+    {
+        BarrettMpz reducer(modulo);
+        shape = stepShape(reducer, start, g == 1, steps);
+    }
+    else
+    {
+        GmpReducer reducer(modulo);
+        shape = stepShape(reducer, start, g == 1, steps);
+    }
+
+    statAdd(STAT_MOD_MULS, steps);
+    statAdd(STAT_REDUCTIONS, steps);
+    return shape;
+}
@@ -0,0 +1,33 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <cstdint>
+#include <gmpxx.h>
+
+// Shape of the sequence base^1, base^2, ... (mod modulo): the number of terms before the
+// cycle starts and the cycle length. tail + period is the number of distinct terms, which
+// is what generateSequencePattern() prints.
+struct SequenceShape
+{
+    uint64_t tail = 0;
+    uint64_t period = 0;
+};
+
+inline uint64_t mulMod64(uint64_t a, uint64_t b, uint64_t m)
+{
+    return static_cast<uint64_t>(static_cast<unsigned __int128>(a) * b % m);
+}
+
+// Conversions that do not depend on the width of unsigned long (32 bits on Windows)
+uint64_t mpzToUint64(const mpz_class &value);
+mpz_class uint64ToMpz(uint64_t value);
+
+uint64_t gcd64(uint64_t a, uint64_t b);
+uint64_t powMod64(uint64_t base, uint64_t exponent, uint64_t mod);
+
+// Brute-force shape by stepping the sequence (the cost grows with tail + period).
+// modulo must be at least 1.
+SequenceShape computeSequenceShape(uint64_t base, uint64_t modulo);
+SequenceShape computeSequenceShape(const mpz_class &base, const mpz_class &modulo);
+
+#endif
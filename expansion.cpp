@@ -0,0 +1,255 @@
+#include "expansion.h"
+#include "engine.h"
+#include "metrics.h"
+#include "modarith.h"
+#include "order.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+namespace
+{
+    const uint64_t expansionBlockDigits = 1 << 20; // Digits per scheduled and written block
+    const size_t maxGroupTableBytes = 1 << 16;
+    const char digitCharacters[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+    MetricCounter &digitsMetric = metricCounter("sh_expansion_digits", "Expansion digits produced.");
+
+    // Long division by b^width instead of b: entry q of the table holds the width digits of
+    // q < b^width, so each step yields a whole group with one product, one division and one
+    // copy. The width is the largest whose table fits in maxGroupTableBytes (4 for base 10).
+    struct DigitGroups
+    {
+        unsigned width = 1;
+        uint64_t scale;
+        std::string table;
+
+        explicit DigitGroups(uint64_t base) : scale(base)
+        {
+            while (scale * base * (width + 1) <= maxGroupTableBytes)
+            {
+                scale *= base;
+                ++width;
+            }
+            table.resize(scale * width);
+            for (uint64_t q = 0; q < scale; ++q)
+            {
+                uint64_t rest = q;
+                for (unsigned i = width; i-- > 0; rest /= base)
+                    table[q * width + i] = digitCharacters[rest % base];
+            }
+        }
+    };
+
+    // Division of remainder * b^width by a denominator below 2^32, by its Barrett reciprocal
+    // (the product stays below 2^48)
+    struct NarrowDivision
+    {
+        typedef uint64_t Value;
+        Barrett32 arithmetic;
+
+        explicit NarrowDivision(uint64_t denominator) : arithmetic(static_cast<uint32_t>(denominator)) {}
+        uint64_t divide(uint64_t value, uint64_t &remainder) const
+        {
+            uint64_t quotient = static_cast<uint64_t>((static_cast<unsigned __int128>(value) * arithmetic.reciprocal) >> 64);
+            remainder = value - quotient * arithmetic.modulus;
+            if (remainder >= arithmetic.modulus)
+            {
+                remainder -= arithmetic.modulus;
+                ++quotient;
+            }
+            return quotient;
+        }
+    };
+
+    // The same for wider denominators, with a 128-by-64-bit division
+    struct WideDivision
+    {
+        typedef unsigned __int128 Value;
+        uint64_t denominator;
+
+        explicit WideDivision(uint64_t denominator) : denominator(denominator) {}
+        uint64_t divide(Value value, uint64_t &remainder) const
+        {
+            uint64_t quotient = static_cast<uint64_t>(value / denominator);
+            remainder = static_cast<uint64_t>(value - static_cast<Value>(quotient) * denominator);
+            return quotient;
+        }
+    };
+
+    // count digits of 1/n from the one whose remainder is given onward
+    template <class Division>
+    void longDivision(const Division &division, uint64_t remainder, uint64_t base, const DigitGroups &groups, char *out,
+                      uint64_t count)
+    {
+        typedef typename Division::Value Value;
+        for (; count >= groups.width; count -= groups.width, out += groups.width)
+        {
+            uint64_t quotient = division.divide(static_cast<Value>(remainder) * groups.scale, remainder);
+            std::memcpy(out, &groups.table[quotient * groups.width], groups.width);
+        }
+        for (; count > 0; --count)
+            *out++ = digitCharacters[division.divide(static_cast<Value>(remainder) * base, remainder)];
+    }
+
+    // Digits [first, first + count) of the expansion, with the opening parenthesis of the
+    // repeating block when it starts inside them
+    std::string formatBlock(const ExpansionOptions &options, const ExpansionShape &shape, const DigitGroups &groups,
+                            uint64_t first, uint64_t count)
+    {
+        TraceSpan span("block", "expansion");
+        bool opens = shape.period != 0 && shape.prePeriod >= first && shape.prePeriod < first + count;
+        std::string text(count + opens, '(');
+        uint64_t remainder = powMod64(options.base, first, options.denominator);
+        char *out = &text[0];
+        uint64_t before = opens ? shape.prePeriod - first : count;
+        for (int part = 0; part < 2; ++part)
+        {
+            if (options.denominator < (1ull << 32))
+                longDivision(NarrowDivision(options.denominator), remainder, options.base, groups, out, before);
+            else
+                longDivision(WideDivision(options.denominator), remainder, options.base, groups, out, before);
+            if (!opens)
+                break;
+            out += before + 1;
+            remainder = powMod64(options.base, shape.prePeriod, options.denominator);
+            before = count - before;
+        }
+        digitsMetric.add(count);
+        return text;
+    }
+
+    // Finished blocks waiting for every earlier one, so the digits stay in order
+    struct ExpansionProgress
+    {
+        std::mutex mutex;
+        std::ofstream file;
+        bool toFile = false;
+        bool failed = false;
+        std::map<uint64_t, std::string> pending;
+        uint64_t flushed = 0;
+    };
+
+    bool writeText(ExpansionProgress &progress, const std::string &text)
+    {
+        TraceSpan span("write", "io");
+        if (progress.toFile)
+            progress.file.write(text.data(), text.size());
+        else
+            std::cout.write(text.data(), text.size());
+        statAdd(STAT_BYTES_WRITTEN, text.size());
+        return progress.toFile ? static_cast<bool>(progress.file) : static_cast<bool>(std::cout);
+    }
+
+    // Caller holds progress.mutex
+    void flushExpansionPrefix(ExpansionProgress &progress)
+    {
+        for (auto found = progress.pending.find(progress.flushed); found != progress.pending.end();
+             found = progress.pending.find(progress.flushed))
+        {
+            if (!writeText(progress, found->second))
+                progress.failed = true;
+            progress.pending.erase(found);
+            ++progress.flushed;
+        }
+    }
+}
+
+// Every prime p of n that divides b needs ceil(v_p(n) / v_p(b)) digits to be cleared
+ExpansionShape expansionShape(uint64_t base, uint64_t denominator)
+{
+    ExpansionShape shape;
+    uint64_t coprime = denominator;
+    for (const PrimePower &power : factorUint64(denominator))
+    {
+        if (base % power.prime != 0)
+            continue;
+        unsigned valuation = 0;
+        for (uint64_t rest = base; rest % power.prime == 0; rest /= power.prime)
+            ++valuation;
+        shape.prePeriod = std::max<uint64_t>(shape.prePeriod, (power.exponent + valuation - 1) / valuation);
+        for (unsigned i = 0; i < power.exponent; ++i)
+            coprime /= power.prime;
+    }
+    if (coprime > 1)
+        shape.period = unitOrder(base, coprime);
+    return shape;
+}
+
+int runExpansion(const ExpansionOptions &options)
+{
+    if (options.base < 2 || options.base > maxExpansionBase || options.denominator < 2)
+    {
+        std::cout << "\033[31mThe expansion needs a base from 2 to 36 and a denominator of at least 2.\033[0m\n";
+        return 1;
+    }
+    ExpansionShape shape;
+    {
+        TraceSpan span("order", "expansion");
+        shape = expansionShape(options.base, options.denominator);
+    }
+    std::cout << "1/" << options.denominator << " in base " << options.base << ": ";
+    if (shape.period == 0)
+        std::cout << "terminates after " << shape.prePeriod << " digits.\n";
+    else
+        std::cout << shape.prePeriod << " digits before the period, period " << shape.period << ".\n";
+
+    uint64_t total = shape.period > UINT64_MAX - shape.prePeriod ? UINT64_MAX : shape.prePeriod + shape.period;
+    bool truncated = options.digitLimit != 0 && options.digitLimit < total;
+    if (truncated)
+        total = options.digitLimit;
+    if (options.digitLimit == 0 && total > maxExpansionDigits)
+    {
+        std::cout << "\033[31mThe expansion is " << (total == UINT64_MAX ? "over 2^64" : std::to_string(total))
+                  << " digits long, more than the 2^40 that can be written; pass --expansion-digits to print a prefix.\033[0m\n";
+        return 1;
+    }
+
+    ExpansionProgress progress;
+    progress.toFile = !options.outputPath.empty();
+    if (progress.toFile)
+    {
+        progress.file.open(options.outputPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!progress.file)
+        {
+            std::cout << "\033[31mCannot open output file " << options.outputPath << ".\033[0m\n";
+            return 1;
+        }
+    }
+
+    DigitGroups groups(options.base);
+    uint64_t blocks = total / expansionBlockDigits + (total % expansionBlockDigits != 0);
+    if (!writeText(progress, "0."))
+        progress.failed = true;
+    sharedThreadPool().parallelFor(0, blocks, 1, [&](uint64_t begin, uint64_t end, unsigned)
+    {
+        for (uint64_t block = begin; block < end; ++block)
+        {
+            uint64_t first = block * expansionBlockDigits;
+            std::string text = formatBlock(options, shape, groups, first, std::min(expansionBlockDigits, total - first));
+
+            std::lock_guard<std::mutex> lock(progress.mutex);
+            progress.pending.emplace(block, std::move(text));
+            flushExpansionPrefix(progress);
+        }
+    });
+    std::string closing = truncated ? "...\n" : shape.period != 0 ? ")\n" : "\n";
+    if (progress.failed || progress.flushed != blocks || !writeText(progress, closing))
+    {
+        std::cout << "\033[31mWrite failed.\033[0m\n";
+        return 1;
+    }
+    if (progress.toFile)
+    {
+        progress.file.close();
+        std::cout << total << " digits written to " << options.outputPath << ".\n";
+    }
+    return 0;
+}
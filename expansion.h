@@ -0,0 +1,38 @@
+#ifndef EXPANSION_H
+#define EXPANSION_H
+
+#include <cstdint>
+#include <string>
+
+// The base-b expansion of 1/n. With n = n1 n2, where every prime of n1 divides b and n2 is
+// coprime to b, the digits start repeating after the smallest k with n1 | b^k, and the
+// repeating block is ord_n2(b) digits long: the same order the sequence b^i (mod n2) cycles
+// with, found here from the factorization of lambda(n2) instead of by stepping. The digits
+// come from long division, where the remainder after k digits is b^k mod n; that lets blocks
+// of digits start anywhere, so they are produced in parallel and written in order.
+struct ExpansionShape
+{
+    uint64_t prePeriod = 0; // Digits before the repeating block
+    uint64_t period = 0;    // Length of the repeating block, 0 when the expansion terminates
+};
+
+// base in [2, 2^64), denominator in [2, 2^64)
+ExpansionShape expansionShape(uint64_t base, uint64_t denominator);
+
+// Print "0.<pre-period>(<repeating block>)" to outputPath or the console, with digits
+// 0-9a-z, after a line giving the shape. digitLimit stops the expansion early ("..." marks
+// the cut).
+struct ExpansionOptions
+{
+    uint64_t base = 10;
+    uint64_t denominator = 7;
+    uint64_t digitLimit = 0; // 0 = the pre-period and one whole period, up to maxExpansionDigits
+    std::string outputPath;  // Empty = standard output
+};
+
+const uint64_t maxExpansionBase = 36;
+const uint64_t maxExpansionDigits = 1ull << 40; // Longest whole expansion written without digitLimit (1 TiB)
+
+int runExpansion(const ExpansionOptions &options);
+
+#endif
@@ -0,0 +1,469 @@
+#include "fft.h"
+#include "simd.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SH_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const size_t blockPoints = 1 << 12;      // Points per cache block for the first stages (64 KiB of data)
+    const size_t passButterflies = 1 << 10;  // Columns per scheduled piece of the later stages
+    const unsigned fusedStages = 3;          // Later stages per pass over the data
+    const uint64_t loopGrain = 1 << 16;      // Indices per scheduled piece of the element-wise loops
+    const double pi = 3.14159265358979323846;
+
+    // Run body(first, last) over [0, count) on the shared pool once count is worth splitting
+    template <class Body>
+    void forRanges(uint64_t count, Body body)
+    {
+        if (count <= loopGrain)
+        {
+            body(0, count);
+            return;
+        }
+        sharedThreadPool().parallelFor(0, count, loopGrain, [&body](uint64_t first, uint64_t last, unsigned)
+        {
+            body(first, last);
+        });
+    }
+
+    // count butterflies (a, b) -> (a + w b, a - w b) over consecutive elements
+    typedef void (*ButterflyKernel)(double *aRe, double *aIm, double *bRe, double *bIm, const double *wRe, const double *wIm, size_t count);
+
+    void butterfliesScalar(double *aRe, double *aIm, double *bRe, double *bIm, const double *wRe, const double *wIm, size_t count)
+    {
+        for (size_t j = 0; j < count; ++j)
+        {
+            double tRe = bRe[j] * wRe[j] - bIm[j] * wIm[j];
+            double tIm = bRe[j] * wIm[j] + bIm[j] * wRe[j];
+            bRe[j] = aRe[j] - tRe;
+            bIm[j] = aIm[j] - tIm;
+            aRe[j] += tRe;
+            aIm[j] += tIm;
+        }
+    }
+
+#ifdef SH_X86_KERNELS
+    __attribute__((target("avx2"))) void butterfliesAvx2(double *aRe, double *aIm, double *bRe, double *bIm, const double *wRe,
+                                                         const double *wIm, size_t count)
+    {
+        size_t j = 0;
+        for (; j + 4 <= count; j += 4)
+        {
+            __m256d xRe = _mm256_loadu_pd(bRe + j), xIm = _mm256_loadu_pd(bIm + j);
+            __m256d twRe = _mm256_loadu_pd(wRe + j), twIm = _mm256_loadu_pd(wIm + j);
+            __m256d tRe = _mm256_sub_pd(_mm256_mul_pd(xRe, twRe), _mm256_mul_pd(xIm, twIm));
+            __m256d tIm = _mm256_add_pd(_mm256_mul_pd(xRe, twIm), _mm256_mul_pd(xIm, twRe));
+            __m256d uRe = _mm256_loadu_pd(aRe + j), uIm = _mm256_loadu_pd(aIm + j);
+            _mm256_storeu_pd(aRe + j, _mm256_add_pd(uRe, tRe));
+            _mm256_storeu_pd(aIm + j, _mm256_add_pd(uIm, tIm));
+            _mm256_storeu_pd(bRe + j, _mm256_sub_pd(uRe, tRe));
+            _mm256_storeu_pd(bIm + j, _mm256_sub_pd(uIm, tIm));
+        }
+        butterfliesScalar(aRe + j, aIm + j, bRe + j, bIm + j, wRe + j, wIm + j, count - j);
+    }
+#endif
+
+    ButterflyKernel chooseButterflyKernel()
+    {
+#ifdef SH_X86_KERNELS
+        if (activeSimdLevel() >= SIMD_AVX2)
+            return butterfliesAvx2;
+#endif
+        return butterfliesScalar;
+    }
+
+    uint64_t reverseBits(uint64_t value, unsigned bits)
+    {
+        static const struct ByteTable
+        {
+            uint8_t reversed[256];
+            ByteTable()
+            {
+                for (int b = 0; b < 256; ++b)
+                {
+                    int r = 0;
+                    for (int bit = 0; bit < 8; ++bit)
+                        r |= ((b >> bit) & 1) << (7 - bit);
+                    reversed[b] = static_cast<uint8_t>(r);
+                }
+            }
+        } table;
+        uint64_t result = 0;
+        for (int byte = 0; byte < 8; ++byte)
+            result |= static_cast<uint64_t>(table.reversed[(value >> (8 * byte)) & 0xFF]) << (56 - 8 * byte);
+        return bits ? result >> (64 - bits) : 0;
+    }
+
+    // exp(-2 pi i j / n) for j < n as coarse[j >> fineBits] * fine[j & fineMask]: two tables
+    // of about sqrt(n) entries that stay in cache, instead of one of n that does not, and no
+    // cos/sin per element
+    class TwiddleTable
+    {
+    public:
+        explicit TwiddleTable(size_t n)
+        {
+            unsigned bits = 0;
+            while ((size_t(1) << bits) < n)
+                ++bits;
+            fineBits = bits / 2;
+            fineMask = (size_t(1) << fineBits) - 1;
+            fill(fineRe, fineIm, size_t(1) << fineBits, 1, n);
+            fill(coarseRe, coarseIm, ((n - 1) >> fineBits) + 1, size_t(1) << fineBits, n);
+        }
+
+        void at(size_t j, double &re, double &im) const
+        {
+            size_t c = j >> fineBits, f = j & fineMask;
+            re = coarseRe[c] * fineRe[f] - coarseIm[c] * fineIm[f];
+            im = coarseRe[c] * fineIm[f] + coarseIm[c] * fineRe[f];
+        }
+
+    private:
+        static void fill(std::vector<double> &re, std::vector<double> &im, size_t count, size_t step, size_t n)
+        {
+            re.resize(count);
+            im.resize(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                double angle = -2 * pi * static_cast<double>(i * step) / static_cast<double>(n);
+                re[i] = std::cos(angle);
+                im[i] = std::sin(angle);
+            }
+        }
+
+        unsigned fineBits = 0;
+        size_t fineMask = 0;
+        std::vector<double> fineRe, fineIm, coarseRe, coarseIm;
+    };
+
+    // Radix-2 decimation-in-time transform of one power-of-two length. A stage of half-width h
+    // combines x[g + j] and x[g + h + j] with the twiddle exp(-pi i j / h) = w(j * n / (2h)).
+    class Pow2Plan
+    {
+    public:
+        explicit Pow2Plan(size_t n) : n(n), twiddles(n), kernel(chooseButterflyKernel())
+        {
+            while ((size_t(1) << bits) < n)
+                ++bits;
+
+            // Contiguous twiddles for the in-block stages, stage h at offset h
+            block = std::min(n, blockPoints);
+            stageRe.resize(block);
+            stageIm.resize(block);
+            for (size_t h = 1; h < block; h *= 2)
+            {
+                for (size_t j = 0; j < h; ++j)
+                    twiddles.at(j * (n / (2 * h)), stageRe[h + j], stageIm[h + j]);
+            }
+        }
+
+        // Forward transform in place; forward(im, re) is the inverse scaled by n
+        void forward(double *re, double *im) const
+        {
+            TraceSpan span("fft", "analysis");
+            bitReverse(re);
+            bitReverse(im);
+
+            // Stages up to the block size stay in cache: each block is finished before the next
+            sharedThreadPool().parallelFor(0, n / block, 1, [&](uint64_t first, uint64_t last, unsigned)
+            {
+                for (uint64_t b = first; b < last; ++b)
+                {
+                    double *blockRe = re + b * block, *blockIm = im + b * block;
+                    size_t h = 1;
+                    if (block >= 4)
+                    {
+                        firstTwoStages(blockRe, blockIm, block);
+                        h = 4;
+                    }
+                    for (; h < block; h *= 2)
+                    {
+                        for (size_t g = 0; g < block; g += 2 * h)
+                            kernel(blockRe + g, blockIm + g, blockRe + g + h, blockIm + g + h, &stageRe[h], &stageIm[h], h);
+                    }
+                }
+            });
+
+            // Wider stages, fusedStages at a time: a piece is passButterflies columns of each of
+            // the 2^fused segments of one group, carried through all the fused stages while it
+            // is in cache, so each pass reads and writes the data once (h >= block, so a piece
+            // never straddles two groups)
+            for (size_t h = block; h < n;)
+            {
+                unsigned fused = 0;
+                while (fused < fusedStages && (h << fused) < n)
+                    ++fused;
+                size_t span = h << fused, piecesPerGroup = h / passButterflies;
+                sharedThreadPool().parallelFor(0, n / span * piecesPerGroup, 1, [&](uint64_t first, uint64_t last, unsigned)
+                {
+                    double wRe[passButterflies], wIm[passButterflies];
+                    for (uint64_t piece = first; piece < last; ++piece)
+                    {
+                        uint64_t j = piece % piecesPerGroup * passButterflies;
+                        double *groupRe = re + piece / piecesPerGroup * span + j, *groupIm = im + piece / piecesPerGroup * span + j;
+                        for (unsigned level = 0; level < fused; ++level)
+                        {
+                            size_t stride = n / (2 * (h << level)), pair = size_t(1) << level;
+                            for (size_t low = 0; low < pair; ++low)
+                            {
+                                for (size_t t = 0; t < passButterflies; ++t)
+                                    twiddles.at((j + t + low * h) * stride, wRe[t], wIm[t]);
+                                for (size_t r = low; r < (size_t(1) << fused); r += 2 * pair)
+                                    kernel(groupRe + r * h, groupIm + r * h, groupRe + (r + pair) * h, groupIm + (r + pair) * h, wRe, wIm,
+                                           passButterflies);
+                            }
+                        }
+                    }
+                });
+                h = span;
+            }
+        }
+
+    private:
+        // Stages h = 1 and 2 as one radix-4 step: their twiddles are 1 and -i, and calls of one
+        // or two butterflies would cost more than the arithmetic
+        static void firstTwoStages(double *re, double *im, size_t count)
+        {
+            for (size_t g = 0; g < count; g += 4)
+            {
+                double sumRe = re[g] + re[g + 1], sumIm = im[g] + im[g + 1];
+                double differenceRe = re[g] - re[g + 1], differenceIm = im[g] - im[g + 1];
+                double upperSumRe = re[g + 2] + re[g + 3], upperSumIm = im[g + 2] + im[g + 3];
+                double upperDifferenceRe = re[g + 2] - re[g + 3], upperDifferenceIm = im[g + 2] - im[g + 3];
+                re[g] = sumRe + upperSumRe;
+                im[g] = sumIm + upperSumIm;
+                re[g + 2] = sumRe - upperSumRe;
+                im[g + 2] = sumIm - upperSumIm;
+                re[g + 1] = differenceRe + upperDifferenceIm;
+                im[g + 1] = differenceIm - upperDifferenceRe;
+                re[g + 3] = differenceRe - upperDifferenceIm;
+                im[g + 3] = differenceIm + upperDifferenceRe;
+            }
+        }
+
+        // Permute to bit-reversed order. An index splits into (top, middle, bottom) with
+        // tileBits-bit ends and reverses to (rev bottom, rev middle, rev top), so the 16x16
+        // tiles of a middle and its reverse swap through a buffer with short contiguous rows
+        // rather than one cache miss per element.
+        void bitReverse(double *x) const
+        {
+            const unsigned tileBits = 4;
+            const size_t side = size_t(1) << tileBits;
+            if (bits < 2 * tileBits + 1)
+            {
+                for (uint64_t i = 0; i < n; ++i)
+                {
+                    uint64_t j = reverseBits(i, bits);
+                    if (i < j)
+                        std::swap(x[i], x[j]);
+                }
+                return;
+            }
+            size_t flip[side];
+            for (size_t i = 0; i < side; ++i)
+                flip[i] = reverseBits(i, tileBits);
+            unsigned middleBits = bits - 2 * tileBits;
+            unsigned topShift = bits - tileBits;
+            sharedThreadPool().parallelFor(0, uint64_t(1) << middleBits, 1024, [&](uint64_t first, uint64_t last, unsigned)
+            {
+                double tile[side * side], mirror[side * side];
+                for (uint64_t middle = first; middle < last; ++middle)
+                {
+                    uint64_t reversed = reverseBits(middle, middleBits);
+                    if (middle > reversed)
+                        continue;
+                    for (size_t top = 0; top < side; ++top)
+                    {
+                        for (size_t bottom = 0; bottom < side; ++bottom)
+                        {
+                            tile[top * side + bottom] = x[(top << topShift) | (middle << tileBits) | bottom];
+                            mirror[top * side + bottom] = x[(top << topShift) | (reversed << tileBits) | bottom];
+                        }
+                    }
+                    for (size_t top = 0; top < side; ++top)
+                    {
+                        size_t fromBottom = flip[top];
+                        for (size_t bottom = 0; bottom < side; ++bottom)
+                        {
+                            size_t from = flip[bottom] * side + fromBottom;
+                            x[(top << topShift) | (reversed << tileBits) | bottom] = tile[from];
+                            x[(top << topShift) | (middle << tileBits) | bottom] = mirror[from];
+                        }
+                    }
+                }
+            });
+        }
+
+        size_t n;
+        unsigned bits = 0;
+        size_t block = 1;
+        TwiddleTable twiddles;
+        ButterflyKernel kernel;
+        std::vector<double> stageRe, stageIm;
+    };
+
+    // Bluestein: with c_k = exp(-pi i k^2 / n), X_k = c_k * sum_j (x_j c_j) conj(c_{k-j}), a
+    // cyclic convolution evaluated with power-of-two transforms of length m. k^2 is reduced
+    // mod 2n first so the chirp stays accurate for long inputs. The kernel's spectrum is
+    // computed first and re, im then grow to m in place of a separate buffer, which keeps the
+    // peak near 32 bytes per point of m.
+    void bluestein(std::vector<double> &re, std::vector<double> &im)
+    {
+        uint64_t n = re.size();
+        uint64_t m = 1;
+        while (m < 2 * n - 1)
+            m *= 2;
+        statNote("fft", "bluestein " + std::to_string(n) + " via " + std::to_string(m));
+
+        TwiddleTable circle(2 * n);
+        // Visits c_first .. c_last-1 with k^2 mod 2n stepped by 2k + 1 rather than divided out
+        auto forChirp = [&circle, n](uint64_t first, uint64_t last, auto body)
+        {
+            uint64_t square = static_cast<uint64_t>(static_cast<unsigned __int128>(first) * first % (2 * n));
+            for (uint64_t k = first; k < last; ++k)
+            {
+                double cRe, cIm;
+                circle.at(square, cRe, cIm);
+                body(k, cRe, cIm);
+                square += 2 * k + 1;
+                if (square >= 2 * n)
+                    square -= 2 * n;
+            }
+        };
+        Pow2Plan plan(m);
+
+        std::vector<double> bRe(m, 0.0), bIm(m, 0.0);
+        forRanges(n, [&](uint64_t first, uint64_t last)
+        {
+            forChirp(first, last, [&](uint64_t k, double cRe, double cIm)
+            {
+                bRe[k] = cRe;
+                bIm[k] = -cIm;
+                if (k)
+                {
+                    bRe[m - k] = cRe;
+                    bIm[m - k] = -cIm;
+                }
+            });
+        });
+        plan.forward(bRe.data(), bIm.data());
+
+        re.resize(m, 0.0);
+        im.resize(m, 0.0);
+        forRanges(n, [&](uint64_t first, uint64_t last)
+        {
+            forChirp(first, last, [&](uint64_t k, double cRe, double cIm)
+            {
+                double aRe = re[k] * cRe - im[k] * cIm;
+                im[k] = re[k] * cIm + im[k] * cRe;
+                re[k] = aRe;
+            });
+        });
+        plan.forward(re.data(), im.data());
+        forRanges(m, [&](uint64_t first, uint64_t last)
+        {
+            for (uint64_t k = first; k < last; ++k)
+            {
+                double productRe = re[k] * bRe[k] - im[k] * bIm[k];
+                im[k] = re[k] * bIm[k] + im[k] * bRe[k];
+                re[k] = productRe;
+            }
+        });
+        std::vector<double>().swap(bRe);
+        std::vector<double>().swap(bIm);
+        plan.forward(im.data(), re.data()); // Inverse, still scaled by m
+
+        double scale = 1.0 / static_cast<double>(m);
+        forRanges(n, [&](uint64_t first, uint64_t last)
+        {
+            forChirp(first, last, [&](uint64_t k, double cRe, double cIm)
+            {
+                double xRe = (re[k] * cRe - im[k] * cIm) * scale;
+                im[k] = (re[k] * cIm + im[k] * cRe) * scale;
+                re[k] = xRe;
+            });
+        });
+        re.resize(n);
+        im.resize(n);
+        re.shrink_to_fit();
+        im.shrink_to_fit();
+    }
+}
+
+void dft(std::vector<double> &re, std::vector<double> &im)
+{
+    size_t n = re.size();
+    if (n <= 1)
+        return;
+    if ((n & (n - 1)) == 0)
+    {
+        statNote("fft", "radix-2 " + std::to_string(n));
+        Pow2Plan(n).forward(re.data(), im.data());
+    }
+    else
+        bluestein(re, im);
+}
+
+// For even n, z_k = x_2k + i x_2k+1 has Z = E + i O (E, O the half-length spectra of the
+// even and odd samples), and X_k = E_k + exp(-2 pi i k / n) O_k
+void realPowerSpectrum(std::vector<double> &x, std::vector<double> &power)
+{
+    TraceSpan span("power spectrum", "analysis");
+    uint64_t n = x.size();
+    if (n == 0)
+    {
+        power.clear();
+        return;
+    }
+    if (n & 1)
+    {
+        std::vector<double> im(n, 0.0);
+        dft(x, im);
+        power.assign(n / 2 + 1, 0.0);
+        for (uint64_t k = 0; k <= n / 2; ++k)
+            power[k] = x[k] * x[k] + im[k] * im[k];
+        std::vector<double>().swap(x);
+        return;
+    }
+
+    uint64_t half = n / 2;
+    std::vector<double> zRe(half), zIm(half);
+    forRanges(half, [&](uint64_t first, uint64_t last)
+    {
+        for (uint64_t k = first; k < last; ++k)
+        {
+            zRe[k] = x[2 * k];
+            zIm[k] = x[2 * k + 1];
+        }
+    });
+    std::vector<double>().swap(x);
+    dft(zRe, zIm);
+    power.assign(half + 1, 0.0);
+
+    TwiddleTable circle(n);
+    forRanges(half + 1, [&](uint64_t first, uint64_t last)
+    {
+        for (uint64_t k = first; k < last; ++k)
+        {
+            uint64_t a = k % half, b = (half - k) % half;
+            double eRe = 0.5 * (zRe[a] + zRe[b]), eIm = 0.5 * (zIm[a] - zIm[b]);
+            double oRe = 0.5 * (zIm[a] + zIm[b]), oIm = -0.5 * (zRe[a] - zRe[b]);
+            double wRe, wIm;
+            circle.at(k, wRe, wIm);
+            double xRe = eRe + oRe * wRe - oIm * wIm;
+            double xIm = eIm + oRe * wIm + oIm * wRe;
+            power[k] = xRe * xRe + xIm * xIm;
+        }
+    });
+}
@@ -0,0 +1,21 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <cstddef>
+#include <vector>
+
+// In-tree discrete Fourier transforms for spectral analysis, in double precision on split
+// real/imaginary arrays. Power-of-two lengths use an iterative radix-2 transform with AVX2
+// butterflies: the first stages run cache-sized blocks to completion, the remaining stages
+// are one pass each, and both are spread over sharedThreadPool() for long inputs. Any
+// other length goes through Bluestein's algorithm, a cyclic convolution of power-of-two
+// length M >= 2n - 1, which peaks near 32 bytes per point of M.
+
+// Forward DFT X_k = sum_j x_j exp(-2 pi i jk / n) of any length n >= 1, in place
+void dft(std::vector<double> &re, std::vector<double> &im);
+
+// |X_k|^2 for k = 0 .. n/2 of a real sequence of length n >= 1. Even lengths are packed
+// into a complex transform of half the length. x is used as scratch and left empty.
+void realPowerSpectrum(std::vector<double> &x, std::vector<double> &power);
+
+#endif
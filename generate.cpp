@@ -0,0 +1,212 @@
+#include "generate.h"
+#include "checkpoint.h"
+#include "engine.h"
+#include "metrics.h"
+#include "modarith.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    const size_t outputBufferBytes = 1 << 20;
+    const uint64_t checkpointCheckTerms = 1 << 16; // Terms between looks at the clock
+
+    MetricCounter &termsMetric = metricCounter("sh_terms", "Sequence terms produced.");
+
+    // Everything needed to continue a generation exactly where it stopped
+    struct GenerateState
+    {
+        SequenceShape shape;
+        uint64_t exponent = 1; // Index of the next term to write
+        mpz_class value;       // base^exponent (mod modulo)
+        uint64_t outputBytes = 0;
+    };
+
+    bool saveGenerateCheckpoint(const GenerateOptions &options, const GenerateState &state)
+    {
+        TraceSpan span("checkpoint", "io");
+        CheckpointWriter writer("generate");
+        writer.putBytes(options.base.get_str());
+        writer.putBytes(options.modulo.get_str());
+        writer.putU64(state.shape.tail);
+        writer.putU64(state.shape.period);
+        writer.putU64(state.exponent);
+        writer.putBytes(state.value.get_str());
+        writer.putU64(state.outputBytes);
+        return writer.commit(options.checkpointPath);
+    }
+
+    bool loadGenerateCheckpoint(const GenerateOptions &options, GenerateState &state)
+    {
+        CheckpointReader reader;
+        std::string baseText, moduloText, valueText;
+        if (!reader.open(options.checkpointPath, "generate") || !reader.getBytes(baseText) || !reader.getBytes(moduloText) ||
+            !reader.getU64(state.shape.tail) || !reader.getU64(state.shape.period) || !reader.getU64(state.exponent) ||
+            !reader.getBytes(valueText) || !reader.getU64(state.outputBytes))
+            return false;
+        return baseText == options.base.get_str() && moduloText == options.modulo.get_str() &&
+               state.value.set_str(valueText, 10) == 0;
+    }
+
+    class TermWriter
+    {
+    public:
+        TermWriter(std::ofstream &file, bool toFile, uint64_t &bytes) : file(file), toFile(toFile), bytes(bytes)
+        {
+            buffer.reserve(outputBufferBytes + 256);
+        }
+
+        void add(uint64_t index, const std::string &value)
+        {
+            buffer += "Term ";
+            buffer += std::to_string(index);
+            buffer += ": ";
+            buffer += value;
+            buffer += '\n';
+            if (buffer.size() >= outputBufferBytes)
+                flush();
+        }
+
+        bool flush()
+        {
+            TraceSpan span("write", "io");
+            if (toFile)
+                file.write(buffer.data(), buffer.size()).flush();
+            else
+                std::cout.write(buffer.data(), buffer.size());
+            bytes += buffer.size();
+            statAdd(STAT_BYTES_WRITTEN, buffer.size());
+            buffer.clear();
+            return toFile ? static_cast<bool>(file) : static_cast<bool>(std::cout);
+        }
+
+    private:
+        std::ofstream &file;
+        bool toFile;
+        uint64_t &bytes;
+        std::string buffer;
+    };
+
+    // Write terms state.exponent..last of a multi-limb sequence; Reducer is BarrettMpz or GmpReducer
+    template <class Reducer>
+    void generateTermsMpz(Reducer reducer, TermWriter &writer, GenerateState &state, const mpz_class &step, uint64_t last)
+    {
+        for (; state.exponent <= last; ++state.exponent)
+        {
+            writer.add(state.exponent, state.value.get_str());
+            reducer.multiply(state.value, state.value, step);
+        }
+    }
+}
+
+// Stream the sequence for options.base and options.modulo, checkpointing if requested
+int runGenerate(const GenerateOptions &options)
+{
+    bool checkpointing = !options.checkpointPath.empty();
+    if ((checkpointing || options.resume) && options.outputPath.empty())
+    {
+        std::cout << "\033[31mCheckpointing a generation requires --output.\033[0m\n";
+        return 1;
+    }
+
+    mpz_class step = options.base % options.modulo;
+    if (step < 0)
+        step += options.modulo;
+
+    GenerateState state;
+    if (options.resume)
+    {
+        if (!loadGenerateCheckpoint(options, state) || !truncateOutput(options.outputPath, state.outputBytes))
+        {
+            std::cout << "\033[31mCannot resume from " << options.checkpointPath
+                      << " (missing, damaged, or written for a different base/modulo).\033[0m\n";
+            return 1;
+        }
+        std::cout << "Resuming generation at term " << state.exponent << ".\n";
+    }
+    else
+    {
+        TraceSpan span("order", "sequence");
+        state.shape = computeSequenceShape(options.base, options.modulo);
+        state.value = step;
+    }
+
+    std::ofstream file;
+    bool toFile = !options.outputPath.empty();
+    if (toFile)
+    {
+        file.open(options.outputPath, std::ios::out | std::ios::binary | (options.resume ? std::ios::app : std::ios::trunc));
+        if (!file)
+        {
+            std::cout << "\033[31mCannot open output file " << options.outputPath << ".\033[0m\n";
+            return 1;
+        }
+    }
+
+    TermWriter writer(file, toFile, state.outputBytes);
+    uint64_t total = state.shape.tail + state.shape.period;
+    auto lastCheckpoint = std::chrono::steady_clock::now();
+    bool small = mpz_sizeinbase(options.modulo.get_mpz_t(), 2) <= 64;
+    uint64_t modulo64 = small ? mpzToUint64(options.modulo) : 0;
+    uint64_t step64 = small ? mpzToUint64(step) : 0;
+    uint64_t value64 = small ? mpzToUint64(state.value) : 0;
+    ReductionKernel kernel = chooseReduction(mpz_sizeinbase(options.modulo.get_mpz_t(), 2), mpz_odd_p(options.modulo.get_mpz_t()), total);
+
+    while (state.exponent <= total)
+    {
+        uint64_t batchEnd = state.exponent + checkpointCheckTerms - 1 < total ? state.exponent + checkpointCheckTerms - 1 : total;
+        uint64_t produced = batchEnd - state.exponent + 1;
+        {
+            TraceSpan span("chunk", "sequence");
+            if (small)
+            {
+                withReduction64(modulo64, kernel, [&](const auto &arithmetic)
+                {
+                    auto value = arithmetic.convertIn(value64);
+                    auto multiplier = arithmetic.convertIn(step64);
+                    for (; state.exponent <= batchEnd; ++state.exponent)
+                    {
+                        writer.add(state.exponent, std::to_string(arithmetic.convertOut(value)));
+                        value = arithmetic.multiply(value, multiplier);
+                    }
+                    value64 = arithmetic.convertOut(value);
+                });
+            }
+            else if (kernel == REDUCE_BARRETT)
+                generateTermsMpz(BarrettMpz(options.modulo), writer, state, step, batchEnd);
+            else
+                generateTermsMpz(GmpReducer(options.modulo), writer, state, step, batchEnd);
+            statAdd(STAT_TERMS, produced);
+            statAdd(STAT_MOD_MULS, produced);
+            statAdd(STAT_REDUCTIONS, produced);
+            termsMetric.add(produced);
+        }
+
+        if (checkpointing && state.exponent <= total &&
+            std::chrono::steady_clock::now() - lastCheckpoint >= std::chrono::seconds(options.checkpointInterval))
+        {
+            if (small)
+                state.value = uint64ToMpz(value64);
+            if (!writer.flush() || !saveGenerateCheckpoint(options, state))
+            {
+                std::cout << "\033[31mCannot write checkpoint " << options.checkpointPath << ".\033[0m\n";
+                return 1;
+            }
+            lastCheckpoint = std::chrono::steady_clock::now();
+        }
+    }
+
+    if (!writer.flush())
+    {
+        std::cout << "\033[31mWrite failed.\033[0m\n";
+        return 1;
+    }
+    if (checkpointing)
+        std::remove(options.checkpointPath.c_str());
+    return 0;
+}
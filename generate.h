@@ -0,0 +1,21 @@
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <string>
+#include <gmpxx.h>
+
+// Stream every distinct term of base^i (mod modulo) as "Term i: value" lines, the same
+// lines the menu prints, without keeping the sequence in memory
+struct GenerateOptions
+{
+    mpz_class base = 2;
+    mpz_class modulo = 9;
+    std::string outputPath; // Empty = standard output
+    std::string checkpointPath; // Empty = no checkpoints
+    bool resume = false;
+    unsigned checkpointInterval = 30; // Seconds between checkpoints
+};
+
+int runGenerate(const GenerateOptions &options);
+
+#endif
@@ -0,0 +1,451 @@
+#include "group.h"
+#include "engine.h"
+#include "order.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+    const uint64_t rhoSteps = 1 << 20;     // Pollard rho budget per composite cofactor
+    const size_t orderListLimit = 256;     // Element orders listed one by one up to this many
+
+    // Add prime^exponent to factors, keeping primes sorted and merging repeats
+    void addPower(std::vector<PrimePowerMpz> &factors, const mpz_class &prime, unsigned exponent)
+    {
+        auto slot = std::lower_bound(factors.begin(), factors.end(), prime,
+                                     [](const PrimePowerMpz &power, const mpz_class &p) { return power.prime < p; });
+        if (slot != factors.end() && slot->prime == prime)
+            slot->exponent += exponent;
+        else
+            factors.insert(slot, PrimePowerMpz{prime, exponent});
+    }
+
+    mpz_class power(const mpz_class &prime, unsigned exponent)
+    {
+        mpz_class result;
+        mpz_pow_ui(result.get_mpz_t(), prime.get_mpz_t(), exponent);
+        return result;
+    }
+
+    // A proper factor of composite n by Pollard's rho with Brent's cycle detection, batching
+    // 128 differences per gcd as rhoFactor() in order.cpp does; false when the budget runs out
+    bool rhoFactorMpz(const mpz_class &n, mpz_class &divisor)
+    {
+        for (unsigned constant = 1; constant <= 8; ++constant)
+        {
+            auto next = [&n, constant](mpz_class &x)
+            {
+                x *= x;
+                x += constant;
+                mpz_mod(x.get_mpz_t(), x.get_mpz_t(), n.get_mpz_t());
+            };
+            mpz_class x = 2, y = 2, saved = 2, product = 1, difference;
+            divisor = 1;
+            uint64_t steps = 0;
+            for (uint64_t length = 1; divisor == 1; length *= 2)
+            {
+                if (steps > rhoSteps)
+                    return false;
+                x = y;
+                for (uint64_t i = 0; i < length; ++i)
+                    next(y);
+                for (uint64_t done = 0; done < length && divisor == 1; done += 128)
+                {
+                    saved = y;
+                    for (uint64_t i = 0; i < std::min<uint64_t>(128, length - done); ++i)
+                    {
+                        next(y);
+                        difference = x - y;
+                        product *= difference;
+                        mpz_mod(product.get_mpz_t(), product.get_mpz_t(), n.get_mpz_t());
+                    }
+                    mpz_gcd(divisor.get_mpz_t(), product.get_mpz_t(), n.get_mpz_t());
+                }
+                steps += 2 * length;
+            }
+            if (divisor == n)
+            {
+                // The batch overshot: redo it one step at a time
+                do
+                {
+                    next(saved);
+                    difference = x - saved;
+                    mpz_gcd(divisor.get_mpz_t(), difference.get_mpz_t(), n.get_mpz_t());
+                } while (divisor == 1);
+            }
+            if (divisor != n)
+                return true;
+        }
+        return false;
+    }
+
+    bool collectFactorsMpz(const mpz_class &n, std::vector<PrimePowerMpz> &factors)
+    {
+        if (n == 1)
+            return true;
+        if (mpz_sizeinbase(n.get_mpz_t(), 2) <= 64)
+        {
+            for (const PrimePower &part : factorUint64(mpzToUint64(n)))
+                addPower(factors, uint64ToMpz(part.prime), part.exponent);
+            return true;
+        }
+        if (mpz_probab_prime_p(n.get_mpz_t(), 30) > 0)
+        {
+            addPower(factors, n, 1);
+            return true;
+        }
+        // rho needs about sqrt(p) steps to split p^k, so perfect powers are taken apart by roots
+        if (mpz_perfect_power_p(n.get_mpz_t()))
+        {
+            mpz_class root;
+            unsigned k = 2;
+            while (!mpz_root(root.get_mpz_t(), n.get_mpz_t(), k))
+                ++k;
+            std::vector<PrimePowerMpz> rootFactors;
+            if (!collectFactorsMpz(root, rootFactors))
+                return false;
+            for (const PrimePowerMpz &part : rootFactors)
+                addPower(factors, part.prime, part.exponent * k);
+            return true;
+        }
+        mpz_class divisor;
+        if (!rhoFactorMpz(n, divisor))
+            return false;
+        mpz_class cofactor = n / divisor;
+        return collectFactorsMpz(divisor, factors) && collectFactorsMpz(cofactor, factors);
+    }
+
+    // Does g have order exactly order, given the primes of order? (g^(order / q) != 1 for each)
+    bool hasFullOrder(const mpz_class &g, const mpz_class &modulus, const mpz_class &order, const std::vector<PrimePowerMpz> &primes)
+    {
+        mpz_class result, reduced;
+        for (const PrimePowerMpz &q : primes)
+        {
+            reduced = order / q.prime;
+            mpz_powm(result.get_mpz_t(), g.get_mpz_t(), reduced.get_mpz_t(), modulus.get_mpz_t());
+            if (result == 1)
+                return false;
+        }
+        return true;
+    }
+
+    // Smallest g >= 2 coprime to modulus whose order is order
+    mpz_class smallestOfOrder(const mpz_class &modulus, const mpz_class &order, const std::vector<PrimePowerMpz> &primes)
+    {
+        mpz_class g = 2, common;
+        for (;; ++g)
+        {
+            mpz_gcd(common.get_mpz_t(), g.get_mpz_t(), modulus.get_mpz_t());
+            if (common == 1 && hasFullOrder(g, modulus, order, primes))
+                return g;
+        }
+    }
+
+    // The x mod modulo with x = g mod part and x = 1 mod modulo / part
+    mpz_class liftUnit(const mpz_class &g, const mpz_class &part, const mpz_class &modulo)
+    {
+        mpz_class rest = modulo / part, inverse, lifted;
+        mpz_invert(inverse.get_mpz_t(), rest.get_mpz_t(), part.get_mpz_t());
+        lifted = (g - 1) * inverse % part;
+        if (lifted < 0)
+            lifted += part;
+        lifted = (1 + rest * lifted) % modulo;
+        return lifted;
+    }
+
+    unsigned valuation(const mpz_class &value, const mpz_class &prime)
+    {
+        mpz_class rest;
+        return static_cast<unsigned>(mpz_remove(rest.get_mpz_t(), value.get_mpz_t(), prime.get_mpz_t()));
+    }
+
+    void printFactors(std::ostream &out, const std::vector<PrimePowerMpz> &factors)
+    {
+        if (factors.empty())
+            out << "1";
+        for (size_t i = 0; i < factors.size(); ++i)
+        {
+            out << (i ? " * " : "") << factors[i].prime;
+            if (factors[i].exponent > 1)
+                out << "^" << factors[i].exponent;
+        }
+    }
+
+    // Every divisor of lambda with its number of elements, in increasing order of divisor
+    void listOrders(const UnitGroup &group, std::vector<std::pair<mpz_class, mpz_class>> &orders)
+    {
+        orders.assign(1, {mpz_class(1), mpz_class(1)});
+        for (size_t i = 0; i < group.exponentFactors.size(); ++i)
+        {
+            size_t count = orders.size();
+            mpz_class step = 1;
+            for (unsigned j = 1; j <= group.exponentFactors[i].exponent; ++j)
+            {
+                step *= group.exponentFactors[i].prime;
+                for (size_t k = 0; k < count; ++k)
+                    orders.push_back({orders[k].first * step, orders[k].second * group.sylowCounts[i][j]});
+            }
+        }
+        std::sort(orders.begin(), orders.end(), [](const std::pair<mpz_class, mpz_class> &a, const std::pair<mpz_class, mpz_class> &b)
+        {
+            return a.first < b.first;
+        });
+    }
+}
+
+bool factorMpz(const mpz_class &n, std::vector<PrimePowerMpz> &factors)
+{
+    factors.clear();
+    mpz_class rest = n;
+    if (mpz_sizeinbase(rest.get_mpz_t(), 2) > 64)
+    {
+        mpz_class prime;
+        for (uint32_t p : smallPrimes())
+        {
+            if (!mpz_divisible_ui_p(rest.get_mpz_t(), p))
+                continue;
+            prime = p;
+            factors.push_back(PrimePowerMpz{prime, static_cast<unsigned>(mpz_remove(rest.get_mpz_t(), rest.get_mpz_t(), prime.get_mpz_t()))});
+        }
+    }
+    return collectFactorsMpz(rest, factors);
+}
+
+bool parseFactorization(const std::string &text, const mpz_class &n, std::vector<PrimePowerMpz> &factors)
+{
+    factors.clear();
+    mpz_class product = 1;
+    size_t start = 0;
+    while (start <= text.size())
+    {
+        size_t end = text.find('*', start);
+        if (end == std::string::npos)
+            end = text.size();
+        std::string term = text.substr(start, end - start);
+        size_t caret = term.find('^');
+        mpz_class prime, exponent = 1;
+        if (prime.set_str(term.substr(0, caret), 10) != 0 || prime < 2 || mpz_probab_prime_p(prime.get_mpz_t(), 30) == 0 ||
+            (caret != std::string::npos && (exponent.set_str(term.substr(caret + 1), 10) != 0 || exponent < 1 || exponent > 1 << 20)))
+            return false;
+        unsigned e = static_cast<unsigned>(exponent.get_ui());
+        addPower(factors, prime, e);
+        product *= power(prime, e);
+        start = end + 1;
+    }
+    return product == n;
+}
+
+// The prime powers give the cyclic factors; their generators are primitive roots of p (moved
+// to p + g when g fails mod p^2) and -1, 5 for 2^k
+UnitGroup analyzeUnitGroup(const mpz_class &modulo, const std::vector<PrimePowerMpz> &factors)
+{
+    TraceSpan span("group", "order");
+    UnitGroup group;
+    group.modulo = modulo;
+    group.factors = factors;
+    group.order = 1;
+    group.exponent = 1;
+
+    std::vector<mpz_class> cycles; // Orders of the cyclic factors of the prime powers
+    for (const PrimePowerMpz &factor : factors)
+    {
+        mpz_class part = power(factor.prime, factor.exponent);
+        mpz_class phi = part / factor.prime * (factor.prime - 1);
+        group.order *= phi;
+        if (factor.prime == 2)
+        {
+            if (factor.exponent >= 2)
+                cycles.push_back(2);
+            if (factor.exponent >= 3)
+                cycles.push_back(part / 4);
+            continue;
+        }
+        cycles.push_back(phi);
+    }
+    for (const mpz_class &cycle : cycles)
+        mpz_lcm(group.exponent.get_mpz_t(), group.exponent.get_mpz_t(), cycle.get_mpz_t());
+
+    // Smith form of the diagonal of cycle orders: after pass i, entry i divides every later one
+    std::vector<mpz_class> diagonal = cycles;
+    mpz_class common, multiple;
+    for (size_t i = 0; i < diagonal.size(); ++i)
+    {
+        for (size_t j = i + 1; j < diagonal.size(); ++j)
+        {
+            mpz_gcd(common.get_mpz_t(), diagonal[i].get_mpz_t(), diagonal[j].get_mpz_t());
+            mpz_lcm(multiple.get_mpz_t(), diagonal[i].get_mpz_t(), diagonal[j].get_mpz_t());
+            diagonal[i] = common;
+            diagonal[j] = multiple;
+        }
+        if (diagonal[i] > 1)
+            group.invariantFactors.push_back(diagonal[i]);
+    }
+    group.cyclic = group.invariantFactors.size() <= 1;
+
+    // The primes of lambda are 2, the repeated primes of modulo and the primes of every p - 1
+    std::vector<std::vector<PrimePowerMpz>> minusOne(factors.size()); // Factorizations of p - 1
+    std::vector<PrimePowerMpz> lambda;
+    for (size_t i = 0; i < factors.size(); ++i)
+    {
+        if (factors[i].prime != 2 && !factorMpz(factors[i].prime - 1, minusOne[i]))
+            return group;
+    }
+    group.complete = true;
+    for (size_t i = 0; i < factors.size(); ++i)
+    {
+        if (factors[i].exponent > 1 || factors[i].prime == 2)
+            addPower(lambda, factors[i].prime, 0);
+        for (const PrimePowerMpz &q : minusOne[i])
+            addPower(lambda, q.prime, 0);
+    }
+    for (PrimePowerMpz &q : lambda)
+        q.exponent = valuation(group.exponent, q.prime);
+    lambda.erase(std::remove_if(lambda.begin(), lambda.end(), [](const PrimePowerMpz &q) { return q.exponent == 0; }), lambda.end());
+    group.exponentFactors = lambda;
+
+    // Generators, one per cyclic factor of each prime power
+    size_t c = 0;
+    for (size_t i = 0; i < factors.size(); ++i)
+    {
+        const PrimePowerMpz &factor = factors[i];
+        mpz_class part = power(factor.prime, factor.exponent);
+        if (factor.prime == 2)
+        {
+            if (factor.exponent >= 2)
+            {
+                group.generators.push_back(liftUnit(part - 1, part, modulo));
+                group.generatorOrders.push_back(2);
+                ++c;
+            }
+            if (factor.exponent >= 3)
+            {
+                group.generators.push_back(liftUnit(5, part, modulo));
+                group.generatorOrders.push_back(cycles[c++]);
+            }
+            continue;
+        }
+        mpz_class g = smallestOfOrder(factor.prime, factor.prime - 1, minusOne[i]);
+        if (factor.exponent > 1)
+        {
+            mpz_class square = factor.prime * factor.prime, result, exponent = factor.prime - 1;
+            mpz_powm(result.get_mpz_t(), g.get_mpz_t(), exponent.get_mpz_t(), square.get_mpz_t());
+            if (result == 1)
+                g += factor.prime;
+        }
+        group.generators.push_back(liftUnit(g, part, modulo));
+        group.generatorOrders.push_back(cycles[c++]);
+    }
+    group.primitiveRoot = 0;
+    if (group.cyclic)
+        group.primitiveRoot = modulo <= 2 ? mpz_class(modulo - 1) : smallestOfOrder(modulo, group.order, lambda);
+
+    // In the l-Sylow subgroup, the elements of order dividing l^j number l^(sum min(j, a_i))
+    // over the l-parts l^(a_i) of the cycle orders
+    for (const PrimePowerMpz &l : lambda)
+    {
+        std::vector<unsigned> parts;
+        for (const mpz_class &cycle : cycles)
+            parts.push_back(valuation(cycle, l.prime));
+        std::vector<mpz_class> counts(l.exponent + 1);
+        mpz_class below = 1;
+        counts[0] = 1;
+        for (unsigned j = 1; j <= l.exponent; ++j)
+        {
+            unsigned total = 0;
+            for (unsigned a : parts)
+                total += std::min(a, j);
+            mpz_class within = power(l.prime, total);
+            counts[j] = within - below;
+            below = within;
+        }
+        group.sylowCounts.push_back(counts);
+    }
+    return group;
+}
+
+void printUnitGroup(std::ostream &out, const UnitGroup &group)
+{
+    out << "\n--- Unit Group (Z/" << group.modulo << "Z)* ---\n";
+    out << "Modulo: ";
+    printFactors(out, group.factors);
+    out << "\nOrder (phi): " << group.order << "\n";
+    out << "Exponent (lambda): " << group.exponent << "\n";
+    out << "Invariant factors: ";
+    if (group.invariantFactors.empty())
+        out << "none (trivial group)";
+    for (size_t i = 0; i < group.invariantFactors.size(); ++i)
+        out << (i ? " x " : "") << "C" << group.invariantFactors[i];
+    out << "\nCyclic: " << (group.cyclic ? "yes" : "no") << "\n";
+    if (!group.complete)
+    {
+        out << "Generators and element orders need p - 1 factored for every prime p of the modulo; "
+               "the factorization ran out of steps.\n";
+        return;
+    }
+
+    out << "Exponent factors: ";
+    printFactors(out, group.exponentFactors);
+    out << "\nGenerators (one per cyclic factor of a prime power):\n";
+    if (group.generators.empty())
+        out << "  none\n";
+    for (size_t i = 0; i < group.generators.size(); ++i)
+        out << "  " << group.generators[i] << " (order " << group.generatorOrders[i] << ")\n";
+    if (group.cyclic)
+        out << "Smallest primitive root: " << group.primitiveRoot << "\n";
+
+    size_t divisors = 1;
+    for (const PrimePowerMpz &l : group.exponentFactors)
+        divisors = divisors > orderListLimit ? divisors : divisors * (l.exponent + 1);
+    if (divisors <= orderListLimit)
+    {
+        std::vector<std::pair<mpz_class, mpz_class>> orders;
+        listOrders(group, orders);
+        out << "Elements by order:\n";
+        for (const auto &entry : orders)
+            out << "  order " << entry.first << ": " << entry.second << "\n";
+    }
+    else
+    {
+        // Too many divisors to list: the counts per Sylow subgroup multiply out to any of them
+        out << "Elements by order, per Sylow subgroup (multiply across primes for any order):\n";
+        for (size_t i = 0; i < group.exponentFactors.size(); ++i)
+        {
+            out << "  " << group.exponentFactors[i].prime << ":";
+            for (size_t j = 0; j < group.sylowCounts[i].size(); ++j)
+                out << " " << group.sylowCounts[i][j];
+            out << "\n";
+        }
+    }
+}
+
+int runGroupAnalysis(const GroupOptions &options)
+{
+    if (options.modulo < 1)
+    {
+        std::cout << "\033[31mThe modulo must be at least 1.\033[0m\n";
+        return 1;
+    }
+    auto started = std::chrono::steady_clock::now();
+    std::vector<PrimePowerMpz> factors;
+    if (!options.factors.empty())
+    {
+        if (!parseFactorization(options.factors, options.modulo, factors))
+        {
+            std::cout << "\033[31mThe factorization is not a product of primes equal to the modulo.\033[0m\n";
+            return 1;
+        }
+    }
+    else if (!factorMpz(options.modulo, factors))
+    {
+        std::cout << "\033[31mCannot factor the modulo; give its factorization with --factors=P^E*Q*...\033[0m\n";
+        return 1;
+    }
+    UnitGroup group = analyzeUnitGroup(options.modulo, factors);
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    printUnitGroup(std::cout, group);
+    std::cout << "Analyzed in " << milliseconds << " ms.\n";
+    return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef GROUP_H
+#define GROUP_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <gmpxx.h>
+
+// Structure of the unit group (Z/nZ)*, derived from the factorization of n alone (no base is
+// ever stepped). By the Chinese remainder theorem the group is the product of the groups of
+// its prime powers: cyclic of order p^(k-1) (p - 1) for odd p, and C2 x C(2^(k-2)) for 2^k,
+// k >= 3. The invariant factors follow from those cyclic orders by gcd/lcm alone; generators,
+// primitive roots and the number of elements of each order also need every p - 1 factored.
+
+struct PrimePowerMpz
+{
+    mpz_class prime;
+    unsigned exponent;
+};
+
+struct UnitGroup
+{
+    mpz_class modulo;
+    std::vector<PrimePowerMpz> factors;       // Of modulo, ascending primes
+    mpz_class order;                          // phi(modulo)
+    mpz_class exponent;                       // lambda(modulo), the largest element order
+    std::vector<mpz_class> invariantFactors;  // d1 | d2 | ... | dr = exponent, each > 1
+    bool cyclic = false;
+
+    // Filled only when complete: p - 1 was factored for every odd prime p of modulo
+    bool complete = false;
+    std::vector<PrimePowerMpz> exponentFactors;   // Of lambda(modulo)
+    std::vector<mpz_class> generators;            // One per cyclic factor of a prime power, lifted mod modulo
+    std::vector<mpz_class> generatorOrders;
+    mpz_class primitiveRoot;                      // Smallest, when the group is cyclic; 0 otherwise
+    // sylowCounts[i][j]: elements of order exponentFactors[i].prime^j in that Sylow subgroup.
+    // The number of elements of order d is the product over i of sylowCounts[i][v_i(d)].
+    std::vector<std::vector<mpz_class>> sylowCounts;
+};
+
+// Factorization of n >= 1 (ascending primes): trial division below 2^16, factorUint64() for a
+// cofactor of up to 64 bits, otherwise a probable-prime test and Pollard's rho with a bounded
+// number of steps. Returns false when a wide composite cofactor resists the budget.
+bool factorMpz(const mpz_class &n, std::vector<PrimePowerMpz> &factors);
+
+// Parse "P^E*Q*..." (decimal) and check that every P is a probable prime and the product is n
+bool parseFactorization(const std::string &text, const mpz_class &n, std::vector<PrimePowerMpz> &factors);
+
+// factors must be the factorization of modulo >= 1
+UnitGroup analyzeUnitGroup(const mpz_class &modulo, const std::vector<PrimePowerMpz> &factors);
+
+void printUnitGroup(std::ostream &out, const UnitGroup &group);
+
+struct GroupOptions
+{
+    mpz_class modulo = 9;
+    std::string factors; // Optional factorization of modulo, as parseFactorization() reads it
+};
+
+int runGroupAnalysis(const GroupOptions &options);
+
+#endif
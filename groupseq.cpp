@@ -0,0 +1,348 @@
+#include "groupseq.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    const uint64_t maxIndexBound = 1ull << 34;   // Baby-step tables up to 2^17 elements
+    const uint64_t maxSteppedOrder = 1ull << 26; // Stepping cross-check for units
+
+    // Remainder of a by b over GF(p), both with their leading coefficient last and nonzero
+    void polynomialRemainder(std::vector<uint32_t> &a, const std::vector<uint32_t> &b, uint32_t p)
+    {
+        uint64_t inverse = powMod64(b.back(), p - 2, p);
+        while (a.size() >= b.size())
+        {
+            uint64_t factor = mulMod64(a.back(), inverse, p);
+            size_t shift = a.size() - b.size();
+            for (size_t j = 0; j < b.size(); ++j)
+                a[shift + j] = static_cast<uint32_t>((static_cast<uint64_t>(a[shift + j]) + p - mulMod64(factor, b[j], p)) % p);
+            while (!a.empty() && a.back() == 0)
+                a.pop_back();
+        }
+    }
+
+    // Is gcd(a, b) = 1 over GF(p)? Empty vectors are the zero polynomial.
+    bool coprimePolynomials(std::vector<uint32_t> a, std::vector<uint32_t> b, uint32_t p)
+    {
+        while (!b.empty())
+        {
+            polynomialRemainder(a, b, p);
+            a.swap(b);
+        }
+        return a.size() == 1;
+    }
+
+    std::string formatFactors(const std::vector<PrimePower> &factors)
+    {
+        std::string text;
+        for (const PrimePower &power : factors)
+        {
+            text += (text.empty() ? "" : " * ") + std::to_string(power.prime);
+            if (power.exponent > 1)
+                text += "^" + std::to_string(power.exponent);
+        }
+        return text.empty() ? "1" : text;
+    }
+
+    std::string formatPolynomial(const uint32_t *coefficients, size_t count)
+    {
+        std::string text;
+        for (size_t i = count; i-- > 0;)
+        {
+            if (coefficients[i] == 0)
+                continue;
+            if (!text.empty())
+                text += " + ";
+            if (coefficients[i] != 1 || i == 0)
+                text += std::to_string(coefficients[i]);
+            if (i > 0)
+                text += i > 1 ? "x^" + std::to_string(i) : "x";
+        }
+        return text.empty() ? "0" : text;
+    }
+
+    // Comma-separated numbers, each reduced mod modulus (when nonzero)
+    bool parseNumbers(const std::string &text, uint64_t modulus, std::vector<uint64_t> &values)
+    {
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            char *end = nullptr;
+            if (item.empty() || item[0] == '-')
+                return false;
+            unsigned long long value = std::strtoull(item.c_str(), &end, 10);
+            if (*end != '\0')
+                return false;
+            values.push_back(modulus ? value % modulus : value);
+        }
+        return true;
+    }
+
+    double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // The same report for every group: the order three ways for a unit, the shape by Brent's
+    // cycle detection otherwise
+    template <class Group>
+    void printGroupSequence(const Group &group, const typename Group::Element &x, uint64_t power,
+                            const std::function<std::string(const typename Group::Element &)> &format)
+    {
+        std::cout << "Element: " << format(x) << "\n";
+        bool unit = group.invertible(x);
+        std::cout << "Unit: " << (unit ? "yes" : "no") << "\n";
+        if (unit)
+        {
+            std::vector<PrimePower> factors = group.exponentFactors();
+            std::cout << "Exponent bound: " << formatFactors(factors) << "\n";
+
+            auto start = std::chrono::steady_clock::now();
+            uint64_t order = groupOrderFromFactors(group, x, factors);
+            std::cout << "Order (from factorization): " << order << " (" << millisecondsSince(start) << " ms)\n";
+
+            unsigned __int128 bound = 1;
+            for (const PrimePower &prime : factors)
+            {
+                for (unsigned e = 0; e < prime.exponent && bound <= maxIndexBound; ++e)
+                    bound *= prime.prime;
+            }
+            if (bound <= maxIndexBound)
+            {
+                start = std::chrono::steady_clock::now();
+                uint64_t index = groupIndex(group, x, group.identity(), static_cast<uint64_t>(bound));
+                std::cout << "Order (baby-step giant-step): " << index << " (" << millisecondsSince(start) << " ms)\n";
+            }
+            else
+                std::cout << "Order (baby-step giant-step): skipped, bound above 2^34\n";
+
+            if (order != 0 && order <= maxSteppedOrder)
+            {
+                uint64_t steps = 0;
+                start = std::chrono::steady_clock::now();
+                SequenceShape shape = stepGroupShape(group, x, true, steps);
+                std::cout << "Order (stepping): " << shape.period << " (" << millisecondsSince(start) << " ms)\n";
+            }
+            else
+                std::cout << "Order (stepping): skipped, order above 2^26\n";
+        }
+        else
+        {
+            uint64_t steps = 0;
+            auto start = std::chrono::steady_clock::now();
+            SequenceShape shape = stepGroupShape(group, x, false, steps);
+            std::cout << "Shape (Brent): tail " << shape.tail << ", period " << shape.period << " (" << millisecondsSince(start)
+                      << " ms)\n";
+        }
+        if (power != 0)
+            std::cout << "x^" << power << ": " << format(groupPower(group, x, power)) << "\n";
+    }
+}
+
+bool MatrixGroup::invertible(const Element &x) const
+{
+    uint64_t n = arithmetic.modulus;
+    uint64_t determinant = (static_cast<uint64_t>(x.a) * x.d % n + n - static_cast<uint64_t>(x.b) * x.c % n) % n;
+    return gcd64(determinant, n) == 1;
+}
+
+std::vector<PrimePower> MatrixGroup::exponentFactors() const
+{
+    std::vector<PrimePower> factors;
+    for (const PrimePower &power : factorUint32(arithmetic.modulus))
+    {
+        mergeMaxPower(factors, power.prime, power.exponent);
+        for (const PrimePower &part : factorUint64(power.prime * power.prime - 1))
+            mergeMaxPower(factors, part.prime, part.exponent);
+    }
+    return factors;
+}
+
+bool GaussianGroup::invertible(const Element &x) const
+{
+    uint64_t n = arithmetic.modulus;
+    uint64_t norm = (static_cast<uint64_t>(x.re) * x.re + static_cast<uint64_t>(x.im) * x.im) % n;
+    return gcd64(norm, n) == 1;
+}
+
+std::vector<PrimePower> GaussianGroup::exponentFactors() const
+{
+    std::vector<PrimePower> factors;
+    for (const PrimePower &power : factorUint32(arithmetic.modulus))
+    {
+        if (power.prime == 2)
+        {
+            mergeMaxPower(factors, 2, 2 * power.exponent - 1);
+            continue;
+        }
+        if (power.exponent > 1)
+            mergeMaxPower(factors, power.prime, power.exponent - 1);
+        uint64_t cyclic = power.prime % 4 == 1 ? power.prime - 1 : power.prime * power.prime - 1;
+        for (const PrimePower &part : factorUint64(cyclic))
+            mergeMaxPower(factors, part.prime, part.exponent);
+    }
+    return factors;
+}
+
+// Candidates f_0 + f_1 x + ... + x^k are counted up with f_0 as the lowest digit; for k >= 2
+// those with f_0 = 0 are divisible by x and skipped
+GaloisField::GaloisField(uint32_t characteristic, unsigned degree) : arithmetic(characteristic), fieldDegree(degree)
+{
+    std::vector<uint32_t> candidate(degree + 1, 0);
+    candidate[degree] = 1;
+    if (degree >= 2)
+        candidate[0] = 1;
+    for (;;)
+    {
+        usePolynomial(candidate);
+        if (irreducible())
+            return;
+        for (unsigned i = 0; i < degree; ++i)
+        {
+            if (++candidate[i] < characteristic)
+                break;
+            candidate[i] = 0;
+        }
+        if (degree >= 2 && candidate[0] == 0)
+            candidate[0] = 1;
+    }
+}
+
+void GaloisField::usePolynomial(const std::vector<uint32_t> &candidate)
+{
+    polynomial = candidate;
+    for (unsigned j = 0; j < fieldDegree; ++j)
+        negated[j] = candidate[j] == 0 ? 0 : arithmetic.modulus - candidate[j];
+}
+
+GaloisField::Element GaloisField::generatorX() const
+{
+    Element x{};
+    if (fieldDegree >= 2)
+        x.coefficients[1] = 1;
+    else
+        x.coefficients[0] = negated[0];
+    return x;
+}
+
+// Rabin's test: f of degree k is irreducible iff x^(p^k) = x (mod f) and
+// gcd(x^(p^(k/q)) - x, f) = 1 for every prime q | k
+bool GaloisField::irreducible() const
+{
+    uint32_t p = arithmetic.modulus;
+    Element x = generatorX();
+    std::vector<Element> frobenius(fieldDegree + 1); // x^(p^j)
+    frobenius[0] = x;
+    for (unsigned j = 1; j <= fieldDegree; ++j)
+        frobenius[j] = groupPower(*this, frobenius[j - 1], p);
+    if (!(frobenius[fieldDegree] == x))
+        return false;
+    for (const PrimePower &power : factorUint32(fieldDegree))
+    {
+        const Element &h = frobenius[fieldDegree / power.prime];
+        std::vector<uint32_t> difference(fieldDegree);
+        for (unsigned i = 0; i < fieldDegree; ++i)
+            difference[i] = static_cast<uint32_t>((static_cast<uint64_t>(h.coefficients[i]) + p - x.coefficients[i]) % p);
+        while (!difference.empty() && difference.back() == 0)
+            difference.pop_back();
+        if (!coprimePolynomials(polynomial, difference, p))
+            return false;
+    }
+    return true;
+}
+
+std::vector<PrimePower> GaloisField::exponentFactors() const
+{
+    uint64_t size = 1;
+    for (unsigned i = 0; i < fieldDegree; ++i)
+        size *= arithmetic.modulus;
+    return factorUint64(size - 1);
+}
+
+int runGroupSequence(const GroupSequenceOptions &options)
+{
+    size_t colon = options.element.find(':');
+    std::string kind = options.element.substr(0, colon);
+    std::string rest = colon == std::string::npos ? std::string() : options.element.substr(colon + 1);
+    std::vector<uint64_t> values;
+
+    if (kind == "matrix" || kind == "gaussian")
+    {
+        size_t count = kind == "matrix" ? 4 : 2;
+        if (options.modulo < 2 || options.modulo >= maxGroupModulus || !parseNumbers(rest, options.modulo, values) ||
+            values.size() != count)
+        {
+            std::cout << "\033[31mUsage: --group-element=" << kind << (count == 4 ? ":A,B,C,D" : ":A,B")
+                      << " with a --modulo from 2 to 2^31 - 1.\033[0m\n";
+            return 1;
+        }
+        std::cout << "\n--- Group Sequence ---\n";
+        uint32_t n = static_cast<uint32_t>(options.modulo);
+        if (count == 4)
+        {
+            std::cout << "Group: 2x2 matrices mod " << n << "\n";
+            MatrixGroup group(n);
+            Matrix2 x{static_cast<uint32_t>(values[0]), static_cast<uint32_t>(values[1]), static_cast<uint32_t>(values[2]),
+                      static_cast<uint32_t>(values[3])};
+            printGroupSequence(group, x, options.power, [](const Matrix2 &m)
+            {
+                return "[[" + std::to_string(m.a) + ", " + std::to_string(m.b) + "], [" + std::to_string(m.c) + ", " +
+                       std::to_string(m.d) + "]]";
+            });
+        }
+        else
+        {
+            std::cout << "Group: Gaussian integers mod " << n << "\n";
+            GaussianGroup group(n);
+            Gaussian x{static_cast<uint32_t>(values[0]), static_cast<uint32_t>(values[1])};
+            printGroupSequence(group, x, options.power, [](const Gaussian &z)
+            {
+                return std::to_string(z.re) + " + " + std::to_string(z.im) + "i";
+            });
+        }
+        return 0;
+    }
+
+    if (kind == "gf")
+    {
+        size_t second = rest.find(':');
+        size_t caret = rest.find('^');
+        std::vector<uint64_t> field;
+        bool valid = second != std::string::npos && caret != std::string::npos && caret < second &&
+                     parseNumbers(rest.substr(0, caret) + "," + rest.substr(caret + 1, second - caret - 1), 0, field) &&
+                     field.size() == 2 && field[0] < (1ull << 32) && isPrimeUint64(field[0]) && field[1] >= 1 &&
+                     field[1] <= maxFieldDegree;
+        unsigned __int128 size = 1;
+        for (uint64_t i = 0; valid && i < field[1]; ++i)
+            size *= field[0];
+        valid = valid && size <= UINT64_MAX && parseNumbers(rest.substr(second + 1), field[0], values) && values.size() <= field[1];
+        if (!valid)
+        {
+            std::cout << "\033[31mUsage: --group-element=gf:P^K:C0,C1,... with a prime P < 2^32, P^K < 2^64 and at most K "
+                         "coefficients.\033[0m\n";
+            return 1;
+        }
+        GaloisField group(static_cast<uint32_t>(field[0]), static_cast<unsigned>(field[1]));
+        std::cout << "\n--- Group Sequence ---\n";
+        std::cout << "Group: GF(" << field[0] << "^" << field[1] << ") = GF(" << field[0] << ")[x] / ("
+                  << formatPolynomial(group.modulusPolynomial().data(), group.modulusPolynomial().size()) << ")\n";
+        FieldElement x{};
+        for (size_t i = 0; i < values.size(); ++i)
+            x.coefficients[i] = static_cast<uint32_t>(values[i]);
+        unsigned degree = group.degree();
+        printGroupSequence(group, x, options.power, [degree](const FieldElement &value)
+        {
+            return formatPolynomial(value.coefficients.data(), degree);
+        });
+        return 0;
+    }
+
+    std::cout << "\033[31mUnknown group element " << options.element << " (matrix:..., gaussian:... or gf:...).\033[0m\n";
+    return 1;
+}
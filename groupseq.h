@@ -0,0 +1,383 @@
+#ifndef GROUPSEQ_H
+#define GROUPSEQ_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "engine.h"
+#include "modarith.h"
+#include "order.h"
+
+// The sequence x, x^2, x^3, ... in any finite monoid, not only the residues mod n. Each
+// algorithm is a template over a Group type, so the group's product is inlined into the
+// inner loops with no virtual calls. A Group provides
+//   typedef ... Element;                      equality comparable, cheap to copy
+//   Element identity() const;
+//   Element multiply(const Element &a, const Element &b) const;
+//   bool invertible(const Element &x) const;  x lies on a pure cycle through the identity
+//   std::vector<PrimePower> exponentFactors() const;  a multiple of every unit's order
+//   uint64_t hash(const Element &x) const;    for the baby-step table
+// and gets stepping (first return to the identity for a unit, Brent's cycle detection
+// otherwise), random access by square-and-multiply, the order of a unit from the factored
+// multiple, and indices by baby-step giant-step. ResidueGroup wraps the reduction kernels of
+// modarith.h and MpzResidueGroup the multi-limb reducers, which is how both variants of
+// computeSequenceShape() step; MatrixGroup, GaussianGroup and GaloisField add 2x2 matrices
+// mod n (the Fibonacci matrix has the Pisano period as its order), Gaussian integers mod n
+// and GF(p^k).
+
+// result = a b. Groups whose elements own memory overload this to write into result's
+// storage, so the stepping loops do not allocate.
+template <class Group>
+void multiplyInto(const Group &group, typename Group::Element &result, const typename Group::Element &a,
+                  const typename Group::Element &b)
+{
+    result = group.multiply(a, b);
+}
+
+// x^exponent, exponent >= 0
+template <class Group>
+typename Group::Element groupPower(const Group &group, typename Group::Element x, uint64_t exponent)
+{
+    typename Group::Element result = group.identity();
+    for (; exponent; exponent >>= 1)
+    {
+        if (exponent & 1)
+            result = group.multiply(result, x);
+        x = group.multiply(x, x);
+    }
+    return result;
+}
+
+// Shape of start^i, i >= 1, by stepping. steps counts the multiplications.
+template <class Group>
+SequenceShape stepGroupShape(const Group &group, const typename Group::Element &start, bool unit, uint64_t &steps)
+{
+    typedef typename Group::Element Element;
+    SequenceShape shape;
+    if (unit)
+    {
+        // Units form a pure cycle through the identity, so the period is the first return to it
+        Element value = start;
+        Element one = group.identity();
+        shape.period = 1;
+        while (!(value == one))
+        {
+            multiplyInto(group, value, value, start);
+            ++shape.period;
+        }
+        steps = shape.period;
+        return shape;
+    }
+
+    // Brent's cycle detection: constant memory, O(tail + period) steps
+    uint64_t power = 1;
+    uint64_t lambda = 1;
+    Element tortoise = start;
+    Element hare = group.multiply(start, start);
+    steps = 1;
+    while (!(tortoise == hare))
+    {
+        if (power == lambda)
+        {
+            tortoise = hare;
+            power <<= 1;
+            lambda = 0;
+        }
+        multiplyInto(group, hare, hare, start);
+        ++lambda;
+        ++steps;
+    }
+
+    tortoise = hare = start;
+    for (uint64_t i = 0; i < lambda; ++i)
+        multiplyInto(group, hare, hare, start);
+    uint64_t mu = 0;
+    while (!(tortoise == hare))
+    {
+        multiplyInto(group, tortoise, tortoise, start);
+        multiplyInto(group, hare, hare, start);
+        ++mu;
+    }
+    steps += lambda + 2 * mu;
+    shape.tail = mu;
+    shape.period = lambda;
+    return shape;
+}
+
+// Order of a unit x from a factored multiple of it, which may exceed 64 bits: for each
+// prime power q^e of the multiple, y = x^(multiple / q^e) is raised to q until it reaches
+// the identity, and the order collects those powers of q. 0 when x^multiple is not the
+// identity or the order does not fit 64 bits.
+template <class Group>
+uint64_t groupOrderFromFactors(const Group &group, const typename Group::Element &x, const std::vector<PrimePower> &factors)
+{
+    typedef typename Group::Element Element;
+    Element one = group.identity();
+    unsigned __int128 order = 1;
+    for (size_t i = 0; i < factors.size(); ++i)
+    {
+        Element y = x;
+        for (size_t j = 0; j < factors.size(); ++j)
+        {
+            for (unsigned e = 0; j != i && e < factors[j].exponent; ++e)
+                y = groupPower(group, y, factors[j].prime);
+        }
+        for (unsigned e = 0; !(y == one); ++e)
+        {
+            if (e == factors[i].exponent)
+                return 0;
+            y = groupPower(group, y, factors[i].prime);
+            order *= factors[i].prime;
+            if (order > UINT64_MAX)
+                return 0;
+        }
+    }
+    return static_cast<uint64_t>(order);
+}
+
+// Smallest k in [1, bound] with x^k == target for a unit x, or 0 when there is none. Baby
+// steps store target x^j for j < m = ceil(sqrt(bound)) (the largest j per value), giant
+// steps walk x^(i m), and a match x^(i m) = target x^j means x^(i m - j) = target: about
+// 2 sqrt(bound) products and sqrt(bound) table entries. With target = identity this is the
+// order.
+template <class Group>
+uint64_t groupIndex(const Group &group, const typename Group::Element &x, const typename Group::Element &target, uint64_t bound)
+{
+    typedef typename Group::Element Element;
+    struct ElementHash
+    {
+        const Group *group;
+        size_t operator()(const Element &value) const { return static_cast<size_t>(group->hash(value)); }
+    };
+    if (bound == 0)
+        return 0;
+    uint64_t m = static_cast<uint64_t>(std::sqrt(static_cast<double>(bound)));
+    while (m > 0 && m * m > bound)
+        --m;
+    while (m * m < bound)
+        ++m;
+
+    std::unordered_map<Element, uint64_t, ElementHash> babies(static_cast<size_t>(m), ElementHash{&group});
+    Element value = target;
+    for (uint64_t j = 0; j < m; ++j)
+    {
+        babies[value] = j;
+        value = group.multiply(value, x);
+    }
+    Element giant = groupPower(group, x, m);
+    Element current = giant;
+    for (uint64_t i = 1; i <= m; ++i)
+    {
+        auto found = babies.find(current);
+        if (found != babies.end())
+        {
+            uint64_t k = i * m - found->second;
+            return k <= bound ? k : 0;
+        }
+        current = group.multiply(current, giant);
+    }
+    return 0;
+}
+
+// Residues mod n under one reduction kernel of modarith.h, in the kernel's internal form
+template <class Arithmetic>
+struct ResidueGroup
+{
+    typedef decltype(Arithmetic::one) Element;
+    const Arithmetic &arithmetic;
+
+    Element identity() const { return arithmetic.one; }
+    Element multiply(Element a, Element b) const { return arithmetic.multiply(a, b); }
+    bool invertible(Element x) const { return gcd64(arithmetic.convertOut(x), arithmetic.modulus) == 1; }
+    std::vector<PrimePower> exponentFactors() const { return carmichaelFactors(factorUint64(arithmetic.modulus)); }
+    uint64_t hash(Element x) const { return x; }
+};
+
+// Residues mod a multi-limb modulus through BarrettMpz or GmpReducer (see modarith.h), for
+// stepping only: the products go through multiplyInto() below, into the stepped element's limbs
+template <class Reducer>
+struct MpzResidueGroup
+{
+    typedef mpz_class Element;
+    Reducer &reducer;
+
+    Element identity() const { return 1; }
+    Element multiply(const Element &a, const Element &b) const
+    {
+        Element result;
+        reducer.multiply(result, a, b);
+        return result;
+    }
+};
+
+template <class Reducer>
+void multiplyInto(const MpzResidueGroup<Reducer> &group, mpz_class &result, const mpz_class &a, const mpz_class &b)
+{
+    group.reducer.multiply(result, a, b);
+}
+
+const uint64_t maxGroupModulus = 1ull << 31; // Sums of two products stay below 2^63
+
+// 2x2 matrices [[a, b], [c, d]] mod n < 2^31. The units are GL2(Z/n), whose exponent divides
+// the lcm over p^k || n of p^k (p - 1) (p + 1).
+struct Matrix2
+{
+    uint32_t a, b, c, d;
+    bool operator==(const Matrix2 &other) const { return a == other.a && b == other.b && c == other.c && d == other.d; }
+};
+
+class MatrixGroup
+{
+public:
+    typedef Matrix2 Element;
+
+    explicit MatrixGroup(uint32_t modulus) : arithmetic(modulus) {}
+    uint32_t modulus() const { return arithmetic.modulus; }
+    Element identity() const { return Matrix2{arithmetic.reduce(1), 0, 0, arithmetic.reduce(1)}; }
+    Element multiply(const Element &x, const Element &y) const
+    {
+        return Matrix2{arithmetic.reduce(static_cast<uint64_t>(x.a) * y.a + static_cast<uint64_t>(x.b) * y.c),
+                       arithmetic.reduce(static_cast<uint64_t>(x.a) * y.b + static_cast<uint64_t>(x.b) * y.d),
+                       arithmetic.reduce(static_cast<uint64_t>(x.c) * y.a + static_cast<uint64_t>(x.d) * y.c),
+                       arithmetic.reduce(static_cast<uint64_t>(x.c) * y.b + static_cast<uint64_t>(x.d) * y.d)};
+    }
+    bool invertible(const Element &x) const;
+    std::vector<PrimePower> exponentFactors() const;
+    uint64_t hash(const Element &x) const
+    {
+        return ((static_cast<uint64_t>(x.a) << 32 | x.b) * 0x9e3779b97f4a7c15ull) ^ (static_cast<uint64_t>(x.c) << 32 | x.d);
+    }
+
+private:
+    Barrett32 arithmetic;
+};
+
+// Gaussian integers a + bi mod n < 2^31. The units have exponent dividing the lcm of
+// 2^(2k-1) for 2^k, p^(k-1) (p - 1) for p = 1 (mod 4) and p^(k-1) (p^2 - 1) for p = 3 (mod 4).
+struct Gaussian
+{
+    uint32_t re, im;
+    bool operator==(const Gaussian &other) const { return re == other.re && im == other.im; }
+};
+
+class GaussianGroup
+{
+public:
+    typedef Gaussian Element;
+
+    explicit GaussianGroup(uint32_t modulus) : arithmetic(modulus) {}
+    uint32_t modulus() const { return arithmetic.modulus; }
+    Element identity() const { return Gaussian{arithmetic.reduce(1), 0}; }
+    Element multiply(const Element &x, const Element &y) const
+    {
+        // -im * im is added as im * (n - im); for im = 0 that is im * n, still 0 mod n
+        return Gaussian{arithmetic.reduce(static_cast<uint64_t>(x.re) * y.re + static_cast<uint64_t>(x.im) * (arithmetic.modulus - y.im)),
+                        arithmetic.reduce(static_cast<uint64_t>(x.re) * y.im + static_cast<uint64_t>(x.im) * y.re)};
+    }
+    bool invertible(const Element &x) const;
+    std::vector<PrimePower> exponentFactors() const;
+    uint64_t hash(const Element &x) const { return static_cast<uint64_t>(x.re) << 32 | x.im; }
+
+private:
+    Barrett32 arithmetic;
+};
+
+// GF(p^k) for a prime p < 2^32 and p^k < 2^64, as polynomials over GF(p) modulo the first
+// monic irreducible polynomial of degree k (counting candidates up with the constant term as
+// the lowest digit). Elements hold their k coefficients, constant term first.
+const unsigned maxFieldDegree = 64;
+
+struct FieldElement
+{
+    std::array<uint32_t, maxFieldDegree> coefficients;
+    bool operator==(const FieldElement &other) const { return coefficients == other.coefficients; }
+};
+
+class GaloisField
+{
+public:
+    typedef FieldElement Element;
+
+    // characteristic must be prime
+    GaloisField(uint32_t characteristic, unsigned degree);
+
+    uint32_t characteristic() const { return arithmetic.modulus; }
+    unsigned degree() const { return fieldDegree; }
+    const std::vector<uint32_t> &modulusPolynomial() const { return polynomial; } // k + 1 coefficients
+
+    Element identity() const
+    {
+        Element one{};
+        one.coefficients[0] = 1;
+        return one;
+    }
+    Element multiply(const Element &x, const Element &y) const
+    {
+        // Schoolbook product with every coefficient kept reduced, then the terms of degree k
+        // and up folded back with x^k = -(f_0 + f_1 x + ... + f_(k-1) x^(k-1))
+        std::array<uint32_t, 2 * maxFieldDegree> product{};
+        for (unsigned i = 0; i < fieldDegree; ++i)
+        {
+            if (x.coefficients[i] == 0)
+                continue;
+            for (unsigned j = 0; j < fieldDegree; ++j)
+                product[i + j] = add(product[i + j], arithmetic.reduce(static_cast<uint64_t>(x.coefficients[i]) * y.coefficients[j]));
+        }
+        for (unsigned i = 2 * fieldDegree - 2; i >= fieldDegree; --i)
+        {
+            uint32_t top = product[i];
+            if (top == 0)
+                continue;
+            for (unsigned j = 0; j < fieldDegree; ++j)
+                product[i - fieldDegree + j] = add(product[i - fieldDegree + j], arithmetic.reduce(static_cast<uint64_t>(top) * negated[j]));
+        }
+        Element result{};
+        for (unsigned i = 0; i < fieldDegree; ++i)
+            result.coefficients[i] = product[i];
+        return result;
+    }
+    bool invertible(const Element &x) const { return !(x == Element{}); }
+    std::vector<PrimePower> exponentFactors() const;
+    uint64_t hash(const Element &x) const
+    {
+        uint64_t value = 0;
+        for (unsigned i = 0; i < fieldDegree; ++i)
+            value = (value ^ x.coefficients[i]) * 0x100000001b3ull;
+        return value;
+    }
+
+    // The class x of the variable
+    Element generatorX() const;
+
+private:
+    uint32_t add(uint32_t a, uint32_t b) const
+    {
+        uint32_t sum = a + b; // Both below p < 2^32, so the sum wraps at most once
+        return sum < a || sum >= arithmetic.modulus ? sum - arithmetic.modulus : sum;
+    }
+    void usePolynomial(const std::vector<uint32_t> &candidate);
+    bool irreducible() const;
+
+    Barrett32 arithmetic;
+    unsigned fieldDegree;
+    std::vector<uint32_t> polynomial;
+    std::array<uint32_t, maxFieldDegree> negated{}; // -f_j mod p
+};
+
+// Shape and order of one element: "matrix:a,b,c,d" or "gaussian:a,b" mod modulo, or
+// "gf:P^K:c0,c1,..." (constant term first) in GF(P^K). Prints the order found from the
+// factored exponent bound, by baby-step giant-step and by stepping, with timings, and
+// x^power when power is nonzero.
+struct GroupSequenceOptions
+{
+    std::string element;
+    uint64_t modulo = 9;
+    uint64_t power = 0;
+};
+
+int runGroupSequence(const GroupSequenceOptions &options);
+
+#endif
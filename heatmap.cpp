@@ -0,0 +1,231 @@
+#include "heatmap.h"
+#include "engine.h"
+#include "image.h"
+#include "metrics.h"
+#include "order.h"
+#include "raster.h"
+#include "simd.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "totient.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    const uint32_t bandRows = 64;      // Rows computed, then written, at a time
+    const uint32_t tileColumns = 256;  // Bases per scheduled tile
+    const uint32_t maxDimension = 1u << 20;
+    const uint32_t maxTerminalDimension = 1024; // The terminal view holds the whole frame
+    const uint8_t paletteBlack = 16;           // xterm cube black, unaffected by the theme
+
+    // Pixels of one band: RGB triples for an image file, or one xterm palette index each for
+    // the terminal view (see raster.h)
+    struct Band
+    {
+        uint8_t *pixels;
+        uint32_t width;
+        bool palette;
+    };
+
+    MetricCounter &ordersMetric = metricCounter("sh_orders", "Sequence shapes (orders) computed.");
+
+    void paint(const Band &band, uint32_t row, uint32_t column, uint64_t order, uint32_t modulus)
+    {
+        float value = modulus > 2 ? static_cast<float>(order) / static_cast<float>(modulus - 1) : 1.0f;
+        size_t pixel = static_cast<size_t>(row) * band.width + column;
+        if (band.palette)
+            band.pixels[pixel] = heatColour(value);
+        else
+            heatRgb(value, band.pixels + pixel * 3);
+    }
+
+    // Orders for moduli firstModulus .. firstModulus + rows - 1 and bases firstBase ..
+    // firstBase + columns - 1 into a band (already cleared to black), from the lambdas of
+    // the tile's rows (see totient.h). Odd moduli run a whole row of bases through
+    // unitOrdersOfBases(); even moduli, which have no Montgomery form, take one base across
+    // the tile's even moduli at a time.
+    void renderTile(uint32_t firstModulus, uint32_t rows, uint32_t firstBase, uint32_t columns, const Band &band)
+    {
+        ScopedStatTimer timer(STAT_TIME_TILE);
+        TraceSpan span("tile", "heatmap");
+        SimdLevel level = activeSimdLevel();
+        std::vector<uint32_t> units, unitColumns, unitLambdas, evenModuli, evenRows, lambdas(rows);
+        std::vector<uint64_t> orders(std::max(columns, rows));
+        uint64_t computed = 0;
+        loadTotients(firstModulus, rows, nullptr, lambdas.data());
+
+        for (uint32_t row = 0; row < rows; ++row)
+        {
+            uint32_t modulus = firstModulus + row;
+            if (modulus <= 2)
+            {
+                for (uint32_t c = 0; c < columns; ++c)
+                {
+                    if (modulus == 1 || ((firstBase + c) & 1))
+                        paint(band, row, firstBase - 1 + c, 1, modulus);
+                }
+                continue;
+            }
+            if (!(modulus & 1))
+            {
+                evenModuli.push_back(modulus);
+                evenRows.push_back(row);
+                continue;
+            }
+
+            units.clear();
+            unitColumns.clear();
+            for (uint32_t c = 0; c < columns; ++c)
+            {
+                uint32_t reduced = (firstBase + c) % modulus;
+                if (reduced != 0 && gcd64(reduced, modulus) == 1)
+                {
+                    units.push_back(reduced);
+                    unitColumns.push_back(c);
+                }
+            }
+            unitOrdersOfBases(modulus, lambdas[row], units.data(), units.size(), orders.data(), level);
+            for (size_t u = 0; u < units.size(); ++u)
+                paint(band, row, firstBase - 1 + unitColumns[u], orders[u], modulus);
+            computed += units.size();
+        }
+
+        // Even moduli: only odd bases are units
+        for (uint32_t c = 0; c < columns && !evenModuli.empty(); ++c)
+        {
+            uint32_t base = firstBase + c;
+            if (!(base & 1))
+                continue;
+            units.clear();
+            unitColumns.clear();
+            unitLambdas.clear();
+            for (size_t e = 0; e < evenModuli.size(); ++e)
+            {
+                if (gcd64(base % evenModuli[e], evenModuli[e]) == 1)
+                {
+                    units.push_back(evenModuli[e]);
+                    unitColumns.push_back(evenRows[e]);
+                    unitLambdas.push_back(lambdas[evenRows[e]]);
+                }
+            }
+            unitOrdersFromLambda(base, units.data(), unitLambdas.data(), units.size(), orders.data(), level);
+            for (size_t u = 0; u < units.size(); ++u)
+                paint(band, unitColumns[u], base - 1, orders[u], units[u]);
+            computed += units.size();
+        }
+
+        statAdd(STAT_TILES);
+        ordersMetric.add(computed);
+    }
+
+    // Every band of the grid in order, tiles of a band in parallel; written is called with
+    // each finished band and its row count, and returns false to stop
+    template <class Written>
+    void renderBands(const HeatmapOptions &options, Band band, size_t bandBytes, Written written)
+    {
+        uint32_t tiles = (options.bases - 1) / tileColumns + 1;
+        for (uint32_t firstRow = 0; firstRow < options.moduli; firstRow += bandRows)
+        {
+            uint32_t rows = std::min(bandRows, options.moduli - firstRow);
+            std::fill(band.pixels, band.pixels + bandBytes, band.palette ? paletteBlack : 0);
+            sharedThreadPool().parallelFor(0, tiles, 1, [&](uint64_t begin, uint64_t end, unsigned)
+            {
+                for (uint64_t tile = begin; tile < end; ++tile)
+                {
+                    uint32_t firstColumn = static_cast<uint32_t>(tile) * tileColumns;
+                    uint32_t columns = std::min(tileColumns, options.bases - firstColumn);
+                    renderTile(firstRow + 1, rows, firstColumn + 1, columns, band);
+                }
+            });
+            if (!written(firstRow, rows))
+                return;
+        }
+    }
+
+    // The whole grid as one half-block frame: two moduli per text row, one base per column
+    int drawHeatmap(const HeatmapOptions &options)
+    {
+        if (options.bases > maxTerminalDimension || options.moduli > maxTerminalDimension)
+        {
+            std::cout << "\033[31mThe terminal heatmap is limited to " << maxTerminalDimension << " per side.\033[0m\n";
+            return 1;
+        }
+        HalfBlockCanvas canvas;
+        canvas.resize(static_cast<int>(options.bases), static_cast<int>((options.moduli + 1) / 2), paletteBlack);
+        std::vector<uint8_t> pixels(static_cast<size_t>(options.bases) * bandRows);
+        renderBands(options, Band{pixels.data(), options.bases, true}, pixels.size(), [&](uint32_t firstRow, uint32_t rows)
+        {
+            for (uint32_t row = 0; row < rows; ++row)
+            {
+                for (uint32_t x = 0; x < options.bases; ++x)
+                    canvas.set(static_cast<int>(x), static_cast<int>(firstRow + row), pixels[static_cast<size_t>(row) * options.bases + x]);
+            }
+            return true;
+        });
+
+        std::string frame;
+        canvas.encode(frame);
+        std::cout << frame << "Bases 1.." << options.bases << " across, moduli 1.." << options.moduli << " down.\n";
+        statAdd(STAT_BYTES_WRITTEN, frame.size());
+        return 0;
+    }
+}
+
+// Bands are computed one after another (tiles of a band in parallel), so memory stays at
+// one band of pixels whatever the size of the image
+int runHeatmap(const HeatmapOptions &options)
+{
+    if (options.bases == 0 || options.moduli == 0 || options.bases > maxDimension || options.moduli > maxDimension)
+    {
+        std::cout << "\033[31mInvalid heatmap size (1 to " << maxDimension << " per side).\033[0m\n";
+        return 1;
+    }
+    if (options.outputPath == "-")
+        return drawHeatmap(options);
+
+    ImageWriter writer;
+    if (!writer.open(options.outputPath, imageFormatForPath(options.outputPath), options.bases, options.moduli))
+    {
+        std::cout << "\033[31mCannot open output file " << options.outputPath << ".\033[0m\n";
+        return 1;
+    }
+
+    uint32_t width = options.bases;
+    std::vector<uint8_t> band(static_cast<size_t>(width) * bandRows * 3);
+    auto started = std::chrono::steady_clock::now();
+    bool failed = false;
+
+    renderBands(options, Band{band.data(), width, false}, band.size(), [&](uint32_t firstRow, uint32_t rows)
+    {
+        {
+            TraceSpan span("write", "io");
+            if (!writer.writeRows(band.data(), rows))
+            {
+                failed = true;
+                return false;
+            }
+            statAdd(STAT_BYTES_WRITTEN, static_cast<uint64_t>(rows) * width * 3);
+        }
+
+        uint32_t done = firstRow + rows;
+        statNote("heatmap_rows", std::to_string(done) + "/" + std::to_string(options.moduli));
+        std::cout << "\rHeatmap: " << done << " of " << options.moduli << " rows (" << 100ull * done / options.moduli << "%)";
+        std::cout.flush();
+        return true;
+    });
+
+    if (failed || !writer.finish())
+    {
+        std::cout << "\n\033[31mCannot write " << options.outputPath << ".\033[0m\n";
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "\nWrote " << options.bases << "x" << options.moduli << " heatmap to " << options.outputPath << " in " << seconds
+              << " s.\n";
+    return 0;
+}
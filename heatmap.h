@@ -0,0 +1,22 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <cstdint>
+#include <string>
+
+// Image of multiplicative orders over a (base, modulus) grid. Pixel (b - 1, n - 1) shows
+// ord_n(b) / (n - 1) on the heat ramp (red for primitive roots of a prime), black where b
+// is not a unit modulo n. The grid is computed in bands of rows, each split into tiles
+// that run on sharedThreadPool(), and every band is written as soon as it is complete.
+// An output path of "-" draws the grid in the terminal instead, with the half-block
+// rasterizer of raster.h (up to 1024 per side).
+struct HeatmapOptions
+{
+    uint32_t bases = 1024;  // Image width: bases 1..bases
+    uint32_t moduli = 1024; // Image height: moduli 1..moduli
+    std::string outputPath; // .png for PNG, "-" for the terminal, anything else for PPM
+};
+
+int runHeatmap(const HeatmapOptions &options);
+
+#endif
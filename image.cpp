@@ -0,0 +1,156 @@
+#include "image.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+    const uint32_t storedBlockBytes = 65535; // Largest stored deflate block
+
+    struct Crc32Table
+    {
+        uint32_t entries[256];
+
+        Crc32Table()
+        {
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                entries[n] = c;
+            }
+        }
+    };
+
+    const Crc32Table crcTable;
+
+    uint32_t crc32(uint32_t crc, const char *data, size_t length)
+    {
+        crc = ~crc;
+        for (size_t i = 0; i < length; ++i)
+            crc = crcTable.entries[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void appendU32BigEndian(std::string &out, uint32_t value)
+    {
+        out += static_cast<char>(value >> 24);
+        out += static_cast<char>(value >> 16);
+        out += static_cast<char>(value >> 8);
+        out += static_cast<char>(value);
+    }
+}
+
+ImageFormat imageFormatForPath(const std::string &path)
+{
+    std::string extension = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    return extension == ".png" ? IMAGE_PNG : IMAGE_PPM;
+}
+
+bool ImageWriter::open(const std::string &path, ImageFormat imageFormat, uint32_t imageWidth, uint32_t imageHeight)
+{
+    format = imageFormat;
+    width = imageWidth;
+    height = imageHeight;
+    rowsWritten = 0;
+    adlerA = 1;
+    adlerB = 0;
+    file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file || width == 0 || height == 0)
+        return false;
+
+    if (format == IMAGE_PPM)
+    {
+        file << "P6\n" << width << " " << height << "\n255\n";
+        return static_cast<bool>(file);
+    }
+
+    file.write("\x89PNG\r\n\x1A\n", 8);
+    std::string header;
+    appendU32BigEndian(header, width);
+    appendU32BigEndian(header, height);
+    header += '\x08'; // 8 bits per sample
+    header += '\x02'; // Truecolour
+    header.append(3, '\0'); // Deflate, adaptive filtering, no interlace
+    writeChunk("IHDR", header);
+    return static_cast<bool>(file);
+}
+
+// PNG rows get a filter byte (0, none) and are cut into stored blocks; the zlib header
+// opens the first band and the Adler-32 closes the last one
+bool ImageWriter::writeRows(const uint8_t *pixels, uint32_t rows)
+{
+    rows = std::min(rows, height - rowsWritten);
+    size_t rowBytes = static_cast<size_t>(width) * 3;
+    if (format == IMAGE_PPM)
+    {
+        file.write(reinterpret_cast<const char *>(pixels), static_cast<std::streamsize>(rowBytes * rows));
+        rowsWritten += rows;
+        return static_cast<bool>(file);
+    }
+
+    std::string raw;
+    raw.reserve((rowBytes + 1) * rows);
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        raw += '\0';
+        raw.append(reinterpret_cast<const char *>(pixels) + row * rowBytes, rowBytes);
+    }
+    for (size_t offset = 0; offset < raw.size();)
+    {
+        size_t batch = std::min<size_t>(raw.size() - offset, 5552); // Keeps the sums below 2^32
+        for (size_t i = offset; i < offset + batch; ++i)
+        {
+            adlerA += static_cast<uint8_t>(raw[i]);
+            adlerB += adlerA;
+        }
+        adlerA %= 65521;
+        adlerB %= 65521;
+        offset += batch;
+    }
+
+    bool last = rowsWritten + rows == height;
+    scratch.clear();
+    if (rowsWritten == 0)
+        scratch += "\x78\x01";
+    for (size_t offset = 0; offset < raw.size(); offset += storedBlockBytes)
+    {
+        uint32_t length = static_cast<uint32_t>(std::min<size_t>(raw.size() - offset, storedBlockBytes));
+        scratch += static_cast<char>(last && offset + length == raw.size() ? 1 : 0);
+        scratch += static_cast<char>(length & 0xFF);
+        scratch += static_cast<char>(length >> 8);
+        scratch += static_cast<char>(~length & 0xFF);
+        scratch += static_cast<char>((~length >> 8) & 0xFF);
+        scratch.append(raw, offset, length);
+    }
+    if (last)
+        appendU32BigEndian(scratch, (adlerB << 16) | adlerA);
+    writeChunk("IDAT", scratch);
+    rowsWritten += rows;
+    return static_cast<bool>(file);
+}
+
+bool ImageWriter::finish()
+{
+    if (rowsWritten != height)
+        return false;
+    if (format == IMAGE_PNG)
+        writeChunk("IEND", std::string());
+    file.close();
+    return !file.fail();
+}
+
+void ImageWriter::writeChunk(const char *type, const std::string &data)
+{
+    std::string prefix;
+    appendU32BigEndian(prefix, static_cast<uint32_t>(data.size()));
+    prefix.append(type, 4);
+    uint32_t crc = crc32(crc32(0, type, 4), data.data(), data.size());
+    std::string suffix;
+    appendU32BigEndian(suffix, crc);
+    file.write(prefix.data(), prefix.size());
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    file.write(suffix.data(), suffix.size());
+}
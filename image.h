@@ -0,0 +1,46 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Streaming RGB image writer: rows are written top to bottom in bands as they are
+// produced, so an image never has to fit in memory. PPM (binary P6) is written as is;
+// PNG is written uncompressed, with the pixel rows in stored deflate blocks, one IDAT
+// chunk per band.
+
+enum ImageFormat
+{
+    IMAGE_PPM,
+    IMAGE_PNG
+};
+
+// IMAGE_PNG for a ".png" path (any case), otherwise IMAGE_PPM
+ImageFormat imageFormatForPath(const std::string &path);
+
+class ImageWriter
+{
+public:
+    bool open(const std::string &path, ImageFormat format, uint32_t width, uint32_t height);
+
+    // rows complete rows of width * 3 bytes (R, G, B); returns false once a write failed
+    bool writeRows(const uint8_t *pixels, uint32_t rows);
+
+    // Write the trailer (PNG) and close; every row must have been written
+    bool finish();
+
+private:
+    void writeChunk(const char *type, const std::string &data);
+
+    std::ofstream file;
+    ImageFormat format = IMAGE_PPM;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t rowsWritten = 0;
+    uint32_t adlerA = 1; // Adler-32 of the zlib stream (PNG only)
+    uint32_t adlerB = 0;
+    std::string scratch;
+};
+
+#endif
@@ -1,119 +1,205 @@
+#include <algorithm>
 #include <iostream>
 #include <vector>
-#include <set>
+#include <string>
+#include <cstring>
+#include <fstream>
 #include <limits>
 #include <thread>
 #include <chrono>
 #include <gmpxx.h>
 #include <iomanip> // For std::setw and formatting output
 #include <conio.h> // For non-blocking key input in Windows
+#include "artin.h"
+#include "cluster.h"
+#include "dispatch.h"
+#include "engine.h"
+#include "expansion.h"
+#include "generate.h"
+#include "group.h"
+#include "groupseq.h"
+#include "heatmap.h"
+#include "metrics.h"
+#include "platform.h"
+#include "pseudoprime.h"
+#include "ranges.h"
+#include "sieve.h"
+#include "simd.h"
+#include "sonify.h"
+#include "spectrum.h"
+#include "stats.h"
+#include "summary.h"
+#include "sweep.h"
+#include "threadpool.h"
+#include "totient.h"
+#include "trace.h"
+#include "waveplot.h"
+#include "wieferich.h"
 
 // Global Variables for Sequence and User Controls
 mpz_class base = 2;
 mpz_class modulo = 9;
 std::vector<mpz_class> sequencePattern;
+WavePyramid wavePyramid; // Min/max summary of sequencePattern for the wave plot
+RangeIndex rangeIndex;   // Range aggregates over sequencePattern, built on the first query
+bool rangeIndexStale = true;
 bool running = true;
 bool sequenceRunning = false;
 bool showLoadingBar = true;
 bool animationRunning = false;
 int animationSpeed = 50; // Set speed of animation (in milliseconds per update)
+bool dumpStatsOnExit = false;
+
+// Exported metrics (see metrics.h)
+MetricCounter &termsMetric = metricCounter("sh_terms", "Sequence terms produced.");
+MetricHistogram &generateSecondsMetric = metricHistogram("sh_generate_seconds", "Time to generate one sequence.",
+                                                         {0.0001, 0.001, 0.01, 0.1, 1, 10, 100});
+MetricHistogram &frameSecondsMetric = metricHistogram("sh_frame_seconds", "Time to compose and write one animation frame.",
+                                                      {0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1});
 
 // Forward Declarations
 void displayLoadingBar(int progress, int total);
+void appendLoadingBar(std::string &out, int progress, int total);
 void displayAnimation();
+void displayWavePlot();
 void handleSettingsMenu();
+void queryRange();
+bool parseUint64(const char *text, uint64_t &value);
+bool parseRange(const std::string &text, uint64_t &first, uint64_t &last);
 
-// Modular exponentiation function using GMP's mpz_class
-mpz_class modularExponentiation(mpz_class base, mpz_class exponent, mpz_class mod)
+// Write a composed block of output in one call and account for it
+void writeOutput(const std::string &text)
 {
-    mpz_class result = 1;
-    mpz_powm(result.get_mpz_t(), base.get_mpz_t(), exponent.get_mpz_t(), mod.get_mpz_t());
-    return result;
+    TraceSpan span("write", "io");
+    std::cout << text;
+    std::cout.flush();
+    statAdd(STAT_BYTES_WRITTEN, text.size());
 }
 
-// Function to generate the sequence pattern dynamically based on current base and modulo
-void generateSequencePattern()
+// Format every term of the current sequence (with optional loading bars) into one buffer
+std::string formatSequenceTerms()
 {
-    sequencePattern.clear();
-    std::set<mpz_class> seen;
-    mpz_class currentValue = base;
-    int i = 1;
-
-    while (true)
-    {
-        currentValue = modularExponentiation(base, i++, modulo);
-        if (seen.count(currentValue) > 0)
-            break;
-        seen.insert(currentValue);
-        sequencePattern.push_back(currentValue);
-    }
-
-    std::cout << "\nGenerated Sequence Pattern:\n";
+    TraceSpan span("format", "sequence");
+    std::string out;
+    out.reserve(sequencePattern.size() * (showLoadingBar ? 64 : 24));
     for (size_t idx = 0; idx < sequencePattern.size(); ++idx)
     {
-        std::cout << "Term " << idx + 1 << ": " << sequencePattern[idx];
+        out += "Term ";
+        out += std::to_string(idx + 1);
+        out += ": ";
+        out += sequencePattern[idx].get_str();
         if (showLoadingBar)
         {
-            displayLoadingBar(idx + 1, sequencePattern.size());
+            appendLoadingBar(out, idx + 1, sequencePattern.size());
         }
-        std::cout << "\n";
+        out += "\n";
+    }
+    return out;
+}
+
+// Function to generate the sequence pattern dynamically based on current base and modulo
+void generateSequencePattern()
+{
+    {
+        ScopedStatTimer timer(STAT_TIME_GENERATE);
+        TraceSpan span("generate", "sequence");
+        auto started = std::chrono::steady_clock::now();
+        // Kernel and cycle detection are picked per modulus from the calibrated cost model
+        generateSequenceTerms(base, modulo, sequencePattern);
+        statAdd(STAT_TERMS, sequencePattern.size());
+        wavePyramid.build(sequencePattern, modulo);
+        rangeIndexStale = true;
+
+        termsMetric.add(sequencePattern.size());
+        if (metricsEnabled.load(std::memory_order_relaxed))
+            generateSecondsMetric.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
     }
+
+    writeOutput("\nGenerated Sequence Pattern:\n" + formatSequenceTerms());
     sequenceRunning = false;
 }
 
 // Loading bar function for visual feedback
 void displayLoadingBar(int progress, int total)
+{
+    std::string bar;
+    appendLoadingBar(bar, progress, total);
+    writeOutput(bar);
+}
+
+// Append the loading bar for one term to an output buffer
+void appendLoadingBar(std::string &out, int progress, int total)
 {
     int barWidth = 30;
     int pos = (progress * barWidth) / total;
 
-    std::cout << " [";
+    out += " [";
     for (int i = 0; i < barWidth; ++i)
     {
         if (i < pos)
-            std::cout << "\033[32m=\033[0m";
+            out += "\033[32m=\033[0m";
         else if (i == pos)
-            std::cout << "\033[32m>\033[0m";
+            out += "\033[32m>\033[0m";
         else
-            std::cout << " ";
+            out += " ";
     }
-    std::cout << "] " << (100 * progress) / total << "% ";
-    std::cout.flush();
+    out += "] ";
+    out += std::to_string((100 * progress) / total);
+    out += "% ";
 }
 
 // Function to animate the wave pattern using the sequence in memory
 void displayAnimation()
 {
+    traceSetThreadName("animation");
     animationRunning = true;
     int direction = 1; // Forward direction
     int index = 0;
-    const int termLabelWidth = 10; // Adjust to fit longest label ("Term X:")
-    const int valueWidth = 10;     // Adjust to fit largest value
+    const size_t termLabelWidth = 10; // Adjust to fit longest label ("Term X:")
+    const size_t valueWidth = 10;     // Adjust to fit largest value
+
+    std::string frame;
 
     while (animationRunning)
     {
         system("CLS"); // Clear console for a clean frame
 
-        for (size_t idx = 0; idx < sequencePattern.size(); ++idx)
         {
-            std::cout << std::left << std::setw(termLabelWidth)
-                      << ("Term " + std::to_string(idx + 1) + ":");
-            std::cout << std::setw(valueWidth) << sequencePattern[idx];
+            ScopedStatTimer timer(STAT_TIME_FRAME);
+            TraceSpan span("compose frame", "render");
+            auto composeStarted = std::chrono::steady_clock::now();
 
-            if (idx == index && showLoadingBar)
-            {
-                displayLoadingBar(idx + 1, sequencePattern.size()); // Active term shows progress
-            }
-            else if (showLoadingBar)
+            // Compose the whole frame first so it reaches the console in a single write
+            frame.clear();
+            for (size_t idx = 0; idx < sequencePattern.size(); ++idx)
             {
-                std::cout << " []"; // Empty status bar when not selected
+                std::string label = "Term " + std::to_string(idx + 1) + ":";
+                std::string value = sequencePattern[idx].get_str();
+                frame += label;
+                frame.append(label.size() < termLabelWidth ? termLabelWidth - label.size() : 0, ' ');
+                frame += value;
+                frame.append(value.size() < valueWidth ? valueWidth - value.size() : 0, ' ');
+
+                if (idx == index && showLoadingBar)
+                {
+                    appendLoadingBar(frame, idx + 1, sequencePattern.size()); // Active term shows progress
+                }
+                else if (showLoadingBar)
+                {
+                    frame += " []"; // Empty status bar when not selected
+                }
+
+                frame += "\n";
             }
 
-            std::cout << "\n";
-        }
+            // Add reminder at the bottom of the console
+            frame += "\nPress '4' and Enter to stop the animation...\n";
 
-        // Add reminder at the bottom of the console
-        std::cout << "\nPress '4' and Enter to stop the animation...\n";
+            writeOutput(frame);
+            statAdd(STAT_FRAMES);
+            if (metricsEnabled.load(std::memory_order_relaxed))
+                frameSecondsMetric.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - composeStarted).count());
+        }
 
         index += direction;
 
@@ -129,6 +215,87 @@ void displayAnimation()
     std::cout << "\n\n\033[31mAnimation stopped.\033[0m\n\n";
 }
 
+// Interactive plot of term value against index. Keys act immediately (no Enter); every
+// frame is answered from wavePyramid, so zooming and panning cost the same at any length.
+void displayWavePlot()
+{
+    if (sequencePattern.empty())
+    {
+        std::cout << "\nNo sequence generated yet. Please set base and modulo.\n";
+        return;
+    }
+
+    static WaveRenderer renderer;
+    static WaveStyle style = WAVE_BRAILLE;
+    WaveView view;
+    view.span = wavePyramid.size();
+    std::string frame;
+    enableUtf8Console();
+
+    while (true)
+    {
+        int columns = 80, rows = 24;
+        terminalSize(columns, rows);
+        clampWaveView(view, wavePyramid.size());
+
+        {
+            ScopedStatTimer timer(STAT_TIME_FRAME);
+            auto composeStarted = std::chrono::steady_clock::now();
+            // One column short of the window so the last cell never wraps; header and key take 3 rows
+            renderer.render(wavePyramid, view, style, std::max(columns - 1, 8), std::max(rows - 3, 4), frame);
+            writeOutput(frame);
+            statAdd(STAT_FRAMES);
+            if (metricsEnabled.load(std::memory_order_relaxed))
+                frameSecondsMetric.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - composeStarted).count());
+        }
+
+        int key = _getch();
+        if (key == 0 || key == 224) // Arrow keys arrive as a prefix and a scan code
+        {
+            switch (_getch())
+            {
+            case 75: key = 'a'; break;
+            case 77: key = 'd'; break;
+            case 72: key = 'w'; break;
+            case 80: key = 's'; break;
+            default: key = 0;
+            }
+        }
+
+        uint64_t step = std::max<uint64_t>(view.span / 4, 1);
+        uint64_t center = view.first + view.span / 2;
+        switch (key)
+        {
+        case 'a':
+            view.first = view.first > step ? view.first - step : 0;
+            break;
+        case 'd':
+            view.first += step;
+            break;
+        case 'w':
+        case '+':
+            view.span = std::max<uint64_t>(view.span / 2, 1);
+            view.first = center > view.span / 2 ? center - view.span / 2 : 0;
+            break;
+        case 's':
+        case '-':
+            view.span = view.span * 2;
+            view.first = center > view.span / 2 ? center - view.span / 2 : 0;
+            break;
+        case 'r':
+            view.first = 0;
+            view.span = wavePyramid.size();
+            break;
+        case 'm':
+            style = static_cast<WaveStyle>((style + 1) % WAVE_STYLE_COUNT);
+            break;
+        case 'q':
+            std::cout << "\n";
+            return;
+        }
+    }
+}
+
 // Function to handle user input and control flow
 void handleUserInput()
 {
@@ -141,7 +308,12 @@ void handleUserInput()
         std::cout << "4. Start/Stop animation\n";
         std::cout << "5. Toggle loading bar (current: " << (showLoadingBar ? "ON" : "OFF") << ")\n";
         std::cout << "6. Settings\n";
-        std::cout << "7. Exit program\n";
+        std::cout << "7. Show statistics\n";
+        std::cout << "8. Plot sequence as a wave\n";
+        std::cout << "9. Summarize sequence\n";
+        std::cout << "10. Query a range of terms\n";
+        std::cout << "11. Analyze unit group of the modulo\n";
+        std::cout << "12. Exit program\n";
         std::cout << "Select an option: ";
         std::cout.flush();
 
@@ -177,16 +349,18 @@ void handleUserInput()
         case 2:
         {
             std::string newModulo;
+            mpz_class parsed;
             std::cout << "Enter new modulo: ";
-            if (std::cin >> newModulo)
+            // The same check as --modulo: every sequence routine assumes modulo >= 1
+            if (std::cin >> newModulo && parsed.set_str(newModulo, 10) == 0 && parsed >= 1)
             {
-                modulo = mpz_class(newModulo);
+                modulo = parsed;
                 std::cout << "\nModulo updated to " << modulo << "\n";
                 generateSequencePattern(); // Regenerate sequence automatically
             }
             else
             {
-                std::cout << "\033[31mInvalid modulo input.\033[0m\n";
+                std::cout << "\033[31mInvalid modulo input (a positive integer is required).\033[0m\n";
                 std::cin.clear();
                 std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
             }
@@ -195,16 +369,7 @@ void handleUserInput()
         case 3:
             if (!sequencePattern.empty())
             {
-                std::cout << "\nDisplaying current sequence:\n";
-                for (size_t idx = 0; idx < sequencePattern.size(); ++idx)
-                {
-                    std::cout << "Term " << idx + 1 << ": " << sequencePattern[idx];
-                    if (showLoadingBar)
-                    {
-                        displayLoadingBar(idx + 1, sequencePattern.size());
-                    }
-                    std::cout << "\n";
-                }
+                writeOutput("\nDisplaying current sequence:\n" + formatSequenceTerms());
             }
             else
             {
@@ -231,6 +396,27 @@ void handleUserInput()
             handleSettingsMenu();
             break;
         case 7:
+            printStatsTable(std::cout);
+            std::cout << "\n";
+            printStatsJson(std::cout);
+            break;
+        case 8:
+            displayWavePlot();
+            break;
+        case 9:
+            printSummary(std::cout, summarizeSequence(base, modulo));
+            break;
+        case 10:
+            queryRange();
+            break;
+        case 11:
+        {
+            GroupOptions options;
+            options.modulo = modulo;
+            runGroupAnalysis(options);
+            break;
+        }
+        case 12:
             running = false;
             animationRunning = false; // Ensure animation stops
             std::cout << "\nExiting program...\n";
@@ -241,6 +427,45 @@ void handleUserInput()
     }
 }
 
+// Sum, minimum and maximum of t_k over any exponent range, and optionally how often a value
+// occurs in it, answered from the stored terms without stepping through the range
+void queryRange()
+{
+    if (sequencePattern.empty())
+    {
+        std::cout << "\nNo sequence generated yet. Please set base and modulo.\n";
+        return;
+    }
+    std::string range, value;
+    uint64_t first = 0, last = 0;
+    std::cout << "Enter exponent range FIRST:LAST: ";
+    if (!(std::cin >> range) || !parseRange(range, first, last) || first == 0 || first > last)
+    {
+        std::cout << "\033[31mInvalid range. Use FIRST:LAST with 1 <= FIRST <= LAST < 2^64.\033[0m\n";
+        std::cin.clear();
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        return;
+    }
+    std::cout << "Enter a value to count, or - to skip: ";
+    mpz_class target;
+    if (!(std::cin >> value) || (value != "-" && target.set_str(value, 10) != 0))
+    {
+        std::cout << "\033[31mInvalid value input.\033[0m\n";
+        std::cin.clear();
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        return;
+    }
+
+    if (rangeIndexStale)
+    {
+        rangeIndex.build(sequencePattern, base, modulo);
+        rangeIndexStale = false;
+    }
+    printRangeAggregate(std::cout, first, last, rangeIndex.aggregate(first, last));
+    if (value != "-")
+        std::cout << "Occurrences of " << target << ": " << rangeIndex.countValue(target, first, last) << "\n";
+}
+
 // Settings Menu
 void handleSettingsMenu()
 {
@@ -248,7 +473,9 @@ void handleSettingsMenu()
     {
         std::cout << "\n\n--- Settings Menu ---\n";
         std::cout << "1. Set animation speed (current: " << animationSpeed << "ms)\n";
-        std::cout << "2. Back to main menu\n";
+        std::cout << "2. Toggle statistics collection (current: " << (statsEnabled ? "ON" : "OFF") << ")\n";
+        std::cout << "3. Reset statistics\n";
+        std::cout << "4. Back to main menu\n";
         std::cout << "Select an option: ";
         std::cout.flush();
 
@@ -277,6 +504,14 @@ void handleSettingsMenu()
             }
             break;
         case 2:
+            statsEnabled = !statsEnabled;
+            std::cout << "\nStatistics collection " << (statsEnabled ? "enabled" : "disabled") << ".\n";
+            break;
+        case 3:
+            resetStats();
+            std::cout << "\nStatistics reset.\n";
+            break;
+        case 4:
             return; // Return to main menu
         default:
             std::cout << "\033[31mInvalid option. Please try again.\033[0m\n";
@@ -284,13 +519,661 @@ void handleSettingsMenu()
     }
 }
 
+// Return the value of a "--name=value" argument, or nullptr if arg is a different option
+const char *optionValue(const char *arg, const char *name)
+{
+    size_t length = std::strlen(name);
+    return std::strncmp(arg, name, length) == 0 ? arg + length : nullptr;
+}
+
+// Parse a non-negative decimal integer that must fit in 64 bits
+bool parseUint64(const char *text, uint64_t &value)
+{
+    mpz_class parsed;
+    if (*text == '\0' || parsed.set_str(text, 10) != 0 || parsed < 0 || mpz_sizeinbase(parsed.get_mpz_t(), 2) > 64)
+        return false;
+    value = mpzToUint64(parsed);
+    return true;
+}
+
+// Parse "FIRST:LAST" into two 64-bit bounds
+bool parseRange(const std::string &text, uint64_t &first, uint64_t &last)
+{
+    size_t colon = text.find(':');
+    return colon != std::string::npos && parseUint64(text.substr(0, colon).c_str(), first) &&
+           parseUint64(text.substr(colon + 1).c_str(), last);
+}
+
+// Print the collected statistics when --stats was given
+void reportStatsOnExit()
+{
+    if (dumpStatsOnExit)
+    {
+        printStatsTable(std::cout);
+        std::cout << "\n";
+        printStatsJson(std::cout);
+    }
+}
+
 // Main program
-int main()
+int main(int argc, char *argv[])
 {
+    std::string tracePath;
+    std::string sweepRange;
+    std::string benchRange;
+    std::string baseSweepRange;
+    std::string simdBenchRange;
+    std::string orderBenchRange;
+    std::string wieferichRange;
+    uint64_t nearMissDigits = 4;
+    std::string batchPath;
+    std::string outputPath;
+    uint64_t threads = 0;
+    std::string metricsPath;
+    uint64_t metricsPort = 0;
+    uint64_t metricsInterval = 1000;
+    bool generateMode = false;
+    std::string checkpointPath;
+    bool resume = false;
+    uint64_t checkpointInterval = 30;
+    std::string coordinatorAddress;
+    std::string workerAddress;
+    uint64_t leaseSize = 4096;
+    uint64_t leaseTimeout = 300;
+    bool calibrateMode = false;
+    std::string heatmapPath;
+    std::string heatmapSize; // Empty = 1024, or the terminal for --heatmap=-
+    std::string audioPath;
+    SonifyOptions audio;
+    bool spectrumMode = false;
+    bool summaryMode = false;
+    std::string termRange;
+    bool groupMode = false;
+    uint64_t artinLimit = 0;
+    uint64_t primeCountLimit = 0;
+    uint64_t pseudoprimeLimit = 0;
+    std::string groupElement;
+    uint64_t groupPowerExponent = 0;
+    uint64_t expansionDenominator = 0;
+    uint64_t expansionDigits = 0;
+    bool strongOnly = false;
+    bool carmichaelOnly = false;
+    uint64_t totientLimit = 0;
+    std::string totientCachePath;
+    std::string groupFactors;
+    std::string rangeValue;
+    uint64_t spectrumTop = 10;
+    std::string calibrationPath = defaultCalibrationPath();
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *value;
+        if (std::strcmp(argv[i], "--stats") == 0)
+        {
+            statsEnabled = true;
+            dumpStatsOnExit = true;
+        }
+        else if ((value = optionValue(argv[i], "--trace=")))
+            tracePath = value;
+        else if (std::strcmp(argv[i], "--generate") == 0)
+            generateMode = true;
+        else if (std::strcmp(argv[i], "--resume") == 0)
+            resume = true;
+        else if (std::strcmp(argv[i], "--calibrate") == 0)
+            calibrateMode = true;
+        else if ((value = optionValue(argv[i], "--calibration=")))
+            calibrationPath = value;
+        else if (std::strcmp(argv[i], "--spectrum") == 0)
+            spectrumMode = true;
+        else if (std::strcmp(argv[i], "--summary") == 0)
+            summaryMode = true;
+        else if ((value = optionValue(argv[i], "--artin=")))
+        {
+            if (!parseUint64(value, artinLimit) || artinLimit < 2 || artinLimit > maxArtinLimit)
+            {
+                std::cout << "\033[31mInvalid --artin value (2 to 2^50).\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--prime-count=")))
+        {
+            if (!parseUint64(value, primeCountLimit) || primeCountLimit == 0 || primeCountLimit > maxArtinLimit)
+            {
+                std::cout << "\033[31mInvalid --prime-count value (1 to 2^50).\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--pseudoprimes=")))
+        {
+            if (!parseUint64(value, pseudoprimeLimit) || pseudoprimeLimit == 0 || pseudoprimeLimit > maxPseudoprimeLimit)
+            {
+                std::cout << "\033[31mInvalid --pseudoprimes value (1 to 2^50).\033[0m\n";
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--strong") == 0)
+            strongOnly = true;
+        else if (std::strcmp(argv[i], "--carmichael") == 0)
+            carmichaelOnly = true;
+        else if ((value = optionValue(argv[i], "--wieferich=")))
+            wieferichRange = value;
+        else if ((value = optionValue(argv[i], "--near-miss=")))
+        {
+            if (!parseUint64(value, nearMissDigits) || nearMissDigits == 0 || nearMissDigits > maxNearMissDigits)
+            {
+                std::cout << "\033[31mInvalid --near-miss value (1 to 15).\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--expansion=")))
+        {
+            if (!parseUint64(value, expansionDenominator) || expansionDenominator < 2)
+            {
+                std::cout << "\033[31mInvalid --expansion value (2 to 2^64 - 1).\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--expansion-digits=")))
+        {
+            if (!parseUint64(value, expansionDigits) || expansionDigits == 0)
+            {
+                std::cout << "\033[31mInvalid --expansion-digits value.\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--group-element=")))
+            groupElement = value;
+        else if ((value = optionValue(argv[i], "--group-power=")))
+        {
+            if (!parseUint64(value, groupPowerExponent))
+            {
+                std::cout << "\033[31mInvalid --group-power value.\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--totients=")))
+        {
+            if (!parseUint64(value, totientLimit) || totientLimit == 0 || totientLimit > maxTotientLimit)
+            {
+                std::cout << "\033[31mInvalid --totients value (1 to 2^32 - 1).\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--totient-cache=")))
+            totientCachePath = value;
+        else if (std::strcmp(argv[i], "--group") == 0)
+            groupMode = true;
+        else if ((value = optionValue(argv[i], "--factors=")))
+            groupFactors = value;
+        else if ((value = optionValue(argv[i], "--range=")))
+            termRange = value;
+        else if ((value = optionValue(argv[i], "--range-value=")))
+            rangeValue = value;
+        else if ((value = optionValue(argv[i], "--spectrum-top=")))
+        {
+            if (!parseUint64(value, spectrumTop) || spectrumTop > 1000000)
+            {
+                std::cout << "\033[31mInvalid bin count: " << value << "\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--heatmap=")))
+            heatmapPath = value;
+        else if ((value = optionValue(argv[i], "--heatmap-size=")))
+            heatmapSize = value;
+        else if ((value = optionValue(argv[i], "--audio=")))
+            audioPath = value;
+        else if ((value = optionValue(argv[i], "--note-ms=")))
+        {
+            char *end = nullptr;
+            double noteMs = std::strtod(value, &end);
+            if (end == value || *end != '\0' || !(noteMs >= 0.1 && noteMs <= 60000))
+            {
+                std::cout << "\033[31mInvalid note length (0.1 to 60000 ms): " << value << "\033[0m\n";
+                return 1;
+            }
+            audio.noteMicros = static_cast<uint32_t>(noteMs * 1000 + 0.5);
+        }
+        else if ((value = optionValue(argv[i], "--sample-rate=")))
+        {
+            uint64_t rate = 0;
+            if (!parseUint64(value, rate) || rate < 8000 || rate > 192000)
+            {
+                std::cout << "\033[31mInvalid sample rate (8000 to 192000): " << value << "\033[0m\n";
+                return 1;
+            }
+            audio.sampleRate = static_cast<uint32_t>(rate);
+        }
+        else if ((value = optionValue(argv[i], "--partials=")))
+        {
+            uint64_t partials = 0;
+            if (!parseUint64(value, partials) || partials == 0 || partials > 16)
+            {
+                std::cout << "\033[31mInvalid partial count (1 to 16): " << value << "\033[0m\n";
+                return 1;
+            }
+            audio.partials = static_cast<unsigned>(partials);
+        }
+        else if ((value = optionValue(argv[i], "--checkpoint=")))
+            checkpointPath = value;
+        else if ((value = optionValue(argv[i], "--checkpoint-interval=")))
+        {
+            if (!parseUint64(value, checkpointInterval) || checkpointInterval == 0 || checkpointInterval > 86400)
+            {
+                std::cout << "\033[31mInvalid checkpoint interval: " << value << "\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--coordinator=")))
+            coordinatorAddress = value;
+        else if ((value = optionValue(argv[i], "--worker=")))
+            workerAddress = value;
+        else if ((value = optionValue(argv[i], "--lease-size=")))
+        {
+            if (!parseUint64(value, leaseSize) || leaseSize == 0 || leaseSize > maxLeaseSize)
+            {
+                std::cout << "\033[31mInvalid lease size: " << value << "\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--lease-timeout=")))
+        {
+            if (!parseUint64(value, leaseTimeout) || leaseTimeout == 0 || leaseTimeout > 86400)
+            {
+                std::cout << "\033[31mInvalid lease timeout: " << value << "\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--metrics=")))
+            metricsPath = value;
+        else if ((value = optionValue(argv[i], "--metrics-port=")))
+        {
+            if (!parseUint64(value, metricsPort) || metricsPort == 0 || metricsPort > 65535)
+            {
+                std::cout << "\033[31mInvalid metrics port: " << value << "\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--metrics-interval=")))
+        {
+            if (!parseUint64(value, metricsInterval) || metricsInterval == 0 || metricsInterval > 3600000)
+            {
+                std::cout << "\033[31mInvalid metrics interval: " << value << "\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--base=")))
+        {
+            if (base.set_str(value, 10) != 0)
+            {
+                std::cout << "\033[31mInvalid base: " << value << "\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--modulo=")))
+        {
+            if (modulo.set_str(value, 10) != 0 || modulo < 1)
+            {
+                std::cout << "\033[31mInvalid modulo: " << value << "\033[0m\n";
+                return 1;
+            }
+        }
+        else if ((value = optionValue(argv[i], "--sweep=")))
+            sweepRange = value;
+        else if ((value = optionValue(argv[i], "--bench-pool=")))
+            benchRange = value;
+        else if ((value = optionValue(argv[i], "--base-sweep=")))
+            baseSweepRange = value;
+        else if ((value = optionValue(argv[i], "--bench-simd=")))
+            simdBenchRange = value;
+        else if ((value = optionValue(argv[i], "--bench-orders=")))
+            orderBenchRange = value;
+        else if ((value = optionValue(argv[i], "--simd=")))
+        {
+            SimdLevel limit;
+            if (!parseSimdLevel(value, limit))
+            {
+                std::cout << "\033[31mInvalid SIMD level (scalar, avx2, avx512): " << value << "\033[0m\n";
+                return 1;
+            }
+            setSimdLevelLimit(limit);
+        }
+        else if ((value = optionValue(argv[i], "--batch=")))
+            batchPath = value;
+        else if ((value = optionValue(argv[i], "--output=")))
+            outputPath = value;
+        else if ((value = optionValue(argv[i], "--threads=")))
+        {
+            if (!parseUint64(value, threads) || threads > 4096)
+            {
+                std::cout << "\033[31mInvalid thread count: " << value << "\033[0m\n";
+                return 1;
+            }
+        }
+        else
+        {
+            std::cout << "\033[31mUnknown option: " << argv[i] << "\033[0m\n";
+            return 1;
+        }
+    }
+
+    if (resume && checkpointPath.empty())
+    {
+        std::cout << "\033[31m--resume requires --checkpoint=FILE.\033[0m\n";
+        return 1;
+    }
+
+    if (!totientCachePath.empty() && !useTotientCache(totientCachePath))
+    {
+        std::cout << "\033[31mCannot read totient cache " << totientCachePath << ".\033[0m\n";
+        return 1;
+    }
+
+    if (!tracePath.empty() && !startTracing(tracePath))
+    {
+        std::cout << "\033[31mCannot open trace file " << tracePath << ".\033[0m\n";
+        return 1;
+    }
+
+    if ((!metricsPath.empty() || metricsPort != 0) &&
+        !startMetricsExporter(metricsPath, static_cast<uint16_t>(metricsPort), static_cast<int>(metricsInterval)))
+    {
+        std::cout << "\033[31mCannot start metrics exporter.\033[0m\n";
+        stopTracing();
+        return 1;
+    }
+
+    setThreadPoolSize(static_cast<unsigned>(threads));
+    if (!calibrateMode)
+        initCalibration(calibrationPath);
+
+    if (calibrateMode || spectrumMode || summaryMode || groupMode || artinLimit != 0 || primeCountLimit != 0 || pseudoprimeLimit != 0 || !wieferichRange.empty() || expansionDenominator != 0 || !groupElement.empty() || totientLimit != 0 || !termRange.empty() || !heatmapPath.empty() || !audioPath.empty() || !sweepRange.empty() || !benchRange.empty() || !batchPath.empty() || generateMode || !workerAddress.empty() ||
+        !baseSweepRange.empty() || !simdBenchRange.empty() || !orderBenchRange.empty())
+    {
+        int status = 0;
+        if (calibrateMode)
+        {
+            runCalibration(&std::cout);
+            if (!calibrationPath.empty() && !saveCalibration(calibrationPath))
+            {
+                std::cout << "\033[31mCannot write calibration file " << calibrationPath << ".\033[0m\n";
+                status = 1;
+            }
+        }
+        else if (!heatmapPath.empty())
+        {
+            // "N" for an N x N grid, or "BASESxMODULI"
+            HeatmapOptions options;
+            uint64_t bases = 0, moduli = 0;
+            if (heatmapSize.empty())
+            {
+                int columns = 80, rows = 25;
+                bool terminal = heatmapPath == "-";
+                if (terminal)
+                    terminalSize(columns, rows);
+                heatmapSize = terminal ? std::to_string(columns) + "x" + std::to_string(2 * std::max(rows - 2, 1)) : "1024";
+            }
+            size_t cross = heatmapSize.find('x');
+            bool valid = cross == std::string::npos ? parseUint64(heatmapSize.c_str(), bases) && (moduli = bases, true)
+                                                    : parseUint64(heatmapSize.substr(0, cross).c_str(), bases) &&
+                                                          parseUint64(heatmapSize.substr(cross + 1).c_str(), moduli);
+            if (!valid || bases > UINT32_MAX || moduli > UINT32_MAX)
+            {
+                std::cout << "\033[31mUsage: --heatmap-size=N or --heatmap-size=BASESxMODULI.\033[0m\n";
+                stopMetricsExporter();
+                stopTracing();
+                return 1;
+            }
+            options.bases = static_cast<uint32_t>(bases);
+            options.moduli = static_cast<uint32_t>(moduli);
+            options.outputPath = heatmapPath;
+            status = runHeatmap(options);
+        }
+        else if (!audioPath.empty())
+        {
+            audio.base = base;
+            audio.modulo = modulo;
+            audio.outputPath = audioPath;
+            status = runSonify(audio);
+        }
+        else if (spectrumMode)
+        {
+            SpectrumOptions options;
+            options.base = base;
+            options.modulo = modulo;
+            options.outputPath = outputPath;
+            options.top = static_cast<unsigned>(spectrumTop);
+            status = runSpectrum(options);
+        }
+        else if (summaryMode && batchPath.empty())
+        {
+            std::string json = summaryJson(base, modulo, summarizeSequence(base, modulo)) + "\n";
+            if (outputPath.empty())
+                std::cout << json;
+            else
+            {
+                std::ofstream file(outputPath, std::ios::out | std::ios::binary | std::ios::trunc);
+                file << json;
+                if (!file)
+                {
+                    std::cout << "\033[31mCannot write " << outputPath << ".\033[0m\n";
+                    status = 1;
+                }
+                else
+                    std::cout << "Wrote the summary to " << outputPath << ".\n";
+            }
+        }
+        else if (primeCountLimit != 0)
+        {
+            auto started = std::chrono::steady_clock::now();
+            uint64_t count = countPrimes(primeCountLimit);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            std::cout << count << " primes up to " << primeCountLimit << " (" << seconds << " s).\n";
+        }
+        else if (totientLimit != 0)
+        {
+            TotientOptions options;
+            options.limit = totientLimit;
+            options.outputPath = outputPath;
+            status = runTotientTable(options);
+        }
+        else if (artinLimit != 0)
+        {
+            if (base < 0 || mpz_sizeinbase(base.get_mpz_t(), 2) > 64)
+            {
+                std::cout << "\033[31mThe Artin search needs a 64-bit --base.\033[0m\n";
+                stopMetricsExporter();
+                stopTracing();
+                return 1;
+            }
+            ArtinOptions options;
+            options.base = mpzToUint64(base);
+            options.limit = artinLimit;
+            options.outputPath = outputPath;
+            status = runArtinSearch(options);
+        }
+        else if (pseudoprimeLimit != 0)
+        {
+            if (base < 0 || mpz_sizeinbase(base.get_mpz_t(), 2) > 64)
+            {
+                std::cout << "\033[31mThe pseudoprime search needs a 64-bit --base.\033[0m\n";
+                stopMetricsExporter();
+                stopTracing();
+                return 1;
+            }
+            PseudoprimeOptions options;
+            options.base = mpzToUint64(base);
+            options.limit = pseudoprimeLimit;
+            options.strong = strongOnly;
+            options.carmichael = carmichaelOnly;
+            options.outputPath = outputPath;
+            status = runPseudoprimeSearch(options);
+        }
+        else if (!wieferichRange.empty())
+        {
+            WieferichOptions options;
+            if (!parseRange(wieferichRange, options.first, options.last) || base < 0 || mpz_sizeinbase(base.get_mpz_t(), 2) > 64)
+            {
+                std::cout << "\033[31mUsage: --wieferich=FIRST:LAST with a 64-bit --base.\033[0m\n";
+                stopMetricsExporter();
+                stopTracing();
+                return 1;
+            }
+            options.base = mpzToUint64(base);
+            options.nearMissDigits = static_cast<unsigned>(nearMissDigits);
+            options.outputPath = outputPath;
+            options.checkpointPath = checkpointPath;
+            options.resume = resume;
+            options.checkpointInterval = static_cast<unsigned>(checkpointInterval);
+            status = runWieferichSearch(options);
+        }
+        else if (expansionDenominator != 0)
+        {
+            if (base < 2 || base > static_cast<unsigned long>(maxExpansionBase))
+            {
+                std::cout << "\033[31mThe expansion needs a --base from 2 to 36.\033[0m\n";
+                stopMetricsExporter();
+                stopTracing();
+                return 1;
+            }
+            ExpansionOptions options;
+            options.base = mpzToUint64(base);
+            options.denominator = expansionDenominator;
+            options.digitLimit = expansionDigits;
+            options.outputPath = outputPath;
+            status = runExpansion(options);
+        }
+        else if (!groupElement.empty())
+        {
+            GroupSequenceOptions options;
+            options.element = groupElement;
+            options.modulo = mpz_sizeinbase(modulo.get_mpz_t(), 2) <= 64 ? mpzToUint64(modulo) : 0;
+            options.power = groupPowerExponent;
+            status = runGroupSequence(options);
+        }
+        else if (groupMode)
+        {
+            GroupOptions options;
+            options.modulo = modulo;
+            options.factors = groupFactors;
+            status = runGroupAnalysis(options);
+        }
+        else if (!termRange.empty())
+        {
+            uint64_t first = 0, last = 0;
+            mpz_class target;
+            if (!parseRange(termRange, first, last) || first == 0 || first > last ||
+                (!rangeValue.empty() && target.set_str(rangeValue, 10) != 0))
+            {
+                std::cout << "\033[31mUsage: --range=FIRST:LAST with 1 <= FIRST <= LAST < 2^64, and optionally --range-value=V.\033[0m\n";
+                stopMetricsExporter();
+                stopTracing();
+                return 1;
+            }
+            {
+                ScopedStatTimer timer(STAT_TIME_GENERATE);
+                generateSequenceTerms(base, modulo, sequencePattern);
+                statAdd(STAT_TERMS, sequencePattern.size());
+            }
+            rangeIndex.build(sequencePattern, base, modulo);
+            printRangeAggregate(std::cout, first, last, rangeIndex.aggregate(first, last));
+            if (!rangeValue.empty())
+                std::cout << "Occurrences of " << target << ": " << rangeIndex.countValue(target, first, last) << "\n";
+        }
+        else if (!workerAddress.empty())
+            status = runWorker(workerAddress);
+        else if (!baseSweepRange.empty() || !simdBenchRange.empty())
+        {
+            SweepOptions options;
+            options.axis = SWEEP_BASES;
+            if (!parseRange(baseSweepRange.empty() ? simdBenchRange : baseSweepRange, options.first, options.last) ||
+                mpz_sizeinbase(modulo.get_mpz_t(), 2) > 64)
+            {
+                std::cout << "\033[31mUsage: --base-sweep=FIRST:LAST (or --bench-simd=FIRST:LAST) with a 64-bit --modulo.\033[0m\n";
+                stopMetricsExporter();
+                stopTracing();
+                return 1;
+            }
+            options.modulo = mpzToUint64(modulo);
+            options.outputPath = outputPath;
+            options.checkpointPath = checkpointPath;
+            options.resume = resume;
+            options.checkpointInterval = static_cast<unsigned>(checkpointInterval);
+            status = baseSweepRange.empty() ? runSimdBenchmark(options) : runSweep(options);
+        }
+        else if (generateMode)
+        {
+            GenerateOptions options;
+            options.base = base;
+            options.modulo = modulo;
+            options.outputPath = outputPath;
+            options.checkpointPath = checkpointPath;
+            options.resume = resume;
+            options.checkpointInterval = static_cast<unsigned>(checkpointInterval);
+            status = runGenerate(options);
+        }
+        else if (!sweepRange.empty() || !benchRange.empty() || !orderBenchRange.empty())
+        {
+            SweepOptions options;
+            const std::string &range = !sweepRange.empty() ? sweepRange : !benchRange.empty() ? benchRange : orderBenchRange;
+            if (!parseRange(range, options.first, options.last) || base < 0 || mpz_sizeinbase(base.get_mpz_t(), 2) > 64)
+            {
+                std::cout << "\033[31mUsage: --sweep=FIRST:LAST (or --bench-pool/--bench-orders=FIRST:LAST) with a 64-bit --base.\033[0m\n";
+                stopMetricsExporter();
+                stopTracing();
+                return 1;
+            }
+            options.base = mpzToUint64(base);
+            options.outputPath = outputPath;
+            options.checkpointPath = checkpointPath;
+            options.resume = resume;
+            options.checkpointInterval = static_cast<unsigned>(checkpointInterval);
+            if (!coordinatorAddress.empty() && (!checkpointPath.empty() || resume))
+            {
+                std::cout << "\033[31m--checkpoint and --resume are not supported with --coordinator.\033[0m\n";
+                status = 1;
+            }
+            else if (!coordinatorAddress.empty())
+            {
+                CoordinatorOptions cluster;
+                cluster.address = coordinatorAddress;
+                cluster.base = options.base;
+                cluster.first = options.first;
+                cluster.last = options.last;
+                cluster.outputPath = outputPath;
+                cluster.rangeSize = leaseSize;
+                cluster.leaseTimeout = static_cast<unsigned>(leaseTimeout);
+                status = runCoordinator(cluster);
+            }
+            else if (!sweepRange.empty())
+                status = runSweep(options);
+            else if (!orderBenchRange.empty())
+                status = runOrderBenchmark(options);
+            else
+                status = runPoolBenchmark(options, resolveThreadCount(static_cast<unsigned>(threads)));
+        }
+        else
+        {
+            BatchOptions options;
+            options.inputPath = batchPath;
+            options.outputPath = outputPath;
+            options.summaries = summaryMode;
+            status = runBatch(options);
+        }
+        stopMetricsExporter();
+        stopTracing();
+        reportStatsOnExit();
+        return status;
+    }
+
     std::cout << "\n\nInitializing sequence with default base (" << base << ") and modulo (" << modulo << ")...\n";
     generateSequencePattern(); // Generate initial sequence at load
 
     handleUserInput();
+
+    stopMetricsExporter();
+    stopTracing();
+    reportStatsOnExit();
     std::cout << "\n\n\033[31mProgram terminated.\033[0m\n\n\n";
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,360 @@
+#include "metrics.h"
+#include "net.h"
+#include "platform.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+std::atomic<bool> metricsEnabled{false};
+
+namespace
+{
+    enum MetricType
+    {
+        METRIC_COUNTER,
+        METRIC_GAUGE,
+        METRIC_HISTOGRAM
+    };
+
+    const char *typeNames[] = {"counter", "gauge", "histogram"};
+
+    struct MetricSeries
+    {
+        std::string labels;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        std::unique_ptr<MetricHistogram> histogram;
+        std::function<double()> callback;
+    };
+
+    struct MetricFamily
+    {
+        std::string name;
+        std::string help;
+        MetricType type;
+        std::vector<std::unique_ptr<MetricSeries>> series;
+    };
+
+    // Gauge refreshed on every exporter tick with the per-second rate of a counter
+    struct MetricRate
+    {
+        MetricCounter *source;
+        MetricGauge *gauge;
+        uint64_t lastValue;
+    };
+
+    std::mutex registryMutex;
+
+    std::vector<std::unique_ptr<MetricFamily>> &families()
+    {
+        static std::vector<std::unique_ptr<MetricFamily>> registered;
+        return registered;
+    }
+
+    std::vector<MetricRate> rates;
+
+    // Find or create the series for name/labels; caller holds registryMutex
+    MetricSeries &findSeries(const std::string &name, const std::string &help, MetricType type, const std::string &labels)
+    {
+        MetricFamily *family = nullptr;
+        for (auto &candidate : families())
+        {
+            if (candidate->name == name)
+            {
+                family = candidate.get();
+                break;
+            }
+        }
+        if (!family)
+        {
+            families().push_back(std::unique_ptr<MetricFamily>(new MetricFamily{name, help, type, {}}));
+            family = families().back().get();
+        }
+        for (auto &series : family->series)
+        {
+            if (series->labels == labels)
+                return *series;
+        }
+        family->series.push_back(std::unique_ptr<MetricSeries>(new MetricSeries()));
+        family->series.back()->labels = labels;
+        return *family->series.back();
+    }
+
+    void registerRate(const std::string &name, const std::string &help, MetricCounter &source)
+    {
+        MetricGauge &gauge = metricGauge(name, help);
+        std::lock_guard<std::mutex> lock(registryMutex);
+        rates.push_back({&source, &gauge, source.get()});
+    }
+
+    // Recompute every rate gauge over the elapsed interval
+    void updateRates(double elapsedSeconds)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (MetricRate &rate : rates)
+        {
+            uint64_t value = rate.source->get();
+            rate.gauge->set(elapsedSeconds > 0 ? (value - rate.lastValue) / elapsedSeconds : 0.0);
+            rate.lastValue = value;
+        }
+    }
+
+    std::string withLabels(const std::string &labels, const std::string &extra = "")
+    {
+        if (labels.empty() && extra.empty())
+            return "";
+        if (labels.empty() || extra.empty())
+            return "{" + labels + extra + "}";
+        return "{" + labels + "," + extra + "}";
+    }
+
+    std::string formatNumber(double value)
+    {
+        std::ostringstream text;
+        text.precision(12);
+        text << value;
+        return text.str();
+    }
+
+    std::mutex exporterMutex;
+    std::condition_variable exporterWake;
+    std::thread exporterThread;
+    bool exporterStop = false;
+    std::string exportPath;
+    SocketHandle exportListener = invalidSocket;
+
+    void writeExportFile()
+    {
+        std::string temporary = exportPath + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::out | std::ios::trunc | std::ios::binary);
+            file << renderOpenMetrics();
+            if (!file)
+                return;
+        }
+        replaceFile(temporary, exportPath);
+    }
+
+    // Answer one scrape with the current exposition as an HTTP/1.0 response
+    void serveScrape(SocketHandle client)
+    {
+        char request[1024];
+        netRecvSome(client, request, sizeof(request), 200);
+        std::string body = renderOpenMetrics();
+        std::string response = "HTTP/1.0 200 OK\r\n"
+                               "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                               "Content-Length: " +
+                               std::to_string(body.size()) + "\r\n\r\n" + body;
+        netSendAll(client, response.data(), response.size());
+        netClose(client);
+    }
+
+    void exporterLoop(int intervalMs)
+    {
+        auto lastTick = std::chrono::steady_clock::now();
+        auto nextTick = lastTick + std::chrono::milliseconds(intervalMs);
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(exporterMutex);
+                if (exporterStop)
+                    break;
+                if (exportListener == invalidSocket)
+                    exporterWake.wait_until(lock, nextTick, []() { return exporterStop; });
+            }
+
+            if (exportListener != invalidSocket)
+            {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(nextTick - std::chrono::steady_clock::now()).count();
+                // Short accept waits keep shutdown responsive
+                SocketHandle client = netAccept(exportListener, static_cast<int>(remaining < 0 ? 0 : (remaining > 100 ? 100 : remaining)));
+                if (client != invalidSocket)
+                    serveScrape(client);
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (now >= nextTick)
+            {
+                updateRates(std::chrono::duration<double>(now - lastTick).count());
+                lastTick = now;
+                nextTick = now + std::chrono::milliseconds(intervalMs);
+                if (!exportPath.empty())
+                    writeExportFile();
+            }
+        }
+    }
+}
+
+// Add to a gauge with a compare-and-swap loop
+void MetricGauge::add(double amount)
+{
+    double current = value.load(std::memory_order_relaxed);
+    while (!value.compare_exchange_weak(current, current + amount, std::memory_order_relaxed))
+    {
+    }
+}
+
+MetricHistogram::MetricHistogram(const std::vector<double> &bounds)
+    : bounds(bounds), buckets(bounds.size() + 1)
+{
+}
+
+// Count one sample in the first bucket whose upper bound contains it
+void MetricHistogram::observe(double sample)
+{
+    size_t bucket = 0;
+    while (bucket < bounds.size() && sample > bounds[bucket])
+        ++bucket;
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    double current = sum.load(std::memory_order_relaxed);
+    while (!sum.compare_exchange_weak(current, current + sample, std::memory_order_relaxed))
+    {
+    }
+}
+
+MetricCounter &metricCounter(const std::string &name, const std::string &help, const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    MetricSeries &series = findSeries(name, help, METRIC_COUNTER, labels);
+    if (!series.counter)
+        series.counter.reset(new MetricCounter());
+    return *series.counter;
+}
+
+MetricGauge &metricGauge(const std::string &name, const std::string &help, const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    MetricSeries &series = findSeries(name, help, METRIC_GAUGE, labels);
+    if (!series.gauge)
+        series.gauge.reset(new MetricGauge());
+    return *series.gauge;
+}
+
+MetricHistogram &metricHistogram(const std::string &name, const std::string &help, const std::vector<double> &bounds,
+                                 const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    MetricSeries &series = findSeries(name, help, METRIC_HISTOGRAM, labels);
+    if (!series.histogram)
+        series.histogram.reset(new MetricHistogram(bounds));
+    return *series.histogram;
+}
+
+// Gauge whose value is computed when the exposition is rendered
+void metricGaugeCallback(const std::string &name, const std::string &help, std::function<double()> callback,
+                         const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    findSeries(name, help, METRIC_GAUGE, labels).callback = callback;
+}
+
+MetricCache metricCache(const std::string &cache)
+{
+    std::string labels = "cache=\"" + cache + "\"";
+    MetricCounter &hits = metricCounter("sh_cache_hits", "Cache lookups answered from the cache.", labels);
+    MetricCounter &misses = metricCounter("sh_cache_misses", "Cache lookups that had to compute.", labels);
+    metricGaugeCallback("sh_cache_hit_ratio", "Fraction of cache lookups that hit.", [&hits, &misses]()
+    {
+        uint64_t total = hits.get() + misses.get();
+        return total ? static_cast<double>(hits.get()) / total : 0.0;
+    }, labels);
+    return {hits, misses};
+}
+
+// Render every registered metric in the OpenMetrics text exposition format
+std::string renderOpenMetrics()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::string out;
+    for (const auto &family : families())
+    {
+        out += "# TYPE " + family->name + " " + typeNames[family->type] + "\n";
+        out += "# HELP " + family->name + " " + family->help + "\n";
+        for (const auto &series : family->series)
+        {
+            if (family->type == METRIC_COUNTER && series->counter)
+            {
+                out += family->name + "_total" + withLabels(series->labels) + " " + std::to_string(series->counter->get()) + "\n";
+            }
+            else if (family->type == METRIC_GAUGE)
+            {
+                double value = series->callback ? series->callback() : (series->gauge ? series->gauge->get() : 0.0);
+                out += family->name + withLabels(series->labels) + " " + formatNumber(value) + "\n";
+            }
+            else if (family->type == METRIC_HISTOGRAM && series->histogram)
+            {
+                const MetricHistogram &histogram = *series->histogram;
+                uint64_t cumulative = 0;
+                for (size_t b = 0; b <= histogram.bounds.size(); ++b)
+                {
+                    cumulative += histogram.buckets[b].load(std::memory_order_relaxed);
+                    std::string bound = b < histogram.bounds.size() ? formatNumber(histogram.bounds[b]) : "+Inf";
+                    out += family->name + "_bucket" + withLabels(series->labels, "le=\"" + bound + "\"") + " " +
+                           std::to_string(cumulative) + "\n";
+                }
+                out += family->name + "_sum" + withLabels(series->labels) + " " + formatNumber(histogram.sum.load()) + "\n";
+                out += family->name + "_count" + withLabels(series->labels) + " " + std::to_string(histogram.count.load()) + "\n";
+            }
+        }
+    }
+    out += "# EOF\n";
+    return out;
+}
+
+// Start the background exporter; path and port are each optional (port 0 = no socket)
+bool startMetricsExporter(const std::string &path, uint16_t port, int intervalMs)
+{
+    if (exporterThread.joinable() || intervalMs <= 0)
+        return false;
+
+    if (port != 0)
+    {
+        exportListener = netListenTcp("127.0.0.1", port);
+        if (exportListener == invalidSocket)
+            return false;
+    }
+    exportPath = path;
+
+    // Process-level metrics every export carries
+    metricGaugeCallback("sh_resident_memory_bytes", "Resident set size of the process.", []()
+    {
+        return static_cast<double>(currentResidentBytes());
+    });
+    registerRate("sh_terms_per_second", "Sequence terms produced per second over the last interval.",
+                 metricCounter("sh_terms", "Sequence terms produced."));
+    registerRate("sh_orders_per_second", "Sequence shapes (orders) computed per second over the last interval.",
+                 metricCounter("sh_orders", "Sequence shapes (orders) computed."));
+
+    exporterStop = false;
+    metricsEnabled = true;
+    exporterThread = std::thread(exporterLoop, intervalMs);
+    return true;
+}
+
+// Stop the exporter, writing one final snapshot to the file
+void stopMetricsExporter()
+{
+    if (!exporterThread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(exporterMutex);
+        exporterStop = true;
+    }
+    exporterWake.notify_all();
+    exporterThread.join();
+    metricsEnabled = false;
+
+    if (!exportPath.empty())
+        writeExportFile();
+    if (exportListener != invalidSocket)
+    {
+        netClose(exportListener);
+        exportListener = invalidSocket;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Process-wide metrics registry exported in the OpenMetrics text format.
+// Metrics are registered once (usually as file-level references) and updated with
+// relaxed atomics, so callers should batch updates per chunk rather than per term.
+// Registration returns the existing series when the name and labels already exist.
+
+class MetricCounter
+{
+public:
+    void add(uint64_t amount = 1) { value.fetch_add(amount, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{0};
+};
+
+class MetricGauge
+{
+public:
+    void set(double newValue) { value.store(newValue, std::memory_order_relaxed); }
+    void add(double amount);
+    double get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value{0.0};
+};
+
+// Histogram with fixed upper bounds chosen at registration
+class MetricHistogram
+{
+public:
+    explicit MetricHistogram(const std::vector<double> &bounds);
+    void observe(double sample);
+
+    std::vector<double> bounds;
+    std::vector<std::atomic<uint64_t>> buckets; // Non-cumulative; last one is +Inf
+    std::atomic<double> sum{0.0};
+    std::atomic<uint64_t> count{0};
+};
+
+// Set while an exporter is running; instrumented code may skip work when it is off
+extern std::atomic<bool> metricsEnabled;
+
+// labels uses the exposition syntax without braces, e.g. "queue=\"sweep\""
+MetricCounter &metricCounter(const std::string &name, const std::string &help, const std::string &labels = "");
+MetricGauge &metricGauge(const std::string &name, const std::string &help, const std::string &labels = "");
+MetricHistogram &metricHistogram(const std::string &name, const std::string &help, const std::vector<double> &bounds,
+                                 const std::string &labels = "");
+void metricGaugeCallback(const std::string &name, const std::string &help, std::function<double()> callback,
+                         const std::string &labels = "");
+
+// Hit/miss counters for a named cache; the exporter derives a hit-rate gauge from them
+struct MetricCache
+{
+    MetricCounter &hits;
+    MetricCounter &misses;
+};
+MetricCache metricCache(const std::string &cache);
+
+std::string renderOpenMetrics();
+
+// Periodically export to a file (replaced atomically) and/or serve it on 127.0.0.1:port
+bool startMetricsExporter(const std::string &path, uint16_t port, int intervalMs);
+void stopMetricsExporter();
+
+#endif
@@ -0,0 +1,191 @@
+#include "modarith.h"
+
+namespace
+{
+    ReductionCost measuredCosts[REDUCE_KERNEL_COUNT][reductionWidthClasses];
+    bool measured[REDUCE_KERNEL_COUNT][reductionWidthClasses] = {};
+
+    // Limbs of 64 bits needed for a modulus of the given width
+    double limbCount(size_t modulusBits)
+    {
+        return static_cast<double>((modulusBits + 63) / 64);
+    }
+
+    // Rough estimates for a current x86-64 core. Up to 64 bits everything stays in registers and
+    // the 32-bit variants are used below 2^32. Wider moduli scale with the square of the limb
+    // count (schoolbook products); there Barrett trades GMP's division for a second product,
+    // which GMP's own precomputed-inverse division usually beats.
+    ReductionCost defaultReductionCost(ReductionKernel kernel, size_t modulusBits)
+    {
+        bool narrow = modulusBits <= 32;
+        if (modulusBits <= 64)
+        {
+            switch (kernel)
+            {
+            case REDUCE_BARRETT:
+                return narrow ? ReductionCost{5, 2.0} : ReductionCost{40, 4.5};
+            case REDUCE_MONTGOMERY:
+                return narrow ? ReductionCost{15, 1.8} : ReductionCost{50, 3.0};
+            default:
+                return ReductionCost{0, 30};
+            }
+        }
+
+        double limbs = limbCount(modulusBits);
+        switch (kernel)
+        {
+        case REDUCE_BARRETT:
+            return ReductionCost{300 + 20 * limbs * limbs, 250 + 6.5 * limbs * limbs};
+        case REDUCE_GMP:
+            return ReductionCost{0, 150 + 5 * limbs * limbs};
+        default:
+            return ReductionCost{0, 0};
+        }
+    }
+}
+
+const char *reductionKernelName(ReductionKernel kernel)
+{
+    switch (kernel)
+    {
+    case REDUCE_BARRETT:
+        return "barrett";
+    case REDUCE_MONTGOMERY:
+        return "montgomery";
+    default:
+        return "gmp";
+    }
+}
+
+Barrett64::Barrett64(uint64_t modulus) : modulus(modulus), one(1)
+{
+    reciprocal = ~static_cast<unsigned __int128>(0) / modulus;
+}
+
+// Newton iteration for the inverse of an odd number modulo 2^32
+Montgomery32::Montgomery32(uint32_t modulus) : modulus(modulus)
+{
+    uint32_t x = modulus; // Correct to 3 bits for any odd modulus
+    for (int i = 0; i < 4; ++i)
+        x *= 2 - modulus * x;
+    inverse = x;
+    one = static_cast<uint32_t>((1ull << 32) % modulus);
+}
+
+// Same iteration to 64 bits; 2^64 mod modulus is (2^64 - modulus) mod modulus
+Montgomery64::Montgomery64(uint64_t modulus) : modulus(modulus)
+{
+    uint64_t x = modulus;
+    for (int i = 0; i < 5; ++i)
+        x *= 2 - modulus * x;
+    inverse = x;
+    one = (0 - modulus) % modulus;
+    rSquared = static_cast<uint64_t>(static_cast<unsigned __int128>(one) * one % modulus);
+}
+
+// Same iteration to 128 bits. R^2 mod modulus would need a 256-bit division, so it is built
+// from R mod modulus instead: eight doublings give 2^8 R, and four Montgomery squarings
+// take that to 2^128 R = R^2 (mod modulus).
+Montgomery128::Montgomery128(Value modulus) : modulus(modulus)
+{
+    Value x = modulus;
+    for (int i = 0; i < 6; ++i)
+        x *= 2 - modulus * x;
+    inverse = x;
+    one = (0 - modulus) % modulus;
+    Value power = one;
+    for (int i = 0; i < 8; ++i)
+    {
+        power <<= 1;
+        if (power >= modulus)
+            power -= modulus;
+    }
+    for (int i = 0; i < 4; ++i)
+        power = multiply(power, power);
+    rSquared = power;
+}
+
+BarrettMpz::BarrettMpz(const mpz_class &modulus) : modulus(modulus)
+{
+    bits = mpz_sizeinbase(modulus.get_mpz_t(), 2);
+    mpz_class power;
+    mpz_setbit(power.get_mpz_t(), 2 * bits);
+    mpz_fdiv_q(reciprocal.get_mpz_t(), power.get_mpz_t(), modulus.get_mpz_t());
+}
+
+// q = ((ab >> (k - 1)) * reciprocal) >> (k + 1) undershoots ab / modulus by at most two
+void BarrettMpz::multiply(mpz_class &result, const mpz_class &a, const mpz_class &b)
+{
+    mpz_mul(product.get_mpz_t(), a.get_mpz_t(), b.get_mpz_t());
+    mpz_tdiv_q_2exp(quotient.get_mpz_t(), product.get_mpz_t(), bits - 1);
+    mpz_mul(quotient.get_mpz_t(), quotient.get_mpz_t(), reciprocal.get_mpz_t());
+    mpz_tdiv_q_2exp(quotient.get_mpz_t(), quotient.get_mpz_t(), bits + 1);
+    mpz_submul(product.get_mpz_t(), quotient.get_mpz_t(), modulus.get_mpz_t());
+    while (mpz_cmp(product.get_mpz_t(), modulus.get_mpz_t()) >= 0)
+        mpz_sub(product.get_mpz_t(), product.get_mpz_t(), modulus.get_mpz_t());
+    mpz_swap(result.get_mpz_t(), product.get_mpz_t());
+}
+
+bool reductionAvailable(ReductionKernel kernel, size_t modulusBits, bool oddModulus)
+{
+    if (kernel == REDUCE_MONTGOMERY)
+        return oddModulus && modulusBits <= 64;
+    return kernel < REDUCE_KERNEL_COUNT;
+}
+
+size_t reductionWidthClass(size_t modulusBits)
+{
+    size_t widthClass = 0;
+    while (widthClass + 1 < reductionWidthClasses && reductionClassBits(widthClass) < modulusBits)
+        ++widthClass;
+    return widthClass;
+}
+
+size_t reductionClassBits(size_t widthClass)
+{
+    return static_cast<size_t>(32) << widthClass;
+}
+
+void setMeasuredReductionCost(ReductionKernel kernel, size_t widthClass, ReductionCost cost)
+{
+    measuredCosts[kernel][widthClass] = cost;
+    measured[kernel][widthClass] = true;
+}
+
+// A measurement for the width class when there is one, otherwise the built-in estimate
+ReductionCost estimateReductionCost(ReductionKernel kernel, size_t modulusBits)
+{
+    size_t widthClass = reductionWidthClass(modulusBits);
+    if (!measured[kernel][widthClass])
+        return defaultReductionCost(kernel, modulusBits);
+
+    ReductionCost cost = measuredCosts[kernel][widthClass];
+    size_t classBits = reductionClassBits(widthClass);
+    if (modulusBits > classBits)
+    {
+        double scale = limbCount(modulusBits) / limbCount(classBits);
+        cost.setup *= scale * scale;
+        cost.perStep *= scale * scale;
+    }
+    return cost;
+}
+
+ReductionKernel chooseReduction(size_t modulusBits, bool oddModulus, uint64_t sequenceLength)
+{
+    ReductionKernel best = REDUCE_GMP;
+    double bestCost = 0;
+    for (int k = 0; k < REDUCE_KERNEL_COUNT; ++k)
+    {
+        ReductionKernel kernel = static_cast<ReductionKernel>(k);
+        if (!reductionAvailable(kernel, modulusBits, oddModulus))
+            continue;
+        ReductionCost cost = estimateReductionCost(kernel, modulusBits);
+        double total = cost.setup + cost.perStep * static_cast<double>(sequenceLength);
+        if (k == 0 || total < bestCost)
+        {
+            best = kernel;
+            bestCost = total;
+        }
+    }
+    return best;
+}
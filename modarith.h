@@ -0,0 +1,239 @@
+#ifndef MODARITH_H
+#define MODARITH_H
+
+#include <cstdint>
+#include <gmpxx.h>
+
+// Modular multiplication kernels for a modulus that is reused many times. Each one
+// precomputes its constants once and then avoids hardware division on every product.
+// All of them share one interface so the stepping loops can be written once:
+//   convertIn(x)    residue x < modulus -> the kernel's internal form
+//   convertOut(x)   internal form -> residue
+//   multiply(a, b)  product of two internal values
+//   one             internal form of 1
+// Barrett keeps plain residues (convertIn/convertOut are free), which suits short sequences
+// and random-access queries; Montgomery needs an odd modulus and a conversion on the way in
+// and out, but has the cheapest product.
+
+enum ReductionKernel
+{
+    REDUCE_BARRETT,
+    REDUCE_MONTGOMERY,
+    REDUCE_GMP,
+    REDUCE_KERNEL_COUNT
+};
+
+const char *reductionKernelName(ReductionKernel kernel);
+
+// Barrett reduction for a modulus in [2, 2^32) with reciprocal floor((2^64 - 1) / modulus)
+struct Barrett32
+{
+    uint32_t modulus;
+    uint64_t reciprocal;
+    uint32_t one;
+
+    explicit Barrett32(uint32_t modulus) : modulus(modulus), reciprocal(UINT64_MAX / modulus), one(1) {}
+    uint32_t convertIn(uint32_t value) const { return value; }
+    uint64_t convertOut(uint32_t value) const { return value; }
+
+    // value mod modulus for any 64-bit value; the quotient estimate is at most one short
+    uint32_t reduce(uint64_t value) const
+    {
+        uint64_t quotient = static_cast<uint64_t>((static_cast<unsigned __int128>(value) * reciprocal) >> 64);
+        uint64_t remainder = value - quotient * modulus;
+        return static_cast<uint32_t>(remainder >= modulus ? remainder - modulus : remainder);
+    }
+
+    uint32_t multiply(uint32_t a, uint32_t b) const { return reduce(static_cast<uint64_t>(a) * b); }
+};
+
+// Barrett reduction for a modulus in [2, 2^64) with reciprocal floor((2^128 - 1) / modulus)
+struct Barrett64
+{
+    uint64_t modulus;
+    unsigned __int128 reciprocal;
+    uint64_t one;
+
+    explicit Barrett64(uint64_t modulus);
+    uint64_t convertIn(uint64_t value) const { return value; }
+    uint64_t convertOut(uint64_t value) const { return value; }
+
+    // value mod modulus for value < 2^128, using the high half of value * reciprocal
+    uint64_t reduce(unsigned __int128 value) const
+    {
+        uint64_t v0 = static_cast<uint64_t>(value), v1 = static_cast<uint64_t>(value >> 64);
+        uint64_t r0 = static_cast<uint64_t>(reciprocal), r1 = static_cast<uint64_t>(reciprocal >> 64);
+        unsigned __int128 p00 = static_cast<unsigned __int128>(v0) * r0;
+        unsigned __int128 p01 = static_cast<unsigned __int128>(v0) * r1;
+        unsigned __int128 p10 = static_cast<unsigned __int128>(v1) * r0;
+        unsigned __int128 p11 = static_cast<unsigned __int128>(v1) * r1;
+        unsigned __int128 middle = (p00 >> 64) + static_cast<uint64_t>(p01) + static_cast<uint64_t>(p10);
+        unsigned __int128 quotient = p11 + (p01 >> 64) + (p10 >> 64) + (middle >> 64);
+        unsigned __int128 remainder = value - quotient * modulus; // Below 2 * modulus, which can exceed 2^64
+        return static_cast<uint64_t>(remainder >= modulus ? remainder - modulus : remainder);
+    }
+
+    uint64_t multiply(uint64_t a, uint64_t b) const { return reduce(static_cast<unsigned __int128>(a) * b); }
+};
+
+// Montgomery arithmetic for an odd modulus in [3, 2^32) (R = 2^32)
+struct Montgomery32
+{
+    uint32_t modulus;
+    uint32_t inverse; // modulus^-1 mod 2^32
+    uint32_t one;     // R mod modulus
+
+    explicit Montgomery32(uint32_t modulus);
+    uint32_t convertIn(uint32_t value) const { return static_cast<uint32_t>((static_cast<uint64_t>(value) << 32) % modulus); }
+    uint64_t convertOut(uint32_t value) const { return reduce(value); }
+
+    // (value / R) mod modulus for value < modulus * R
+    uint32_t reduce(uint64_t value) const
+    {
+        uint32_t m = static_cast<uint32_t>(value) * inverse;
+        uint32_t high = static_cast<uint32_t>(value >> 32);
+        uint32_t correction = static_cast<uint32_t>((static_cast<uint64_t>(m) * modulus) >> 32);
+        uint32_t result = high - correction;
+        return high < correction ? result + modulus : result;
+    }
+
+    uint32_t multiply(uint32_t a, uint32_t b) const { return reduce(static_cast<uint64_t>(a) * b); }
+};
+
+// Montgomery arithmetic for an odd modulus in [3, 2^64) (R = 2^64)
+struct Montgomery64
+{
+    uint64_t modulus;
+    uint64_t inverse;  // modulus^-1 mod 2^64
+    uint64_t one;      // R mod modulus
+    uint64_t rSquared; // R^2 mod modulus, for convertIn
+
+    explicit Montgomery64(uint64_t modulus);
+    uint64_t convertIn(uint64_t value) const { return multiply(value, rSquared); }
+    uint64_t convertOut(uint64_t value) const { return reduce(value); }
+
+    uint64_t reduce(unsigned __int128 value) const
+    {
+        uint64_t m = static_cast<uint64_t>(value) * inverse;
+        uint64_t high = static_cast<uint64_t>(value >> 64);
+        uint64_t correction = static_cast<uint64_t>((static_cast<unsigned __int128>(m) * modulus) >> 64);
+        uint64_t result = high - correction;
+        return high < correction ? result + modulus : result;
+    }
+
+    uint64_t multiply(uint64_t a, uint64_t b) const { return reduce(static_cast<unsigned __int128>(a) * b); }
+};
+
+// Montgomery arithmetic for an odd modulus in [3, 2^127) (R = 2^128), such as the square of a
+// prime above 2^32. Residues are unsigned __int128 and each product is assembled from four
+// 64-bit multiplications.
+struct Montgomery128
+{
+    typedef unsigned __int128 Value;
+
+    Value modulus;
+    Value inverse;  // modulus^-1 mod 2^128
+    Value one;      // R mod modulus
+    Value rSquared; // R^2 mod modulus, for convertIn
+
+    explicit Montgomery128(Value modulus);
+    Value convertIn(Value value) const { return multiply(value, rSquared); }
+    Value convertOut(Value value) const { return reduce(value, 0); }
+
+    // The high half of the 256-bit product a * b; the low half is a * b in native arithmetic
+    static Value multiplyHigh(Value a, Value b)
+    {
+        uint64_t a0 = static_cast<uint64_t>(a), a1 = static_cast<uint64_t>(a >> 64);
+        uint64_t b0 = static_cast<uint64_t>(b), b1 = static_cast<uint64_t>(b >> 64);
+        Value p00 = static_cast<Value>(a0) * b0;
+        Value p01 = static_cast<Value>(a0) * b1;
+        Value p10 = static_cast<Value>(a1) * b0;
+        Value p11 = static_cast<Value>(a1) * b1;
+        Value middle = (p00 >> 64) + static_cast<uint64_t>(p01) + static_cast<uint64_t>(p10);
+        return p11 + (p01 >> 64) + (p10 >> 64) + (middle >> 64);
+    }
+
+    // ((high R + low) / R) mod modulus for high R + low < modulus * R
+    Value reduce(Value low, Value high) const
+    {
+        Value m = low * inverse;
+        Value correction = multiplyHigh(m, modulus);
+        Value result = high - correction;
+        return high < correction ? result + modulus : result;
+    }
+
+    Value multiply(Value a, Value b) const { return reduce(a * b, multiplyHigh(a, b)); }
+};
+
+// Multi-limb Barrett reduction for moduli wider than 64 bits. Products are reduced with two
+// multiplications by the precomputed reciprocal instead of a GMP division. Each instance
+// owns scratch values, so it must not be shared between threads.
+class BarrettMpz
+{
+public:
+    explicit BarrettMpz(const mpz_class &modulus);
+    void multiply(mpz_class &result, const mpz_class &a, const mpz_class &b);
+
+private:
+    mpz_class modulus;
+    mpz_class reciprocal; // floor(2^(2k) / modulus) for a k-bit modulus
+    size_t bits;
+    mpz_class product, quotient;
+};
+
+// Plain GMP product and division, with the same interface as BarrettMpz
+class GmpReducer
+{
+public:
+    explicit GmpReducer(const mpz_class &modulus) : modulus(modulus) {}
+    void multiply(mpz_class &result, const mpz_class &a, const mpz_class &b)
+    {
+        mpz_mul(result.get_mpz_t(), a.get_mpz_t(), b.get_mpz_t());
+        mpz_tdiv_r(result.get_mpz_t(), result.get_mpz_t(), modulus.get_mpz_t());
+    }
+
+private:
+    mpz_class modulus;
+};
+
+// Cost model: estimated nanoseconds to set a kernel up for a modulus of the given width and
+// to take one step with it. Montgomery is only available for odd moduli up to 64 bits.
+struct ReductionCost
+{
+    double setup;
+    double perStep;
+};
+
+bool reductionAvailable(ReductionKernel kernel, size_t modulusBits, bool oddModulus);
+ReductionCost estimateReductionCost(ReductionKernel kernel, size_t modulusBits);
+
+// Width classes of measured costs: 32, 64, 128, ... 4096 bits. A measurement replaces the
+// built-in estimate for its class (set once at startup, before any worker threads run);
+// wider moduli scale the last class by the square of the limb count.
+const size_t reductionWidthClasses = 8;
+size_t reductionWidthClass(size_t modulusBits);
+size_t reductionClassBits(size_t widthClass);
+void setMeasuredReductionCost(ReductionKernel kernel, size_t widthClass, ReductionCost cost);
+
+// Cheapest available kernel for sequenceLength multiplications by one modulus
+ReductionKernel chooseReduction(size_t modulusBits, bool oddModulus, uint64_t sequenceLength);
+
+// Call body with the chosen 64-bit kernel, picking the 32-bit variant when the modulus
+// fits. REDUCE_GMP falls back to Barrett: 64-bit moduli never need GMP.
+template <class Body>
+void withReduction64(uint64_t modulus, ReductionKernel kernel, Body body)
+{
+    if (kernel == REDUCE_MONTGOMERY && (modulus & 1) && modulus >= 3)
+    {
+        if (modulus < (1ull << 32))
+            body(Montgomery32(static_cast<uint32_t>(modulus)));
+        else
+            body(Montgomery64(modulus));
+    }
+    else if (modulus < (1ull << 32))
+        body(Barrett32(static_cast<uint32_t>(modulus)));
+    else
+        body(Barrett64(modulus));
+}
+
+#endif
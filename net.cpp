@@ -0,0 +1,280 @@
+#include "net.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+const SocketHandle invalidSocket = INVALID_SOCKET;
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+const SocketHandle invalidSocket = -1;
+#endif
+
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    // Small request/response messages should not wait for Nagle's algorithm
+    void setNoDelay(SocketHandle socket)
+    {
+        int enabled = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&enabled), sizeof(enabled));
+    }
+
+    // Split "HOST:PORT" at the last colon
+    bool splitHostPort(const std::string &address, std::string &host, uint16_t &port)
+    {
+        size_t colon = address.rfind(':');
+        if (colon == std::string::npos || colon + 1 >= address.size())
+            return false;
+        unsigned long value = 0;
+        for (size_t i = colon + 1; i < address.size(); ++i)
+        {
+            if (address[i] < '0' || address[i] > '9')
+                return false;
+            value = value * 10 + (address[i] - '0');
+            if (value > 65535)
+                return false;
+        }
+        host = address.substr(0, colon);
+        port = static_cast<uint16_t>(value);
+        return true;
+    }
+}
+
+// Start the socket library (required once on Windows, a no-op elsewhere)
+bool netInit()
+{
+#ifdef _WIN32
+    static bool started = false;
+    if (!started)
+    {
+        WSADATA data;
+        started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }
+    return started;
+#else
+    return true;
+#endif
+}
+
+// Listen for TCP connections on host:port (host must be a numeric IPv4 address)
+SocketHandle netListenTcp(const std::string &host, uint16_t port)
+{
+    if (!netInit())
+        return invalidSocket;
+
+    SocketHandle listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == invalidSocket)
+        return invalidSocket;
+
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+        bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(listener, 16) != 0)
+    {
+        netClose(listener);
+        return invalidSocket;
+    }
+    return listener;
+}
+
+// Connect to host:port, resolving host names
+SocketHandle netConnectTcp(const std::string &host, uint16_t port)
+{
+    if (!netInit())
+        return invalidSocket;
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *results = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &results) != 0)
+        return invalidSocket;
+
+    SocketHandle connection = invalidSocket;
+    for (addrinfo *candidate = results; candidate && connection == invalidSocket; candidate = candidate->ai_next)
+    {
+        connection = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (connection == invalidSocket)
+            continue;
+        if (connect(connection, candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) != 0)
+        {
+            netClose(connection);
+            connection = invalidSocket;
+        }
+    }
+    freeaddrinfo(results);
+    if (connection != invalidSocket)
+        setNoDelay(connection);
+    return connection;
+}
+
+// Listen on a Unix domain socket, replacing a stale socket file
+SocketHandle netListenUnix(const std::string &path)
+{
+#ifdef _WIN32
+    (void)path;
+    return invalidSocket;
+#else
+    sockaddr_un address = {};
+    if (path.size() >= sizeof(address.sun_path))
+        return invalidSocket;
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+
+    SocketHandle listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == invalidSocket)
+        return invalidSocket;
+    unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0)
+    {
+        netClose(listener);
+        return invalidSocket;
+    }
+    return listener;
+#endif
+}
+
+SocketHandle netConnectUnix(const std::string &path)
+{
+#ifdef _WIN32
+    (void)path;
+    return invalidSocket;
+#else
+    sockaddr_un address = {};
+    if (path.size() >= sizeof(address.sun_path))
+        return invalidSocket;
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+
+    SocketHandle connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection != invalidSocket && connect(connection, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        netClose(connection);
+        connection = invalidSocket;
+    }
+    return connection;
+#endif
+}
+
+SocketHandle netListenAddress(const std::string &address)
+{
+    if (address.compare(0, 5, "unix:") == 0)
+        return netListenUnix(address.substr(5));
+    std::string host;
+    uint16_t port;
+    if (!splitHostPort(address, host, port))
+        return invalidSocket;
+    return netListenTcp(host.empty() ? "0.0.0.0" : host, port);
+}
+
+SocketHandle netConnectAddress(const std::string &address)
+{
+    if (address.compare(0, 5, "unix:") == 0)
+        return netConnectUnix(address.substr(5));
+    std::string host;
+    uint16_t port;
+    if (!splitHostPort(address, host, port))
+        return invalidSocket;
+    return netConnectTcp(host.empty() ? "127.0.0.1" : host, port);
+}
+
+// Wait up to timeoutMs for a connection on listener
+SocketHandle netAccept(SocketHandle listener, int timeoutMs)
+{
+#ifdef _WIN32
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(listener, &readable);
+    timeval timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+    if (select(0, &readable, nullptr, nullptr, &timeout) <= 0)
+        return invalidSocket;
+#else
+    pollfd waiting = {listener, POLLIN, 0};
+    if (poll(&waiting, 1, timeoutMs) <= 0)
+        return invalidSocket;
+#endif
+    SocketHandle connection = accept(listener, nullptr, nullptr);
+    if (connection != invalidSocket)
+        setNoDelay(connection);
+    return connection;
+}
+
+// Send the whole buffer, retrying on partial writes
+bool netSendAll(SocketHandle socket, const void *data, size_t length)
+{
+    const char *bytes = static_cast<const char *>(data);
+    while (length > 0)
+    {
+#ifdef _WIN32
+        int sent = send(socket, bytes, static_cast<int>(length), 0);
+#else
+        ssize_t sent = send(socket, bytes, length, MSG_NOSIGNAL);
+#endif
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        length -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+// Receive whatever is available within timeoutMs; returns 0 on timeout or close, -1 on error
+long netRecvSome(SocketHandle socket, void *buffer, size_t capacity, int timeoutMs)
+{
+#ifdef _WIN32
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(socket, &readable);
+    timeval timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+    if (select(0, &readable, nullptr, nullptr, &timeout) <= 0)
+        return 0;
+    return recv(socket, static_cast<char *>(buffer), static_cast<int>(capacity), 0);
+#else
+    pollfd waiting = {socket, POLLIN, 0};
+    if (poll(&waiting, 1, timeoutMs) <= 0)
+        return 0;
+    return static_cast<long>(recv(socket, buffer, capacity, 0));
+#endif
+}
+
+// Receive exactly length bytes; the timeout applies to the whole message
+bool netRecvAll(SocketHandle socket, void *buffer, size_t length, int timeoutMs)
+{
+    char *bytes = static_cast<char *>(buffer);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (length > 0)
+    {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0)
+            return false;
+        long received = netRecvSome(socket, bytes, length, static_cast<int>(left));
+        if (received <= 0)
+            return false;
+        bytes += received;
+        length -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+void netClose(SocketHandle socket)
+{
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
@@ -0,0 +1,34 @@
+#ifndef NET_H
+#define NET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Thin blocking socket wrapper over Winsock and BSD sockets
+
+#ifdef _WIN32
+typedef uintptr_t SocketHandle;
+#else
+typedef int SocketHandle;
+#endif
+
+extern const SocketHandle invalidSocket;
+
+bool netInit();
+SocketHandle netListenTcp(const std::string &host, uint16_t port);
+SocketHandle netConnectTcp(const std::string &host, uint16_t port);
+SocketHandle netListenUnix(const std::string &path);  // POSIX only
+SocketHandle netConnectUnix(const std::string &path); // POSIX only
+
+// Addresses are "HOST:PORT" or "unix:PATH"
+SocketHandle netListenAddress(const std::string &address);
+SocketHandle netConnectAddress(const std::string &address);
+
+SocketHandle netAccept(SocketHandle listener, int timeoutMs); // invalidSocket on timeout
+bool netSendAll(SocketHandle socket, const void *data, size_t length);
+long netRecvSome(SocketHandle socket, void *buffer, size_t capacity, int timeoutMs); // 0 on timeout/close
+bool netRecvAll(SocketHandle socket, void *buffer, size_t length, int timeoutMs);  // false on timeout/close
+void netClose(SocketHandle socket);
+
+#endif
@@ -0,0 +1,360 @@
+#include "order.h"
+#include "engine.h"
+#include "sieve.h"
+
+#include <algorithm>
+
+namespace
+{
+    // A factor of composite n (no factors below 2^16) by Pollard's rho with Brent's cycle
+    // detection, batching 128 differences per gcd; retries with the next constant on failure
+    uint64_t rhoFactor(uint64_t n)
+    {
+        for (uint64_t constant = 1;; ++constant)
+        {
+            auto next = [n, constant](uint64_t x) { return (mulMod64(x, x, n) + constant) % n; };
+            uint64_t y = 2, x = 2, saved = 2, product = 1, divisor = 1;
+            for (uint64_t length = 1; divisor == 1; length *= 2)
+            {
+                x = y;
+                for (uint64_t i = 0; i < length; ++i)
+                    y = next(y);
+                for (uint64_t done = 0; done < length && divisor == 1; done += 128)
+                {
+                    saved = y;
+                    for (uint64_t i = 0; i < std::min<uint64_t>(128, length - done); ++i)
+                    {
+                        y = next(y);
+                        product = mulMod64(product, x > y ? x - y : y - x, n);
+                    }
+                    divisor = gcd64(product, n);
+                }
+            }
+            if (divisor == n)
+            {
+                // The batch overshot: redo it one step at a time
+                do
+                {
+                    saved = next(saved);
+                    divisor = gcd64(x > saved ? x - saved : saved - x, n);
+                } while (divisor == 1);
+            }
+            if (divisor != n)
+                return divisor;
+        }
+    }
+
+    void collectFactors(uint64_t n, std::vector<PrimePower> &factors)
+    {
+        if (n == 1)
+            return;
+        if (isPrimeUint64(n))
+        {
+            auto found = std::find_if(factors.begin(), factors.end(), [n](const PrimePower &power) { return power.prime == n; });
+            if (found != factors.end())
+                ++found->exponent;
+            else
+                factors.push_back(PrimePower{n, 1});
+            return;
+        }
+        uint64_t divisor = rhoFactor(n);
+        collectFactors(divisor, factors);
+        collectFactors(n / divisor, factors);
+    }
+
+    // Remaining divisor checks for one base and modulus: the current order, the next prime
+    // of lambda(n) to try removing from it and how many more times it may be removed
+    struct OrderSearch
+    {
+        uint32_t base; // Reduced
+        uint32_t modulus;
+        uint64_t order;
+        const std::vector<PrimePower> *factors;
+        size_t next;
+        unsigned left;
+    };
+
+    void startSearch(OrderSearch &search, uint32_t base, uint32_t modulus, const std::vector<PrimePower> &factors)
+    {
+        search.base = base;
+        search.modulus = modulus;
+        search.order = expandFactors(factors);
+        search.factors = &factors;
+        search.next = 0;
+        search.left = factors.empty() ? 0 : factors[0].exponent;
+    }
+
+    // Record the answer to "is base^(order / q) == 1?" for the search's current prime q
+    void advanceSearch(OrderSearch &search, bool one, uint64_t exponent)
+    {
+        if (one)
+        {
+            search.order = exponent;
+            if (--search.left > 0)
+                return;
+        }
+        ++search.next;
+        search.left = search.next < search.factors->size() ? (*search.factors)[search.next].exponent : 0;
+    }
+
+    // Every round asks one question per unfinished search and answers the whole round with
+    // the lane-per-modulus kernel; Montgomery form needs an odd modulus, so even moduli are
+    // answered right away with scalar arithmetic
+    void finishSearches(std::vector<OrderSearch> &searches, uint64_t *orders, SimdLevel level)
+    {
+        std::vector<size_t> owners;
+        std::vector<uint32_t> bases, queryModuli, exponents;
+        std::vector<uint8_t> results;
+        bool unfinished = true;
+        while (unfinished)
+        {
+            unfinished = false;
+            owners.clear();
+            bases.clear();
+            queryModuli.clear();
+            exponents.clear();
+            for (size_t i = 0; i < searches.size(); ++i)
+            {
+                OrderSearch &search = searches[i];
+                if (search.next == search.factors->size())
+                    continue;
+                unfinished = true;
+                uint32_t exponent = static_cast<uint32_t>(search.order / (*search.factors)[search.next].prime);
+                if (search.modulus & 1)
+                {
+                    owners.push_back(i);
+                    bases.push_back(search.base);
+                    queryModuli.push_back(search.modulus);
+                    exponents.push_back(exponent);
+                }
+                else
+                    advanceSearch(search, powMod64(search.base, exponent, search.modulus) == 1, exponent);
+            }
+
+            results.resize(owners.size());
+            powEqualsOneAcrossModuli(bases.data(), queryModuli.data(), exponents.data(), owners.size(), results.data(), level);
+            for (size_t q = 0; q < owners.size(); ++q)
+                advanceSearch(searches[owners[q]], results[q] != 0, exponents[q]);
+        }
+
+        for (size_t i = 0; i < searches.size(); ++i)
+            orders[i] = searches[i].order;
+    }
+}
+
+const std::vector<uint32_t> &smallPrimes()
+{
+    static const std::vector<uint32_t> primes = primesUpTo((1u << 16) - 1);
+    return primes;
+}
+
+// Factorization of n by trial division over the primes below 2^16 (ascending primes)
+std::vector<PrimePower> factorUint32(uint32_t n)
+{
+    std::vector<PrimePower> factors;
+    for (uint32_t p : smallPrimes())
+    {
+        if (static_cast<uint64_t>(p) * p > n)
+            break;
+        if (n % p != 0)
+            continue;
+        unsigned exponent = 0;
+        while (n % p == 0)
+        {
+            n /= p;
+            ++exponent;
+        }
+        factors.push_back(PrimePower{p, exponent});
+    }
+    if (n > 1)
+        factors.push_back(PrimePower{n, 1});
+    return factors;
+}
+
+// Deterministic for 64 bits with the first twelve prime bases
+bool isPrimeUint64(uint64_t n)
+{
+    if (n < 2)
+        return false;
+    static const uint64_t witnesses[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    for (uint64_t p : witnesses)
+    {
+        if (n % p == 0)
+            return n == p;
+    }
+    uint64_t odd = n - 1;
+    unsigned twos = 0;
+    while (!(odd & 1))
+    {
+        odd >>= 1;
+        ++twos;
+    }
+    for (uint64_t a : witnesses)
+    {
+        uint64_t x = powMod64(a, odd, n);
+        if (x == 1 || x == n - 1)
+            continue;
+        unsigned i = 1;
+        for (; i < twos; ++i)
+        {
+            x = mulMod64(x, x, n);
+            if (x == n - 1)
+                break;
+        }
+        if (i == twos)
+            return false;
+    }
+    return true;
+}
+
+std::vector<PrimePower> factorUint64(uint64_t n)
+{
+    std::vector<PrimePower> factors;
+    for (uint32_t p : smallPrimes())
+    {
+        if (static_cast<uint64_t>(p) * p > n)
+            break;
+        if (n % p != 0)
+            continue;
+        unsigned exponent = 0;
+        while (n % p == 0)
+        {
+            n /= p;
+            ++exponent;
+        }
+        factors.push_back(PrimePower{p, exponent});
+    }
+    size_t small = factors.size();
+    collectFactors(n, factors);
+    std::sort(factors.begin() + small, factors.end(), [](const PrimePower &a, const PrimePower &b) { return a.prime < b.prime; });
+    return factors;
+}
+
+void mergeMaxPower(std::vector<PrimePower> &factors, uint64_t prime, unsigned exponent)
+{
+    size_t i = 0;
+    while (i < factors.size() && factors[i].prime < prime)
+        ++i;
+    if (i < factors.size() && factors[i].prime == prime)
+    {
+        if (factors[i].exponent < exponent)
+            factors[i].exponent = exponent;
+    }
+    else
+        factors.insert(factors.begin() + i, PrimePower{prime, exponent});
+}
+
+// lambda(p^k) is p^(k-1) (p - 1), except lambda(2^k) = 2^(k-2) for k >= 3; lambda(n) is
+// the lcm over the prime powers of n
+std::vector<PrimePower> carmichaelFactors(const std::vector<PrimePower> &factorsOfN)
+{
+    std::vector<PrimePower> lambda;
+    for (const PrimePower &power : factorsOfN)
+    {
+        if (power.prime == 2)
+        {
+            unsigned exponent = power.exponent >= 3 ? power.exponent - 2 : power.exponent - 1;
+            if (exponent > 0)
+                mergeMaxPower(lambda, 2, exponent);
+            continue;
+        }
+        if (power.exponent > 1)
+            mergeMaxPower(lambda, power.prime, power.exponent - 1);
+        uint64_t even = power.prime - 1;
+        for (const PrimePower &part : even < (1ull << 32) ? factorUint32(static_cast<uint32_t>(even)) : factorUint64(even))
+            mergeMaxPower(lambda, part.prime, part.exponent);
+    }
+    return lambda;
+}
+
+uint64_t expandFactors(const std::vector<PrimePower> &factors)
+{
+    uint64_t value = 1;
+    for (const PrimePower &power : factors)
+    {
+        for (unsigned i = 0; i < power.exponent; ++i)
+            value *= power.prime;
+    }
+    return value;
+}
+
+uint64_t unitOrder(uint64_t base, uint64_t modulus)
+{
+    return unitOrderFromLambda(base, modulus, carmichaelFactors(factorUint64(modulus)));
+}
+
+uint64_t unitOrderFromLambda(uint64_t base, uint64_t modulus, const std::vector<PrimePower> &lambdaFactors)
+{
+    if (modulus == 1)
+        return 1;
+    uint64_t order = expandFactors(lambdaFactors);
+    base %= modulus;
+    for (const PrimePower &power : lambdaFactors)
+    {
+        for (unsigned i = 0; i < power.exponent && powMod64(base, order / power.prime, modulus) == 1; ++i)
+            order /= power.prime;
+    }
+    return order;
+}
+
+// Each prime p shared with base needs ceil(v_p(modulus) / v_p(base)) factors of base
+CoprimeSplit splitCoprime(uint64_t base, uint64_t modulus, const std::vector<PrimePower> &primes)
+{
+    CoprimeSplit split;
+    split.coprime = modulus;
+    for (const PrimePower &power : primes)
+    {
+        uint64_t p = power.prime;
+        if (base % p != 0 || split.coprime % p != 0)
+            continue;
+        unsigned valuation = 0, exponent = 0;
+        for (uint64_t rest = base; rest % p == 0; rest /= p)
+            ++valuation;
+        for (; split.coprime % p == 0; split.coprime /= p)
+            ++exponent;
+        split.clearing = std::max<uint64_t>(split.clearing, (exponent + valuation - 1) / valuation);
+    }
+    return split;
+}
+
+void unitOrdersAcrossModuli(uint64_t base, const uint32_t *moduli, size_t count, uint64_t *orders, SimdLevel level)
+{
+    std::vector<std::vector<PrimePower>> factors(count);
+    std::vector<OrderSearch> searches(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        factors[i] = carmichaelFactors(factorUint32(moduli[i]));
+        startSearch(searches[i], static_cast<uint32_t>(base % moduli[i]), moduli[i], factors[i]);
+    }
+    finishSearches(searches, orders, level);
+}
+
+void unitOrdersFromLambda(uint64_t base, const uint32_t *moduli, const uint32_t *lambdas, size_t count, uint64_t *orders,
+                          SimdLevel level)
+{
+    std::vector<std::vector<PrimePower>> factors(count);
+    std::vector<OrderSearch> searches(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        factors[i] = factorUint32(lambdas[i]);
+        startSearch(searches[i], static_cast<uint32_t>(base % moduli[i]), moduli[i], factors[i]);
+    }
+    finishSearches(searches, orders, level);
+}
+
+// Stepping costs about lambda / lanes products per base, the divisor checks a few dozen
+// per prime of lambda, so short cycles are cheaper to walk
+void unitOrdersOfBases(uint32_t modulus, uint32_t lambda, const uint32_t *bases, size_t count, uint64_t *orders, SimdLevel level)
+{
+    const uint32_t steppingLambda = 256;
+    if ((modulus & 1) && lambda <= steppingLambda)
+    {
+        unitOrdersFixedModulus(modulus, bases, count, orders, level);
+        return;
+    }
+    std::vector<PrimePower> factors = factorUint32(lambda);
+    std::vector<OrderSearch> searches(count);
+    for (size_t i = 0; i < count; ++i)
+        startSearch(searches[i], bases[i], modulus, factors);
+    finishSearches(searches, orders, level);
+}
@@ -0,0 +1,74 @@
+#ifndef ORDER_H
+#define ORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "simd.h"
+
+// Multiplicative orders from the factorization of the Carmichael function. The order of a
+// unit divides lambda(n), so it is found by dividing lambda(n) by each of its prime factors
+// for as long as base^(order / q) == 1 still holds: O(log^2 n) multiplications instead of
+// stepping through the whole cycle.
+
+struct PrimePower
+{
+    uint64_t prime;
+    unsigned exponent;
+};
+
+// The primes below 2^16, enough to factor any 32-bit value by trial division
+const std::vector<uint32_t> &smallPrimes();
+
+// Factorization of n by trial division over the primes below 2^16 (ascending primes)
+std::vector<PrimePower> factorUint32(uint32_t n);
+
+// Factorization of any 64-bit n (ascending primes): trial division as above, then
+// Miller-Rabin and Pollard's rho (Brent's variant) on the cofactor, whose prime factors
+// all exceed 2^16 so there are at most three of them
+std::vector<PrimePower> factorUint64(uint64_t n);
+bool isPrimeUint64(uint64_t n);
+
+// Raise the exponent of prime in factors to at least exponent, keeping primes sorted (the
+// lcm of a factorization with prime^exponent)
+void mergeMaxPower(std::vector<PrimePower> &factors, uint64_t prime, unsigned exponent);
+
+// Factorization of lambda(n) given the factorization of n
+std::vector<PrimePower> carmichaelFactors(const std::vector<PrimePower> &factorsOfN);
+uint64_t expandFactors(const std::vector<PrimePower> &factors);
+
+// Order of base modulo one modulus in [1, 2^64) coprime to it, by the same divisor checks
+// with scalar arithmetic (the modulus is factored with factorUint64)
+uint64_t unitOrder(uint64_t base, uint64_t modulus);
+
+// The same from the factorization of lambda(modulus), or of any multiple of the order
+uint64_t unitOrderFromLambda(uint64_t base, uint64_t modulus, const std::vector<PrimePower> &lambdaFactors);
+
+// modulus = n1 n2 where every prime of n1 divides base and n2 is coprime to it: base^i == 0
+// (mod n1) exactly from i = clearing on, and base is a unit mod n2. primes must hold every
+// prime the two share (those of either one will do); base >= 1.
+struct CoprimeSplit
+{
+    uint64_t clearing = 0; // Smallest k with n1 | base^k
+    uint64_t coprime = 1;  // n2
+};
+
+CoprimeSplit splitCoprime(uint64_t base, uint64_t modulus, const std::vector<PrimePower> &primes);
+
+// Orders of base modulo every moduli[i] (each in [3, 2^32) and coprime to base). The
+// divisor checks of all moduli run together through powEqualsOneAcrossModuli(); even
+// moduli are checked with scalar arithmetic.
+void unitOrdersAcrossModuli(uint64_t base, const uint32_t *moduli, size_t count, uint64_t *orders, SimdLevel level);
+
+// The same with lambdas[i] = lambda(moduli[i]) given (e.g. from the tables of totient.h),
+// so only lambda is factored, never the modulus. Any multiple of the order will do, such as
+// lambda of a multiple of moduli[i].
+void unitOrdersFromLambda(uint64_t base, const uint32_t *moduli, const uint32_t *lambdas, size_t count, uint64_t *orders,
+                          SimdLevel level);
+
+// Orders of every bases[i] (reduced and coprime to modulus) modulo one modulus in [3, 2^32)
+// with lambda(modulus) = lambda: small lambdas step the cycles in vector lanes
+// (unitOrdersFixedModulus), larger ones take the divisor checks
+void unitOrdersOfBases(uint32_t modulus, uint32_t lambda, const uint32_t *bases, size_t count, uint64_t *orders, SimdLevel level);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <cstdint>
+#include <string>
+
+// Small OS-specific helpers (Windows and POSIX)
+
+// Resident set size of this process in bytes (0 if unavailable)
+uint64_t currentResidentBytes();
+
+// Atomically replace target with source (both on the same filesystem)
+bool replaceFile(const std::string &source, const std::string &target);
+
+// Flush a closed file's data to the disk, and the directory entry of a file (such as the
+// name replaceFile() just gave it); either may be lost on power failure until then
+bool syncFile(const std::string &path);
+bool syncParentDirectory(const std::string &path);
+
+// Size of the console window in character cells (false if it cannot be determined)
+bool terminalSize(int &columns, int &rows);
+
+// Let the console show UTF-8 output and ANSI escape sequences (a no-op outside Windows)
+void enableUtf8Console();
+
+#endif
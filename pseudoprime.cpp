@@ -0,0 +1,273 @@
+#include "pseudoprime.h"
+#include "engine.h"
+#include "metrics.h"
+#include "modarith.h"
+#include "order.h"
+#include "sieve.h"
+#include "simd.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    const uint64_t firstReport = 10000; // Count lines at 10^4, 10^5, ... and the limit
+
+    MetricCounter &candidatesMetric = metricCounter("sh_pseudoprime_candidates", "Composites tested by the pseudoprime search.");
+
+    struct Pseudoprime
+    {
+        uint64_t n;
+        bool strong;
+        bool carmichael;
+    };
+
+    // Scratch of one worker for one segment: the queued vector tests and their owners
+    struct SegmentScratch
+    {
+        std::vector<uint64_t> owners;
+        std::vector<uint32_t> bases, moduli, exponents;
+        std::vector<uint8_t> results;
+        std::vector<uint64_t> survivors;
+        std::vector<uint32_t> smallestFactors;
+    };
+
+    // Is base^exponent == 1 (mod modulus) for an odd modulus in [3, 2^64)?
+    bool powerIsOne(const Montgomery64 &arithmetic, uint64_t base, uint64_t exponent)
+    {
+        uint64_t result = arithmetic.one, square = arithmetic.convertIn(base);
+        for (; exponent; exponent >>= 1)
+        {
+            if (exponent & 1)
+                result = arithmetic.multiply(result, square);
+            square = arithmetic.multiply(square, square);
+        }
+        return arithmetic.convertOut(result) == 1;
+    }
+
+    // Units mod 2^k form a group of order 2^(k-1), where raising to the odd power n - 1 is
+    // a bijection: base^(n - 1) == 1 (mod 2^k) exactly when base == 1 (mod 2^k)
+    bool oneModPowerOfTwo(uint64_t base, unsigned twos)
+    {
+        return twos < 64 && ((base - 1) & ((1ull << twos) - 1)) == 0;
+    }
+
+    // Miller-Rabin to base for an odd n: base^d == 1 or base^(d 2^r) == -1 with n - 1 = d 2^s
+    bool strongPseudoprime(uint64_t base, uint64_t n)
+    {
+        uint64_t odd = n - 1;
+        unsigned twos = __builtin_ctzll(odd);
+        odd >>= twos;
+        uint64_t x = powMod64(base % n, odd, n);
+        if (x == 1 || x == n - 1)
+            return true;
+        for (unsigned r = 1; r < twos; ++r)
+        {
+            x = mulMod64(x, x, n);
+            if (x == n - 1)
+                return true;
+        }
+        return false;
+    }
+
+    // Korselt: n is a Carmichael number when it is odd, squarefree and p - 1 | n - 1 for
+    // every prime p | n. Most pseudoprimes already fail at their smallest prime.
+    bool korselt(uint64_t n, uint32_t smallest)
+    {
+        if (!(n & 1) || smallest == 0)
+            return false;
+        uint64_t rest = n / smallest;
+        if (rest % smallest == 0 || (n - 1) % (smallest - 1) != 0)
+            return false;
+        for (const PrimePower &power : factorUint64(rest))
+        {
+            if (power.exponent > 1 || (n - 1) % (power.prime - 1) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    // Pseudoprimes among the composites of [low, high), given the segment's primes
+    void searchSegment(uint64_t base, const PrimeSieve &sieve, uint64_t low, uint64_t high, const std::vector<uint64_t> &primes,
+                       SegmentScratch &scratch, std::vector<Pseudoprime> &found, SimdLevel level)
+    {
+        scratch.owners.clear();
+        scratch.bases.clear();
+        scratch.moduli.clear();
+        scratch.exponents.clear();
+        scratch.survivors.clear();
+        size_t nextPrime = 0;
+        uint64_t tested = 0;
+        for (uint64_t n = std::max<uint64_t>(low, 4); n < high; ++n)
+        {
+            while (nextPrime < primes.size() && primes[nextPrime] < n)
+                ++nextPrime;
+            if (nextPrime < primes.size() && primes[nextPrime] == n)
+                continue;
+            ++tested;
+            unsigned twos = __builtin_ctzll(n);
+            uint64_t odd = n >> twos;
+            if (twos > 0 && !oneModPowerOfTwo(base, twos))
+                continue;
+            if (odd == 1)
+                scratch.survivors.push_back(n);
+            else if (n < (1ull << 32))
+            {
+                scratch.owners.push_back(n);
+                scratch.bases.push_back(static_cast<uint32_t>(base % odd));
+                scratch.moduli.push_back(static_cast<uint32_t>(odd));
+                scratch.exponents.push_back(static_cast<uint32_t>(n - 1));
+            }
+            else if (powerIsOne(Montgomery64(odd), base % odd, n - 1))
+                scratch.survivors.push_back(n);
+        }
+        scratch.results.resize(scratch.owners.size());
+        powEqualsOneAcrossModuli(scratch.bases.data(), scratch.moduli.data(), scratch.exponents.data(), scratch.owners.size(),
+                                 scratch.results.data(), level);
+        for (size_t k = 0; k < scratch.owners.size(); ++k)
+        {
+            if (scratch.results[k])
+                scratch.survivors.push_back(scratch.owners[k]);
+        }
+        candidatesMetric.add(tested);
+        if (scratch.survivors.empty())
+            return;
+
+        std::sort(scratch.survivors.begin(), scratch.survivors.end());
+        sieve.smallestFactors(low, high - low, scratch.smallestFactors);
+        for (uint64_t n : scratch.survivors)
+        {
+            bool strong = (n & 1) && strongPseudoprime(base, n);
+            found.push_back(Pseudoprime{n, strong, korselt(n, scratch.smallestFactors[n - low])});
+        }
+    }
+
+    // Finished segments waiting for every earlier one, so the stream stays in order
+    struct SearchProgress
+    {
+        std::mutex mutex;
+        std::ofstream file;
+        bool toFile = false;
+        bool failed = false;
+        std::map<uint64_t, std::vector<Pseudoprime>> pending;
+        uint64_t flushed = 0;
+        uint64_t fermat = 0;
+        uint64_t strong = 0;
+        uint64_t carmichael = 0;
+        uint64_t nextReport = firstReport;
+    };
+
+    void appendCounts(std::string &text, uint64_t base, uint64_t bound, const SearchProgress &progress)
+    {
+        text += "# n <= " + std::to_string(bound) + ": " + std::to_string(progress.fermat) + " pseudoprimes to base " +
+                std::to_string(base) + ", " + std::to_string(progress.strong) + " strong, " + std::to_string(progress.carmichael) +
+                " Carmichael\n";
+    }
+
+    bool writeText(SearchProgress &progress, const std::string &text)
+    {
+        TraceSpan span("write", "io");
+        if (progress.toFile)
+            progress.file << text;
+        else
+            std::cout << text;
+        statAdd(STAT_BYTES_WRITTEN, text.size());
+        return progress.toFile ? static_cast<bool>(progress.file) : static_cast<bool>(std::cout);
+    }
+
+    // Caller holds progress.mutex. Count lines fall between the numbers on either side of
+    // each power of ten, so they are exact whatever the segment boundaries.
+    void flushSearchPrefix(SearchProgress &progress, const PseudoprimeOptions &options, uint64_t low, uint64_t segments)
+    {
+        std::string text;
+        for (auto found = progress.pending.find(progress.flushed); found != progress.pending.end();
+             found = progress.pending.find(progress.flushed))
+        {
+            for (const Pseudoprime &match : found->second)
+            {
+                for (; progress.nextReport < match.n && progress.nextReport < options.limit; progress.nextReport *= 10)
+                    appendCounts(text, options.base, progress.nextReport, progress);
+                ++progress.fermat;
+                progress.strong += match.strong;
+                progress.carmichael += match.carmichael;
+                if ((!options.strong || match.strong) && (!options.carmichael || match.carmichael))
+                {
+                    text += std::to_string(match.n);
+                    text += '\n';
+                }
+            }
+            progress.pending.erase(found);
+            ++progress.flushed;
+            uint64_t covered = std::min(low + progress.flushed * sieveSegmentSpan - 1, options.limit);
+            for (; progress.nextReport <= covered && progress.nextReport < options.limit; progress.nextReport *= 10)
+                appendCounts(text, options.base, progress.nextReport, progress);
+            if (progress.flushed == segments)
+                appendCounts(text, options.base, options.limit, progress);
+        }
+        if (!text.empty() && !writeText(progress, text))
+            progress.failed = true;
+    }
+}
+
+int runPseudoprimeSearch(const PseudoprimeOptions &options)
+{
+    if (options.limit == 0 || options.limit > maxPseudoprimeLimit)
+    {
+        std::cout << "\033[31mThe search limit must be between 1 and 2^50.\033[0m\n";
+        return 1;
+    }
+    if (options.base < 2)
+    {
+        std::cout << "\033[31mThe pseudoprime search needs a base of at least 2.\033[0m\n";
+        return 1;
+    }
+    SearchProgress progress;
+    progress.toFile = !options.outputPath.empty();
+    if (progress.toFile)
+    {
+        progress.file.open(options.outputPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!progress.file)
+        {
+            std::cout << "\033[31mCannot open output file " << options.outputPath << ".\033[0m\n";
+            return 1;
+        }
+    }
+
+    PrimeSieve sieve(options.limit);
+    const uint64_t low = 1;
+    uint64_t segments = (options.limit - low) / sieveSegmentSpan + 1;
+    SimdLevel level = activeSimdLevel();
+    std::vector<SegmentScratch> scratch(sharedThreadPool().size());
+    sieve.forEachSegment(low, options.limit, [&](uint64_t segment, const std::vector<uint64_t> &primes, unsigned worker)
+    {
+        TraceSpan span("segment", "pseudoprime");
+        uint64_t segmentLow = low + segment * sieveSegmentSpan;
+        uint64_t segmentHigh = std::min(segmentLow + sieveSegmentSpan, options.limit + 1);
+        std::vector<Pseudoprime> found;
+        searchSegment(options.base, sieve, segmentLow, segmentHigh, primes, scratch[worker], found, level);
+
+        std::lock_guard<std::mutex> lock(progress.mutex);
+        progress.pending.emplace(segment, std::move(found));
+        flushSearchPrefix(progress, options, low, segments);
+    });
+
+    if (progress.failed || progress.flushed != segments)
+    {
+        std::cout << "\033[31mWrite failed.\033[0m\n";
+        return 1;
+    }
+    if (progress.toFile)
+    {
+        progress.file.close();
+        std::cout << progress.fermat << " pseudoprimes to base " << options.base << " up to " << options.limit << " ("
+                  << progress.strong << " strong, " << progress.carmichael << " Carmichael).\n";
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef PSEUDOPRIME_H
+#define PSEUDOPRIME_H
+
+#include <cstdint>
+#include <string>
+
+// Composites n <= limit with base^(n - 1) == 1 (mod n), the Fermat pseudoprimes to base. The
+// segmented sieve of sieve.h hands over each segment's primes, every other n >= 4 of the
+// segment is tested, and below 2^32 the tests run 8 or 16 at a time through the
+// lane-per-modulus vector kernel (an even n = 2^k m only needs base = 1 mod 2^k and the test
+// mod its odd part m). The rare survivors are checked for being strong pseudoprimes and,
+// from the segment's smallest-factor table and Korselt's criterion, Carmichael numbers.
+// Matches are streamed in order, one per line, with "#" lines giving the counts at every
+// power of ten and at the limit.
+struct PseudoprimeOptions
+{
+    uint64_t base = 2;
+    uint64_t limit = 1000000;
+    bool strong = false;     // List only strong pseudoprimes (odd n passing Miller-Rabin)
+    bool carmichael = false; // List only Carmichael numbers (coprime to base, so base 2 finds them all)
+    std::string outputPath;  // Empty = standard output
+};
+
+const uint64_t maxPseudoprimeLimit = 1ull << 50;
+
+int runPseudoprimeSearch(const PseudoprimeOptions &options);
+
+#endif
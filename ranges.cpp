@@ -0,0 +1,294 @@
+#include "ranges.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+
+namespace
+{
+    const uint64_t blockGrain = 64;       // Blocks per parallelFor piece of the block pass
+    const uint64_t tableGrain = 1 << 14;  // Entries per piece of a sparse-table level
+
+    mpz_class uint128ToMpz(unsigned __int128 value)
+    {
+        mpz_class result = uint64ToMpz(static_cast<uint64_t>(value >> 64));
+        result <<= 64;
+        result += uint64ToMpz(static_cast<uint64_t>(value));
+        return result;
+    }
+
+    unsigned floorLog2(uint64_t value)
+    {
+        return 63 - static_cast<unsigned>(__builtin_clzll(value));
+    }
+}
+
+void RangeIndex::build(const std::vector<mpz_class> &sequence, const mpz_class &base, const mpz_class &modulo)
+{
+    TraceSpan span("range-index", "sequence");
+    terms = nullptr;
+    narrowPrefix.clear();
+    widePrefix.clear();
+    minTable.clear();
+    maxTable.clear();
+    byValue.clear();
+    uint64_t n = sequence.size();
+    if (n == 0)
+        return;
+
+    // The term after the last stored one is the first repeated term, so its position is the tail
+    mpz_class next = sequence.back() * base % modulo;
+    if (next < 0)
+        next += modulo;
+    auto repeat = std::find(sequence.begin(), sequence.end(), next);
+    cycle.tail = repeat == sequence.end() ? 0 : static_cast<uint64_t>(repeat - sequence.begin());
+    cycle.period = n - cycle.tail;
+
+    size_t bits = mpz_sizeinbase(modulo.get_mpz_t(), 2);
+    narrow = bits <= 64 && bits + floorLog2(n) + 1 <= 127;
+
+    // Per-block sums and extremes, then the prefix sums and the sparse table over blocks
+    uint64_t blocks = (n + rangeBlockTerms - 1) / rangeBlockTerms;
+    std::vector<unsigned __int128> narrowSums(narrow ? blocks : 0);
+    std::vector<mpz_class> wideSums(narrow ? 0 : blocks);
+    minTable.assign(1, std::vector<uint32_t>(blocks));
+    maxTable.assign(1, std::vector<uint32_t>(blocks));
+    terms = &sequence;
+    sharedThreadPool().parallelFor(0, blocks, blockGrain, [&](uint64_t first, uint64_t last, unsigned)
+    {
+        for (uint64_t b = first; b < last; ++b)
+        {
+            uint64_t begin = b * rangeBlockTerms, end = std::min(n, begin + rangeBlockTerms);
+            uint32_t lowest = static_cast<uint32_t>(begin), highest = lowest;
+            for (uint64_t i = begin + 1; i < end; ++i)
+            {
+                if (better(static_cast<uint32_t>(i), lowest, false))
+                    lowest = static_cast<uint32_t>(i);
+                if (better(static_cast<uint32_t>(i), highest, true))
+                    highest = static_cast<uint32_t>(i);
+            }
+            minTable[0][b] = lowest;
+            maxTable[0][b] = highest;
+            if (narrow)
+            {
+                unsigned __int128 sum = 0;
+                for (uint64_t i = begin; i < end; ++i)
+                    sum += mpzToUint64(sequence[i]);
+                narrowSums[b] = sum;
+            }
+            else
+            {
+                mpz_class sum;
+                for (uint64_t i = begin; i < end; ++i)
+                    sum += sequence[i];
+                wideSums[b].swap(sum);
+            }
+        }
+    });
+
+    if (narrow)
+    {
+        narrowPrefix.resize(blocks + 1);
+        for (uint64_t b = 0; b < blocks; ++b)
+            narrowPrefix[b + 1] = narrowPrefix[b] + narrowSums[b];
+    }
+    else
+    {
+        widePrefix.resize(blocks + 1);
+        for (uint64_t b = 0; b < blocks; ++b)
+            widePrefix[b + 1] = widePrefix[b] + wideSums[b];
+    }
+    cycleSum = prefixSum(n) - prefixSum(cycle.tail);
+
+    for (unsigned level = 1; (1ull << level) <= blocks; ++level)
+    {
+        uint64_t half = 1ull << (level - 1);
+        uint64_t width = blocks - 2 * half + 1;
+        minTable.emplace_back(width);
+        maxTable.emplace_back(width);
+        const std::vector<uint32_t> &lowerMin = minTable[level - 1], &lowerMax = maxTable[level - 1];
+        std::vector<uint32_t> &levelMin = minTable[level], &levelMax = maxTable[level];
+        sharedThreadPool().parallelFor(0, width, tableGrain, [&](uint64_t first, uint64_t last, unsigned)
+        {
+            for (uint64_t i = first; i < last; ++i)
+            {
+                levelMin[i] = better(lowerMin[i + half], lowerMin[i], false) ? lowerMin[i + half] : lowerMin[i];
+                levelMax[i] = better(lowerMax[i + half], lowerMax[i], true) ? lowerMax[i + half] : lowerMax[i];
+            }
+        });
+    }
+}
+
+uint64_t RangeIndex::indexOf(uint64_t k) const
+{
+    return k <= cycle.tail ? k - 1 : cycle.tail + (k - 1 - cycle.tail) % cycle.period;
+}
+
+const mpz_class &RangeIndex::term(uint64_t k) const
+{
+    return (*terms)[indexOf(k)];
+}
+
+bool RangeIndex::better(uint32_t a, uint32_t b, bool maximum) const
+{
+    int order = cmp((*terms)[a], (*terms)[b]);
+    return maximum ? order > 0 : order < 0;
+}
+
+mpz_class RangeIndex::prefixSum(uint64_t count) const
+{
+    uint64_t block = count / rangeBlockTerms;
+    const std::vector<mpz_class> &sequence = *terms;
+    if (narrow)
+    {
+        unsigned __int128 sum = narrowPrefix[block];
+        for (uint64_t i = block * rangeBlockTerms; i < count; ++i)
+            sum += mpzToUint64(sequence[i]);
+        return uint128ToMpz(sum);
+    }
+    mpz_class sum = widePrefix[block];
+    for (uint64_t i = block * rangeBlockTerms; i < count; ++i)
+        sum += sequence[i];
+    return sum;
+}
+
+// Up to the tail the stored prefix; after it, q whole cycles plus the first r cycle terms,
+// where k = tail + q * period + r
+mpz_class RangeIndex::sumThrough(uint64_t k) const
+{
+    if (k <= cycle.tail)
+        return prefixSum(k);
+    uint64_t cycles = (k - cycle.tail) / cycle.period;
+    uint64_t rest = (k - cycle.tail) % cycle.period;
+    return uint64ToMpz(cycles) * cycleSum + prefixSum(cycle.tail + rest);
+}
+
+uint32_t RangeIndex::extreme(uint64_t first, uint64_t last, bool maximum) const
+{
+    uint64_t firstBlock = first / rangeBlockTerms, lastBlock = last / rangeBlockTerms;
+    uint32_t best = static_cast<uint32_t>(first);
+    auto scan = [&](uint64_t from, uint64_t to)
+    {
+        for (uint64_t i = from; i <= to; ++i)
+            if (better(static_cast<uint32_t>(i), best, maximum))
+                best = static_cast<uint32_t>(i);
+    };
+    if (firstBlock == lastBlock)
+    {
+        scan(first + 1, last);
+        return best;
+    }
+    scan(first + 1, (firstBlock + 1) * rangeBlockTerms - 1);
+    if (firstBlock + 1 < lastBlock)
+    {
+        // Two overlapping power-of-two runs of blocks cover the whole blocks in between
+        const std::vector<std::vector<uint32_t>> &table = maximum ? maxTable : minTable;
+        unsigned level = floorLog2(lastBlock - firstBlock - 1);
+        uint32_t left = table[level][firstBlock + 1];
+        uint32_t right = table[level][lastBlock - (1ull << level)];
+        if (better(left, best, maximum))
+            best = left;
+        if (better(right, best, maximum))
+            best = right;
+    }
+    scan(lastBlock * rangeBlockTerms, last);
+    return best;
+}
+
+RangeAggregate RangeIndex::aggregate(uint64_t first, uint64_t last) const
+{
+    RangeAggregate result;
+    result.count = last - first + 1;
+    result.sum = sumThrough(last) - sumThrough(first - 1);
+
+    bool found = false;
+    auto offer = [&](uint32_t lowest, uint64_t lowestAt, uint32_t highest, uint64_t highestAt)
+    {
+        const mpz_class &low = (*terms)[lowest], &high = (*terms)[highest];
+        if (!found || low < result.minimum || (low == result.minimum && lowestAt < result.minimumAt))
+        {
+            result.minimum = low;
+            result.minimumAt = lowestAt;
+        }
+        if (!found || high > result.maximum || (high == result.maximum && highestAt < result.maximumAt))
+        {
+            result.maximum = high;
+            result.maximumAt = highestAt;
+        }
+        found = true;
+    };
+    // Indices [from, to] stored for exponents starting at exponent
+    auto piece = [&](uint64_t from, uint64_t to, uint64_t exponent)
+    {
+        uint32_t lowest = extreme(from, to, false), highest = extreme(from, to, true);
+        offer(lowest, exponent + (lowest - from), highest, exponent + (highest - from));
+    };
+
+    uint64_t tail = cycle.tail, period = cycle.period;
+    if (first <= tail)
+        piece(first - 1, std::min(last, tail) - 1, first);
+    if (last > tail)
+    {
+        uint64_t start = std::max(first, tail + 1);
+        uint64_t length = last - start + 1;
+        uint64_t offset = (start - 1 - tail) % period;
+        if (length >= period)
+        {
+            // Every cycle term occurs; each extreme first appears within one period of start
+            uint32_t lowest = extreme(tail, tail + period - 1, false), highest = extreme(tail, tail + period - 1, true);
+            offer(lowest, start + (lowest - tail + period - offset) % period, highest,
+                  start + (highest - tail + period - offset) % period);
+        }
+        else if (offset + length <= period)
+            piece(tail + offset, tail + offset + length - 1, start);
+        else
+        {
+            piece(tail + offset, tail + period - 1, start);
+            piece(tail, tail + offset + length - period - 1, start + period - offset);
+        }
+    }
+    return result;
+}
+
+uint64_t RangeIndex::countValue(const mpz_class &value, uint64_t first, uint64_t last)
+{
+    const std::vector<mpz_class> &sequence = *terms;
+    if (byValue.empty())
+    {
+        TraceSpan span("range-sort", "sequence");
+        byValue.resize(sequence.size());
+        for (uint32_t i = 0; i < byValue.size(); ++i)
+            byValue[i] = i;
+        std::sort(byValue.begin(), byValue.end(), [&sequence](uint32_t a, uint32_t b) { return sequence[a] < sequence[b]; });
+    }
+    auto slot = std::lower_bound(byValue.begin(), byValue.end(), value, [&sequence](uint32_t index, const mpz_class &target)
+    {
+        return sequence[index] < target;
+    });
+    if (slot == byValue.end() || sequence[*slot] != value)
+        return 0;
+
+    // A tail term occurs once, at exponent index + 1; a cycle term at index + 1 + j * period
+    uint64_t occurs = static_cast<uint64_t>(*slot) + 1;
+    if (occurs <= cycle.tail)
+        return occurs >= first && occurs <= last ? 1 : 0;
+    uint64_t from = std::max(first, occurs);
+    if (from > last)
+        return 0;
+    uint64_t skip = from - occurs;
+    uint64_t lowest = skip / cycle.period + (skip % cycle.period != 0);
+    uint64_t highest = (last - occurs) / cycle.period;
+    return highest >= lowest ? highest - lowest + 1 : 0;
+}
+
+void printRangeAggregate(std::ostream &out, uint64_t first, uint64_t last, const RangeAggregate &aggregate)
+{
+    out << "\n--- Terms " << first << " to " << last << " ---\n";
+    out << "Count: " << aggregate.count << "\n";
+    out << "Sum: " << aggregate.sum << "\n";
+    mpf_class mean(aggregate.sum, mpz_sizeinbase(aggregate.sum.get_mpz_t(), 2) + 64);
+    mean /= mpf_class(uint64ToMpz(aggregate.count), mean.get_prec());
+    out << "Mean: " << mean << "\n";
+    out << "Minimum: " << aggregate.minimum << " (first at k = " << aggregate.minimumAt << ")\n";
+    out << "Maximum: " << aggregate.maximum << " (first at k = " << aggregate.maximumAt << ")\n";
+}
@@ -0,0 +1,73 @@
+#ifndef RANGES_H
+#define RANGES_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include <gmpxx.h>
+#include "engine.h"
+
+// Aggregates of t_k = base^k (mod modulo) over exponent ranges [first, last] anywhere in
+// 1 .. 2^64 - 1, answered from the stored distinct terms alone. Past the tail the sequence
+// repeats with the period, so a range is a piece of the tail, some whole cycles and at most
+// two pieces of one cycle. Sums combine prefix sums over the stored terms with a multiple
+// of the cycle sum; minima and maxima come from a sparse table over blocks of terms, with
+// the ends of a range scanned inside their blocks. Every query costs a bounded number of
+// block scans and table lookups, independent of the range length. Prefix sums are kept as
+// 128-bit integers when they fit (moduli up to 64 bits) and as GMP integers otherwise.
+
+const uint64_t rangeBlockTerms = 256; // Terms per block of the prefix sums and the sparse table
+
+struct RangeAggregate
+{
+    uint64_t count = 0; // last - first + 1
+    mpz_class sum;
+    mpz_class minimum, maximum;
+    uint64_t minimumAt = 0; // Smallest exponent in the range holding the minimum
+    uint64_t maximumAt = 0; // ... and the maximum
+};
+
+class RangeIndex
+{
+public:
+    // Index sequence, the distinct terms t_1 .. t_(tail + period) as generateSequenceTerms() returns
+    // them, on the shared thread pool. The index refers to sequence, which must stay unchanged
+    // (and alive) while it is used; sequences of 2^32 terms or more are not supported.
+    void build(const std::vector<mpz_class> &sequence, const mpz_class &base, const mpz_class &modulo);
+
+    bool empty() const { return terms == nullptr; }
+    const SequenceShape &shape() const { return cycle; }
+
+    // t_k for any k >= 1
+    const mpz_class &term(uint64_t k) const;
+
+    // Sum, minimum and maximum over exponents [first, last], 1 <= first <= last
+    RangeAggregate aggregate(uint64_t first, uint64_t last) const;
+
+    // Number of k in [first, last] with t_k == value. Every term of the tail and of the cycle
+    // is distinct, so this is a residue count once the value is located; the first call sorts
+    // the terms by value (O(n log n)), later calls take O(log n).
+    uint64_t countValue(const mpz_class &value, uint64_t first, uint64_t last);
+
+private:
+    uint64_t indexOf(uint64_t k) const;
+    mpz_class prefixSum(uint64_t count) const;  // t_1 + ... + t_count, count <= stored terms
+    mpz_class sumThrough(uint64_t k) const;     // t_1 + ... + t_k for any k
+    bool better(uint32_t a, uint32_t b, bool maximum) const; // Strictly smaller (larger) term
+    uint32_t extreme(uint64_t first, uint64_t last, bool maximum) const; // Over indices [first, last]
+
+    const std::vector<mpz_class> *terms = nullptr;
+    SequenceShape cycle;
+    bool narrow = false;                          // Prefix sums fit in 128 bits
+    std::vector<unsigned __int128> narrowPrefix;  // Sum of the terms before each block
+    std::vector<mpz_class> widePrefix;
+    mpz_class cycleSum;
+    std::vector<std::vector<uint32_t>> minTable;  // Level j: index of the extreme of 2^j blocks
+    std::vector<std::vector<uint32_t>> maxTable;
+    std::vector<uint32_t> byValue;                // Indices sorted by term value, built on demand
+};
+
+// Console report of one range: sum, mean, and the minimum and maximum with their exponents
+void printRangeAggregate(std::ostream &out, uint64_t first, uint64_t last, const RangeAggregate &aggregate);
+
+#endif
@@ -0,0 +1,184 @@
+#include "raster.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // UTF-8 of U+2800 + mask (three bytes: E2, A0 | mask >> 6, 80 | mask & 63); mask 0 is a space
+    struct BrailleTable
+    {
+        char bytes[256][3];
+        uint8_t length[256];
+
+        BrailleTable()
+        {
+            for (int mask = 0; mask < 256; ++mask)
+            {
+                bytes[mask][0] = static_cast<char>(0xE2);
+                bytes[mask][1] = static_cast<char>(0xA0 | (mask >> 6));
+                bytes[mask][2] = static_cast<char>(0x80 | (mask & 0x3F));
+                length[mask] = 3;
+            }
+            bytes[0][0] = ' ';
+            length[0] = 1;
+        }
+    };
+
+    // "\033[38;5;Nm" and "\033[48;5;Nm" for every palette index
+    struct ColourTable
+    {
+        char foreground[256][12];
+        char background[256][12];
+        uint8_t length[256];
+
+        ColourTable()
+        {
+            for (int index = 0; index < 256; ++index)
+            {
+                std::string number = std::to_string(index);
+                std::string fg = "\033[38;5;" + number + "m", bg = "\033[48;5;" + number + "m";
+                std::memcpy(foreground[index], fg.data(), fg.size());
+                std::memcpy(background[index], bg.data(), bg.size());
+                length[index] = static_cast<uint8_t>(fg.size());
+            }
+        }
+    };
+
+    const BrailleTable brailleTable;
+    const ColourTable colourTable;
+    const char upperHalfBlock[] = "\xE2\x96\x80";
+    const char resetAndNewline[] = "\033[0m\n";
+}
+
+void BrailleCanvas::resize(int newColumns, int newRows)
+{
+    columns = newColumns;
+    rows = newRows;
+    cells.assign(static_cast<size_t>(columns) * rows, 0);
+}
+
+void BrailleCanvas::clear()
+{
+    std::fill(cells.begin(), cells.end(), 0);
+}
+
+// Rows top..bottom inclusive; within one cell the dots are OR-ed in a single mask
+void BrailleCanvas::verticalLine(int x, int top, int bottom)
+{
+    uint8_t column = brailleDotBits[0][x & 1] | brailleDotBits[1][x & 1] | brailleDotBits[2][x & 1] | brailleDotBits[3][x & 1];
+    for (int cellRow = top >> 2; cellRow <= bottom >> 2; ++cellRow)
+    {
+        uint8_t mask = column;
+        int first = std::max(top - cellRow * 4, 0), last = std::min(bottom - cellRow * 4, 3);
+        for (int y = 0; y < first; ++y)
+            mask &= ~brailleDotBits[y][x & 1];
+        for (int y = last + 1; y < 4; ++y)
+            mask &= ~brailleDotBits[y][x & 1];
+        cells[static_cast<size_t>(cellRow) * columns + (x >> 1)] |= mask;
+    }
+}
+
+// The string is grown once to the worst case and trimmed afterwards, so the inner loop is
+// only table lookups and small copies
+void BrailleCanvas::encode(std::string &out, const char *colour) const
+{
+    size_t colourLength = std::strlen(colour);
+    size_t resetLength = colourLength ? sizeof(resetAndNewline) - 1 : 1;
+    size_t start = out.size();
+    out.resize(start + static_cast<size_t>(rows) * (colourLength + static_cast<size_t>(columns) * 3 + resetLength));
+    char *cursor = &out[start];
+    const uint8_t *cell = cells.data();
+    for (int row = 0; row < rows; ++row)
+    {
+        std::memcpy(cursor, colour, colourLength);
+        cursor += colourLength;
+        for (int column = 0; column < columns; ++column, ++cell)
+        {
+            std::memcpy(cursor, brailleTable.bytes[*cell], 3);
+            cursor += brailleTable.length[*cell];
+        }
+        std::memcpy(cursor, colourLength ? resetAndNewline : "\n", resetLength);
+        cursor += resetLength;
+    }
+    out.resize(cursor - out.data());
+}
+
+void HalfBlockCanvas::resize(int newColumns, int newRows, uint8_t background)
+{
+    columns = newColumns;
+    rows = newRows;
+    pixels.assign(static_cast<size_t>(columns) * rows * 2, background);
+}
+
+void HalfBlockCanvas::clear(uint8_t background)
+{
+    std::fill(pixels.begin(), pixels.end(), background);
+}
+
+void HalfBlockCanvas::verticalLine(int x, int top, int bottom, uint8_t colour)
+{
+    for (int y = top; y <= bottom; ++y)
+        pixels[static_cast<size_t>(y) * columns + x] = colour;
+}
+
+void HalfBlockCanvas::encode(std::string &out) const
+{
+    size_t start = out.size();
+    size_t worstCell = 2 * sizeof(colourTable.foreground[0]) + 3;
+    out.resize(start + static_cast<size_t>(rows) * (static_cast<size_t>(columns) * worstCell + sizeof(resetAndNewline)));
+    char *cursor = &out[start];
+    for (int row = 0; row < rows; ++row)
+    {
+        const uint8_t *top = pixels.data() + static_cast<size_t>(row) * 2 * columns;
+        const uint8_t *bottom = top + columns;
+        int foreground = -1, background = -1;
+        for (int column = 0; column < columns; ++column)
+        {
+            if (top[column] != foreground)
+            {
+                foreground = top[column];
+                std::memcpy(cursor, colourTable.foreground[foreground], colourTable.length[foreground]);
+                cursor += colourTable.length[foreground];
+            }
+            if (bottom[column] != background)
+            {
+                background = bottom[column];
+                std::memcpy(cursor, colourTable.background[background], colourTable.length[background]);
+                cursor += colourTable.length[background];
+            }
+            std::memcpy(cursor, upperHalfBlock, 3);
+            cursor += 3;
+        }
+        std::memcpy(cursor, resetAndNewline, sizeof(resetAndNewline) - 1);
+        cursor += sizeof(resetAndNewline) - 1;
+    }
+    out.resize(cursor - out.data());
+}
+
+// Twenty steps through the 6x6x6 colour cube (index 16 + 36r + 6g + b)
+uint8_t heatColour(float value)
+{
+    int step = static_cast<int>(std::min(std::max(value, 0.0f), 1.0f) * 20.0f + 0.5f);
+    int segment = std::min(step / 5, 3), t = step - segment * 5;
+    int r = 0, g = 0, b = 0;
+    switch (segment)
+    {
+    case 0: g = t; b = 5; break;     // Blue to cyan
+    case 1: g = 5; b = 5 - t; break; // Cyan to green
+    case 2: r = t; g = 5; break;     // Green to yellow
+    default: r = 5; g = 5 - t; break; // Yellow to red
+    }
+    return static_cast<uint8_t>(16 + 36 * r + 6 * g + b);
+}
+
+// Linear between the five stops of heatColour()
+void heatRgb(float value, uint8_t *rgb)
+{
+    static const float stops[5][3] = {{0, 0, 255}, {0, 255, 255}, {0, 255, 0}, {255, 255, 0}, {255, 0, 0}};
+    float position = std::min(std::max(value, 0.0f), 1.0f) * 4.0f;
+    int segment = std::min(static_cast<int>(position), 3);
+    float t = position - static_cast<float>(segment);
+    for (int channel = 0; channel < 3; ++channel)
+        rgb[channel] = static_cast<uint8_t>(stops[segment][channel] + (stops[segment + 1][channel] - stops[segment][channel]) * t + 0.5f);
+}
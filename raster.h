@@ -0,0 +1,72 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Pixel framebuffers for terminal plots. Drawing only sets bits or bytes in memory; a frame
+// is then encoded to UTF-8 in one pass with precomputed byte sequences per cell value, so
+// the cost of a frame is one table copy per cell.
+//   BrailleCanvas    2 x 4 monochrome dots per cell (U+2800..U+28FF)
+//   HalfBlockCanvas  1 x 2 colour pixels per cell: an upper half block (U+2580) with the
+//                    top pixel as foreground and the bottom pixel as background colour,
+//                    using the xterm 256-colour palette
+
+// Braille dot bit for the pixel at row y % 4, column x % 2 of a cell
+const uint8_t brailleDotBits[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+
+class BrailleCanvas
+{
+public:
+    // Resize to columns x rows cells and clear
+    void resize(int columns, int rows);
+    void clear();
+
+    int width() const { return columns * 2; }
+    int height() const { return rows * 4; }
+
+    // x < width(), y < height()
+    void set(int x, int y) { cells[static_cast<size_t>(y >> 2) * columns + (x >> 1)] |= brailleDotBits[y & 3][x & 1]; }
+    void verticalLine(int x, int top, int bottom);
+
+    // Append every row wrapped in colour (an SGR sequence, or empty) and ended by "\n".
+    // Empty cells are written as spaces.
+    void encode(std::string &out, const char *colour) const;
+
+private:
+    int columns = 0;
+    int rows = 0;
+    std::vector<uint8_t> cells; // One dot mask per cell: the framebuffer is stored in cell order
+};
+
+class HalfBlockCanvas
+{
+public:
+    // Resize to columns x rows cells and fill with background
+    void resize(int columns, int rows, uint8_t background);
+    void clear(uint8_t background);
+
+    int width() const { return columns; }
+    int height() const { return rows * 2; }
+
+    void set(int x, int y, uint8_t colour) { pixels[static_cast<size_t>(y) * columns + x] = colour; }
+    void verticalLine(int x, int top, int bottom, uint8_t colour);
+
+    // Append every row ended by a reset and "\n"; colour changes are only written where the
+    // foreground or background differs from the previous cell of the row
+    void encode(std::string &out) const;
+
+private:
+    int columns = 0;
+    int rows = 0;
+    std::vector<uint8_t> pixels; // Palette index per pixel, row-major
+};
+
+// Palette index on a blue-cyan-green-yellow-red ramp for value in [0, 1]
+uint8_t heatColour(float value);
+
+// The same ramp in 24-bit colour, interpolated continuously (writes rgb[0..2])
+void heatRgb(float value, uint8_t *rgb);
+
+#endif
@@ -0,0 +1,264 @@
+#include "sieve.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const uint64_t segmentOdds = sieveSegmentSpan / 2;
+    const uint64_t runSegments = 256;        // Segments per parallelFor piece, sharing one set of buckets
+    const uint32_t wheelPrimes[] = {3, 5, 7, 11, 13};
+    const uint64_t wheelPeriod = 3 * 5 * 7 * 11 * 13; // In odd positions: 2x + 1 = 0 (mod p) repeats every p
+
+    uint64_t floorSqrt(uint64_t n)
+    {
+        uint64_t root = static_cast<uint64_t>(std::sqrt(static_cast<double>(n)));
+        while (root > 0 && (root > UINT32_MAX || root * root > n))
+            --root;
+        while (root < UINT32_MAX && (root + 1) * (root + 1) <= n)
+            ++root;
+        return root;
+    }
+
+    // Flags of the odd numbers 2x + 1 for x = 0 .. wheelPeriod + segmentOdds - 1: 1 for the
+    // multiples of a wheel prime, so a segment starting at any x is one memcpy away
+    const std::vector<uint8_t> &wheelPattern()
+    {
+        static const std::vector<uint8_t> pattern = []()
+        {
+            std::vector<uint8_t> flags(wheelPeriod + segmentOdds, 0);
+            for (uint32_t p : wheelPrimes)
+            {
+                for (uint64_t x = (p - 1) / 2; x < flags.size(); x += p)
+                    flags[x] = 1;
+            }
+            return flags;
+        }();
+        return pattern;
+    }
+
+    // Odd primes up to limit by a plain sieve, for the sieving primes of small limits
+    std::vector<uint32_t> oddPrimesUpTo(uint64_t limit)
+    {
+        std::vector<uint8_t> composite(limit / 2 + 1, 0);
+        std::vector<uint32_t> primes;
+        for (uint64_t x = 1; 2 * x + 1 <= limit; ++x)
+        {
+            if (composite[x])
+                continue;
+            uint64_t p = 2 * x + 1;
+            primes.push_back(static_cast<uint32_t>(p));
+            for (uint64_t y = p * p / 2; y <= limit / 2; y += p)
+                composite[y] = 1;
+        }
+        return primes;
+    }
+
+    // Sieves consecutive segments of one run. Positions are odd indices x (the number 2x + 1)
+    // relative to the run's first odd index. Primes up to segmentOdds keep their next multiple
+    // in offsets; larger ones sit in the bucket of the segment their next multiple falls in.
+    class SegmentWalker
+    {
+    public:
+        SegmentWalker(const std::vector<uint32_t> &primes, uint64_t first, uint64_t last, uint64_t firstSegment, uint64_t endSegment)
+            : first(first), last(last), firstSegment(firstSegment), buckets(endSegment - firstSegment)
+        {
+            runBase = (first + firstSegment * sieveSegmentSpan) / 2;
+            uint64_t runEnd = std::min(first + endSegment * sieveSegmentSpan, last + 1);
+            uint64_t runLimit = runEnd / 2 - runBase; // Odd positions in the run
+            uint64_t runStart = 2 * runBase + 1;
+            for (uint32_t q : primes)
+            {
+                if (q <= wheelPrimes[4])
+                    continue;
+                uint64_t square = static_cast<uint64_t>(q) * q;
+                if (square >= runEnd)
+                    break;
+                uint64_t multiple = square >= runStart ? square : (runStart + q - 1) / q * q;
+                if (!(multiple & 1))
+                    multiple += q;
+                uint64_t position = (multiple - 1) / 2 - runBase;
+                if (q <= segmentOdds)
+                {
+                    small.push_back(q);
+                    offsets.push_back(position);
+                }
+                else if (position < runLimit)
+                    buckets[position / segmentOdds].push_back(Hit{q, static_cast<uint32_t>(position % segmentOdds)});
+            }
+        }
+
+        void sieve(uint64_t segment, std::vector<uint64_t> &found)
+        {
+            uint64_t local = segment - firstSegment;
+            uint64_t low = first + segment * sieveSegmentSpan;
+            uint64_t high = std::min(low + sieveSegmentSpan, last + 1);
+            uint64_t base = runBase + local * segmentOdds; // Odd index of the segment's first flag
+            uint64_t odds = high / 2 - low / 2;
+            uint64_t start = local * segmentOdds;
+
+            const std::vector<uint8_t> &pattern = wheelPattern();
+            flags.resize(segmentOdds);
+            std::memcpy(flags.data(), pattern.data() + base % wheelPeriod, odds);
+            for (uint32_t p : wheelPrimes)
+            {
+                uint64_t x = (p - 1) / 2;
+                if (x >= base && x < base + odds)
+                    flags[x - base] = 0;
+            }
+            if (base == 0 && odds > 0)
+                flags[0] = 1; // 1 is not prime
+
+            for (size_t k = 0; k < small.size(); ++k)
+            {
+                uint64_t q = small[k];
+                uint64_t i = offsets[k] - start;
+                for (; i < odds; i += q)
+                    flags[i] = 1;
+                offsets[k] = start + i;
+            }
+            std::vector<Hit> &hits = buckets[local];
+            for (const Hit &hit : hits)
+            {
+                flags[hit.offset] = 1;
+                uint64_t next = start + hit.offset + hit.prime;
+                uint64_t target = next / segmentOdds;
+                if (target < buckets.size())
+                    buckets[target].push_back(Hit{hit.prime, static_cast<uint32_t>(next % segmentOdds)});
+            }
+            hits.clear();
+            hits.shrink_to_fit();
+
+            found.clear();
+            if (low <= 2 && high > 2)
+                found.push_back(2);
+            // Eight flags per word: each clear flag byte leaves its low bit set in the inverse
+            uint64_t i = 0;
+            for (; i + 8 <= odds; i += 8)
+            {
+                uint64_t word;
+                std::memcpy(&word, flags.data() + i, 8);
+                for (uint64_t open = ~word & 0x0101010101010101ull; open; open &= open - 1)
+                    found.push_back(2 * (base + i + __builtin_ctzll(open) / 8) + 1);
+            }
+            for (; i < odds; ++i)
+            {
+                if (!flags[i])
+                    found.push_back(2 * (base + i) + 1);
+            }
+        }
+
+    private:
+        struct Hit
+        {
+            uint32_t prime;
+            uint32_t offset; // Within the bucket's segment
+        };
+
+        uint64_t first, last, firstSegment;
+        uint64_t runBase = 0;
+        std::vector<uint32_t> small;
+        std::vector<uint64_t> offsets;
+        std::vector<std::vector<Hit>> buckets;
+        std::vector<uint8_t> flags;
+    };
+
+    // Smallest prime factors of first .. first + count - 1 into out, by the primes up to the
+    // square root in ascending order: the first prime to reach a number is its smallest
+    void fillSmallestFactors(const std::vector<uint32_t> &primes, uint64_t first, uint64_t count, uint32_t *out)
+    {
+        std::fill(out, out + count, 0);
+        uint64_t end = first + count;
+        for (uint64_t n = std::max<uint64_t>(first + (first & 1), 4); n < end; n += 2)
+            out[n - first] = 2;
+        for (uint32_t q : primes)
+        {
+            uint64_t square = static_cast<uint64_t>(q) * q;
+            if (square >= end)
+                break;
+            uint64_t multiple = square >= first ? square : (first + q - 1) / q * q;
+            if (!(multiple & 1))
+                multiple += q;
+            for (uint64_t n = multiple; n < end; n += 2 * static_cast<uint64_t>(q))
+            {
+                if (out[n - first] == 0)
+                    out[n - first] = q;
+            }
+        }
+    }
+}
+
+PrimeSieve::PrimeSieve(uint64_t limit) : maximum(limit)
+{
+    uint64_t root = floorSqrt(limit);
+    if (root <= (1u << 20))
+        primes = oddPrimesUpTo(root);
+    else
+    {
+        primes = primesUpTo(static_cast<uint32_t>(root));
+        primes.erase(primes.begin());
+    }
+}
+
+void PrimeSieve::forEachSegment(uint64_t first, uint64_t last, const PrimeSegmentBody &body) const
+{
+    if (first > last)
+        return;
+    uint64_t segments = (last - first) / sieveSegmentSpan + 1;
+    sharedThreadPool().parallelFor(0, segments, runSegments, [&](uint64_t begin, uint64_t end, unsigned worker)
+    {
+        TraceSpan span("sieve", "primes");
+        SegmentWalker walker(primes, first, last, begin, end);
+        std::vector<uint64_t> found;
+        for (uint64_t segment = begin; segment < end; ++segment)
+        {
+            walker.sieve(segment, found);
+            body(segment, found, worker);
+        }
+    });
+}
+
+void PrimeSieve::smallestFactors(uint64_t first, uint64_t count, std::vector<uint32_t> &factors) const
+{
+    factors.resize(count);
+    fillSmallestFactors(primes, first, count, factors.data());
+}
+
+std::vector<uint32_t> primesUpTo(uint32_t limit)
+{
+    if (limit <= (1u << 20))
+    {
+        std::vector<uint32_t> primes = oddPrimesUpTo(limit);
+        if (limit >= 2)
+            primes.insert(primes.begin(), 2);
+        return primes;
+    }
+    PrimeSieve sieve(limit);
+    uint64_t segments = limit / sieveSegmentSpan + 1;
+    std::vector<std::vector<uint32_t>> pieces(segments);
+    sieve.forEachSegment(0, limit, [&pieces](uint64_t segment, const std::vector<uint64_t> &found, unsigned)
+    {
+        pieces[segment].assign(found.begin(), found.end());
+    });
+    std::vector<uint32_t> primes;
+    for (const std::vector<uint32_t> &piece : pieces)
+        primes.insert(primes.end(), piece.begin(), piece.end());
+    return primes;
+}
+
+uint64_t countPrimes(uint64_t limit)
+{
+    PrimeSieve sieve(limit);
+    std::vector<uint64_t> counts(sharedThreadPool().size(), 0);
+    sieve.forEachSegment(0, limit, [&counts](uint64_t, const std::vector<uint64_t> &found, unsigned worker)
+    {
+        counts[worker] += found.size();
+    });
+    uint64_t total = 0;
+    for (uint64_t count : counts)
+        total += count;
+    return total;
+}
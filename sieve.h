@@ -0,0 +1,53 @@
+#ifndef SIEVE_H
+#define SIEVE_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Segmented sieve of Eratosthenes shared by every mode that needs primes or factor tables.
+// A segment holds one flag byte per odd number and fits in the L1 data cache; it starts as a
+// copy of the presieved wheel pattern for 3, 5, 7, 11 and 13, primes up to the segment width
+// then cross off their multiples directly, and larger primes, which hit a segment at most
+// once, wait in per-segment buckets until their next multiple comes round. Segments are
+// handed out to the shared thread pool in runs, so each worker carries its offsets and
+// buckets from one segment to the next instead of recomputing them.
+
+const uint64_t sieveSegmentSpan = 1 << 16; // Numbers per segment (32 KiB of odd flags)
+
+// Called once per segment with its index and its primes in ascending order. Segments arrive
+// in any order, from any worker; body must not call parallelFor on the shared pool.
+typedef std::function<void(uint64_t segment, const std::vector<uint64_t> &primes, unsigned worker)> PrimeSegmentBody;
+
+class PrimeSieve
+{
+public:
+    // Able to sieve any range below limit + 1; limit < 2^64
+    explicit PrimeSieve(uint64_t limit);
+
+    uint64_t limit() const { return maximum; }
+
+    // The odd primes up to sqrt(limit), ascending
+    const std::vector<uint32_t> &sievingPrimes() const { return primes; }
+
+    // Visit the primes of [first, last] (last <= limit) segment by segment: segment k covers
+    // first + k * sieveSegmentSpan up to the next segment or last
+    void forEachSegment(uint64_t first, uint64_t last, const PrimeSegmentBody &body) const;
+
+    // Smallest prime factor of every n in [first, first + count), first + count - 1 <= limit:
+    // factors[i] for first + i, 0 when that number is prime or below 2
+    void smallestFactors(uint64_t first, uint64_t count, std::vector<uint32_t> &factors) const;
+
+private:
+    uint64_t maximum;
+    std::vector<uint32_t> primes;
+};
+
+// Every prime up to limit, ascending. Limits up to 2^20 are sieved on the calling thread,
+// so this is safe inside a parallelFor body; larger ones use the shared pool.
+std::vector<uint32_t> primesUpTo(uint32_t limit);
+
+// Number of primes <= limit, for --prime-count
+uint64_t countPrimes(uint64_t limit);
+
+#endif
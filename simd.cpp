@@ -0,0 +1,522 @@
+#include "simd.h"
+#include "stats.h"
+
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SH_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    SimdLevel levelLimit = SIMD_AVX512;
+
+    // Lane bookkeeping shared by the vector kernels: which base each lane is stepping and
+    // the global step at which it started. A lane that runs out of bases parks on zero,
+    // which never equals the Montgomery one for modulus >= 3.
+    struct LaneState
+    {
+        const uint32_t *bases;
+        size_t count;
+        size_t next = 0;
+        uint64_t *orders;
+        const Montgomery32 &mont;
+
+        LaneState(const Montgomery32 &mont, const uint32_t *bases, size_t count, uint64_t *orders)
+            : bases(bases), count(count), orders(orders), mont(mont)
+        {
+        }
+
+        // Load the next base into a lane; returns false (and parks the lane) when none remain.
+        // Bases congruent to 1 are answered here, since a reloaded lane is only compared
+        // again after one more multiplication.
+        bool refill(uint32_t &value, uint32_t &multiplier, size_t &owner, uint64_t &start, uint64_t step)
+        {
+            while (next < count)
+            {
+                owner = next++;
+                multiplier = mont.convertIn(bases[owner]);
+                if (multiplier == mont.one)
+                {
+                    orders[owner] = 1;
+                    continue;
+                }
+                value = multiplier;
+                start = step;
+                return true;
+            }
+            value = 0;
+            multiplier = 0;
+            owner = count;
+            return false;
+        }
+    };
+
+    // Per-lane constants for one group of powEqualsOneAcrossModuli queries. Lanes past the
+    // end of the input compute 1^0 mod 3 and are ignored.
+    struct LaneGroup
+    {
+        alignas(64) uint32_t modulus[16];
+        alignas(64) uint32_t inverse[16];
+        alignas(64) uint32_t one[16];
+        alignas(64) uint32_t base[16];
+        alignas(64) uint32_t exponent[16];
+        uint32_t exponentBits = 0; // OR of all exponents
+
+        void load(const uint32_t *bases, const uint32_t *moduli, const uint32_t *exponents, size_t first, size_t count, int lanes)
+        {
+            exponentBits = 0;
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                size_t i = first + lane;
+                Montgomery32 mont(i < count ? moduli[i] : 3);
+                modulus[lane] = mont.modulus;
+                inverse[lane] = mont.inverse;
+                one[lane] = mont.one;
+                base[lane] = mont.convertIn(i < count ? bases[i] : 1);
+                exponent[lane] = i < count ? exponents[i] : 0;
+                exponentBits |= exponent[lane];
+            }
+        }
+
+        int bitLength() const { return exponentBits ? 32 - __builtin_clz(exponentBits) : 0; }
+    };
+
+#ifdef SH_X86_KERNELS
+    // Montgomery product of eight 32-bit lanes: six 32x32->64 multiplies, even and odd
+    // lanes handled separately and blended back together. modulus and inverse may differ per
+    // lane; the odd-lane shifts are loop invariants once inlined.
+    __attribute__((target("avx2"))) inline __m256i montMultiplyAvx2(__m256i a, __m256i b, __m256i modulus, __m256i inverse)
+    {
+        __m256i productEven = _mm256_mul_epu32(a, b);
+        __m256i productOdd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+        __m256i mEven = _mm256_mul_epu32(productEven, inverse);
+        __m256i mOdd = _mm256_mul_epu32(productOdd, _mm256_srli_epi64(inverse, 32));
+        __m256i correctionEven = _mm256_mul_epu32(mEven, modulus);
+        __m256i correctionOdd = _mm256_mul_epu32(mOdd, _mm256_srli_epi64(modulus, 32));
+
+        __m256i high = _mm256_blend_epi32(_mm256_srli_epi64(productEven, 32), productOdd, 0xAA);
+        __m256i correction = _mm256_blend_epi32(_mm256_srli_epi64(correctionEven, 32), correctionOdd, 0xAA);
+        __m256i result = _mm256_sub_epi32(high, correction);
+        __m256i noBorrow = _mm256_cmpeq_epi32(_mm256_max_epu32(high, correction), high);
+        return _mm256_add_epi32(result, _mm256_andnot_si256(noBorrow, modulus));
+    }
+
+    __attribute__((target("avx2"))) void unitOrdersAvx2(const Montgomery32 &mont, const uint32_t *bases, size_t count, uint64_t *orders)
+    {
+        const int lanes = 8;
+        LaneState state(mont, bases, count, orders);
+        alignas(32) uint32_t values[lanes], multipliers[lanes];
+        size_t owners[lanes];
+        uint64_t starts[lanes] = {};
+        int active = 0;
+        for (int lane = 0; lane < lanes; ++lane)
+            active += state.refill(values[lane], multipliers[lane], owners[lane], starts[lane], 0);
+
+        const __m256i modulus = _mm256_set1_epi32(static_cast<int>(mont.modulus));
+        const __m256i inverse = _mm256_set1_epi32(static_cast<int>(mont.inverse));
+        const __m256i one = _mm256_set1_epi32(static_cast<int>(mont.one));
+        __m256i value = _mm256_load_si256(reinterpret_cast<const __m256i *>(values));
+        __m256i multiplier = _mm256_load_si256(reinterpret_cast<const __m256i *>(multipliers));
+
+        uint64_t step = 0;
+        uint64_t laneSteps = 0;
+        while (active > 0)
+        {
+            int hits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(value, one)));
+            if (hits)
+            {
+                // Rare: record finished lanes and reload them with fresh bases
+                _mm256_store_si256(reinterpret_cast<__m256i *>(values), value);
+                _mm256_store_si256(reinterpret_cast<__m256i *>(multipliers), multiplier);
+                for (int lane = 0; lane < lanes; ++lane)
+                {
+                    if (hits & (1 << lane))
+                    {
+                        orders[owners[lane]] = step - starts[lane] + 1;
+                        active -= !state.refill(values[lane], multipliers[lane], owners[lane], starts[lane], step);
+                    }
+                }
+                value = _mm256_load_si256(reinterpret_cast<const __m256i *>(values));
+                multiplier = _mm256_load_si256(reinterpret_cast<const __m256i *>(multipliers));
+                if (active == 0)
+                    break;
+            }
+            value = montMultiplyAvx2(value, multiplier, modulus, inverse);
+            ++step;
+            laneSteps += lanes;
+        }
+        statAdd(STAT_MOD_MULS, laneSteps);
+        statAdd(STAT_REDUCTIONS, laneSteps);
+    }
+
+    // Left-to-right square-and-multiply in eight lanes; a lane only keeps the multiplied
+    // value where its own exponent has the current bit set
+    __attribute__((target("avx2"))) void powEqualsOneAvx2(const uint32_t *bases, const uint32_t *moduli, const uint32_t *exponents,
+                                                          size_t count, uint8_t *results)
+    {
+        const int lanes = 8;
+        LaneGroup group;
+        uint64_t laneSteps = 0;
+        for (size_t first = 0; first < count; first += lanes)
+        {
+            group.load(bases, moduli, exponents, first, count, lanes);
+            const __m256i modulus = _mm256_load_si256(reinterpret_cast<const __m256i *>(group.modulus));
+            const __m256i inverse = _mm256_load_si256(reinterpret_cast<const __m256i *>(group.inverse));
+            const __m256i one = _mm256_load_si256(reinterpret_cast<const __m256i *>(group.one));
+            const __m256i base = _mm256_load_si256(reinterpret_cast<const __m256i *>(group.base));
+            const __m256i exponent = _mm256_load_si256(reinterpret_cast<const __m256i *>(group.exponent));
+
+            __m256i value = one;
+            for (int bit = group.bitLength() - 1; bit >= 0; --bit)
+            {
+                const __m256i mask = _mm256_set1_epi32(static_cast<int>(1u << bit));
+                value = montMultiplyAvx2(value, value, modulus, inverse);
+                __m256i product = montMultiplyAvx2(value, base, modulus, inverse);
+                __m256i set = _mm256_cmpeq_epi32(_mm256_and_si256(exponent, mask), mask);
+                value = _mm256_blendv_epi8(value, product, set);
+            }
+            laneSteps += 2 * group.bitLength() * lanes;
+
+            int hits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(value, one)));
+            for (int lane = 0; lane < lanes && first + lane < count; ++lane)
+                results[first + lane] = (hits >> lane) & 1;
+        }
+        statAdd(STAT_MOD_MULS, laneSteps);
+        statAdd(STAT_REDUCTIONS, laneSteps);
+    }
+
+    // Montgomery forms of start * multiplier^lane in values and of multiplier^lanes in stride
+    void loadPowerRun(const Montgomery32 &mont, uint32_t start, uint32_t multiplier, int lanes, uint32_t *values, uint32_t &stride)
+    {
+        uint32_t step = mont.convertIn(multiplier);
+        uint32_t value = mont.convertIn(start);
+        stride = mont.one;
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            values[lane] = value;
+            value = mont.multiply(value, step);
+            stride = mont.multiply(stride, step);
+        }
+    }
+
+    // Multiplying by a plain 1 leaves Montgomery form, so the output conversion is one more
+    // vector product
+    __attribute__((target("avx2"))) void powerRunAvx2(const Montgomery32 &mont, uint32_t start, uint32_t multiplier, uint32_t *terms, size_t count)
+    {
+        const int lanes = 8;
+        alignas(32) uint32_t values[lanes];
+        uint32_t strideValue;
+        loadPowerRun(mont, start, multiplier, lanes, values, strideValue);
+
+        const __m256i modulus = _mm256_set1_epi32(static_cast<int>(mont.modulus));
+        const __m256i inverse = _mm256_set1_epi32(static_cast<int>(mont.inverse));
+        const __m256i plainOne = _mm256_set1_epi32(1);
+        const __m256i stride = _mm256_set1_epi32(static_cast<int>(strideValue));
+        __m256i value = _mm256_load_si256(reinterpret_cast<const __m256i *>(values));
+        size_t i = 0;
+        for (; i + lanes <= count; i += lanes)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(terms + i), montMultiplyAvx2(value, plainOne, modulus, inverse));
+            value = montMultiplyAvx2(value, stride, modulus, inverse);
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i *>(values), value);
+        for (int lane = 0; i < count; ++i, ++lane)
+            terms[i] = mont.convertOut(values[lane]);
+        statAdd(STAT_MOD_MULS, count);
+        statAdd(STAT_REDUCTIONS, 2 * count);
+    }
+
+    // Sixteen-lane version; the unsigned compare yields the borrow mask directly. The
+    // zero-masked forms avoid GCC's spurious uninitialized warnings on the plain intrinsics.
+    __attribute__((target("avx512f"))) inline __m512i montMultiplyAvx512(__m512i a, __m512i b, __m512i modulus, __m512i inverse)
+    {
+        const __mmask8 all = 0xFF;
+        __m512i productEven = _mm512_maskz_mul_epu32(all, a, b);
+        __m512i productOdd = _mm512_maskz_mul_epu32(all, _mm512_maskz_srli_epi64(all, a, 32), _mm512_maskz_srli_epi64(all, b, 32));
+        __m512i mEven = _mm512_maskz_mul_epu32(all, productEven, inverse);
+        __m512i mOdd = _mm512_maskz_mul_epu32(all, productOdd, _mm512_maskz_srli_epi64(all, inverse, 32));
+        __m512i correctionEven = _mm512_maskz_mul_epu32(all, mEven, modulus);
+        __m512i correctionOdd = _mm512_maskz_mul_epu32(all, mOdd, _mm512_maskz_srli_epi64(all, modulus, 32));
+
+        __m512i high = _mm512_mask_blend_epi32(0xAAAA, _mm512_maskz_srli_epi64(all, productEven, 32), productOdd);
+        __m512i correction = _mm512_mask_blend_epi32(0xAAAA, _mm512_maskz_srli_epi64(all, correctionEven, 32), correctionOdd);
+        __m512i result = _mm512_sub_epi32(high, correction);
+        __mmask16 borrow = _mm512_cmp_epu32_mask(high, correction, _MM_CMPINT_LT);
+        return _mm512_mask_add_epi32(result, borrow, result, modulus);
+    }
+
+    __attribute__((target("avx512f"))) void unitOrdersAvx512(const Montgomery32 &mont, const uint32_t *bases, size_t count, uint64_t *orders)
+    {
+        const int lanes = 16;
+        LaneState state(mont, bases, count, orders);
+        alignas(64) uint32_t values[lanes], multipliers[lanes];
+        size_t owners[lanes];
+        uint64_t starts[lanes] = {};
+        int active = 0;
+        for (int lane = 0; lane < lanes; ++lane)
+            active += state.refill(values[lane], multipliers[lane], owners[lane], starts[lane], 0);
+
+        const __m512i modulus = _mm512_set1_epi32(static_cast<int>(mont.modulus));
+        const __m512i inverse = _mm512_set1_epi32(static_cast<int>(mont.inverse));
+        const __m512i one = _mm512_set1_epi32(static_cast<int>(mont.one));
+        __m512i value = _mm512_load_si512(values);
+        __m512i multiplier = _mm512_load_si512(multipliers);
+
+        uint64_t step = 0;
+        uint64_t laneSteps = 0;
+        while (active > 0)
+        {
+            __mmask16 hits = _mm512_cmpeq_epi32_mask(value, one);
+            if (hits)
+            {
+                _mm512_store_si512(values, value);
+                _mm512_store_si512(multipliers, multiplier);
+                for (int lane = 0; lane < lanes; ++lane)
+                {
+                    if (hits & (1 << lane))
+                    {
+                        orders[owners[lane]] = step - starts[lane] + 1;
+                        active -= !state.refill(values[lane], multipliers[lane], owners[lane], starts[lane], step);
+                    }
+                }
+                value = _mm512_load_si512(values);
+                multiplier = _mm512_load_si512(multipliers);
+                if (active == 0)
+                    break;
+            }
+            value = montMultiplyAvx512(value, multiplier, modulus, inverse);
+            ++step;
+            laneSteps += lanes;
+        }
+        statAdd(STAT_MOD_MULS, laneSteps);
+        statAdd(STAT_REDUCTIONS, laneSteps);
+    }
+
+    __attribute__((target("avx512f"))) void powEqualsOneAvx512(const uint32_t *bases, const uint32_t *moduli, const uint32_t *exponents,
+                                                               size_t count, uint8_t *results)
+    {
+        const int lanes = 16;
+        LaneGroup group;
+        uint64_t laneSteps = 0;
+        for (size_t first = 0; first < count; first += lanes)
+        {
+            group.load(bases, moduli, exponents, first, count, lanes);
+            const __m512i modulus = _mm512_load_si512(group.modulus);
+            const __m512i inverse = _mm512_load_si512(group.inverse);
+            const __m512i one = _mm512_load_si512(group.one);
+            const __m512i base = _mm512_load_si512(group.base);
+            const __m512i exponent = _mm512_load_si512(group.exponent);
+
+            __m512i value = one;
+            for (int bit = group.bitLength() - 1; bit >= 0; --bit)
+            {
+                value = montMultiplyAvx512(value, value, modulus, inverse);
+                __m512i product = montMultiplyAvx512(value, base, modulus, inverse);
+                __mmask16 set = _mm512_test_epi32_mask(exponent, _mm512_set1_epi32(static_cast<int>(1u << bit)));
+                value = _mm512_mask_mov_epi32(value, set, product);
+            }
+            laneSteps += 2 * group.bitLength() * lanes;
+
+            __mmask16 hits = _mm512_cmpeq_epi32_mask(value, one);
+            for (int lane = 0; lane < lanes && first + lane < count; ++lane)
+                results[first + lane] = (hits >> lane) & 1;
+        }
+        statAdd(STAT_MOD_MULS, laneSteps);
+        statAdd(STAT_REDUCTIONS, laneSteps);
+    }
+
+    __attribute__((target("avx512f"))) void powerRunAvx512(const Montgomery32 &mont, uint32_t start, uint32_t multiplier, uint32_t *terms,
+                                                           size_t count)
+    {
+        const int lanes = 16;
+        alignas(64) uint32_t values[lanes];
+        uint32_t strideValue;
+        loadPowerRun(mont, start, multiplier, lanes, values, strideValue);
+
+        const __m512i modulus = _mm512_set1_epi32(static_cast<int>(mont.modulus));
+        const __m512i inverse = _mm512_set1_epi32(static_cast<int>(mont.inverse));
+        const __m512i plainOne = _mm512_set1_epi32(1);
+        const __m512i stride = _mm512_set1_epi32(static_cast<int>(strideValue));
+        __m512i value = _mm512_load_si512(values);
+        size_t i = 0;
+        for (; i + lanes <= count; i += lanes)
+        {
+            _mm512_storeu_si512(terms + i, montMultiplyAvx512(value, plainOne, modulus, inverse));
+            value = montMultiplyAvx512(value, stride, modulus, inverse);
+        }
+        _mm512_store_si512(values, value);
+        for (int lane = 0; i < count; ++i, ++lane)
+            terms[i] = mont.convertOut(values[lane]);
+        statAdd(STAT_MOD_MULS, count);
+        statAdd(STAT_REDUCTIONS, 2 * count);
+    }
+#endif
+
+    void powerRunScalar(const Montgomery32 &mont, uint32_t start, uint32_t multiplier, uint32_t *terms, size_t count)
+    {
+        uint32_t step = mont.convertIn(multiplier);
+        uint32_t value = mont.convertIn(start);
+        for (size_t i = 0; i < count; ++i)
+        {
+            terms[i] = mont.convertOut(value);
+            value = mont.multiply(value, step);
+        }
+        statAdd(STAT_MOD_MULS, count);
+        statAdd(STAT_REDUCTIONS, 2 * count);
+    }
+
+    void powEqualsOneScalar(const uint32_t *bases, const uint32_t *moduli, const uint32_t *exponents, size_t count, uint8_t *results)
+    {
+        uint64_t steps = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            Montgomery32 mont(moduli[i]);
+            uint32_t base = mont.convertIn(bases[i]);
+            uint32_t value = mont.one;
+            for (int bit = exponents[i] ? 31 - __builtin_clz(exponents[i]) : -1; bit >= 0; --bit)
+            {
+                value = mont.multiply(value, value);
+                if (exponents[i] & (1u << bit))
+                    value = mont.multiply(value, base);
+                steps += 2;
+            }
+            results[i] = value == mont.one;
+        }
+        statAdd(STAT_MOD_MULS, steps);
+        statAdd(STAT_REDUCTIONS, steps);
+    }
+
+    void unitOrdersScalar(const Montgomery32 &mont, const uint32_t *bases, size_t count, uint64_t *orders)
+    {
+        uint64_t steps = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t multiplier = mont.convertIn(bases[i]);
+            uint32_t value = multiplier;
+            uint64_t order = 1;
+            while (value != mont.one)
+            {
+                value = mont.multiply(value, multiplier);
+                ++order;
+            }
+            orders[i] = order;
+            steps += order;
+        }
+        statAdd(STAT_MOD_MULS, steps);
+        statAdd(STAT_REDUCTIONS, steps);
+    }
+}
+
+SimdLevel detectSimdLevel()
+{
+#ifdef SH_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+#endif
+    return SIMD_SCALAR;
+}
+
+const char *simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SIMD_AVX512:
+        return "avx512";
+    case SIMD_AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+SimdLevel activeSimdLevel()
+{
+    static SimdLevel detected = detectSimdLevel();
+    return detected < levelLimit ? detected : levelLimit;
+}
+
+void setSimdLevelLimit(SimdLevel limit)
+{
+    levelLimit = limit;
+}
+
+bool parseSimdLevel(const char *text, SimdLevel &level)
+{
+    for (SimdLevel candidate : {SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512})
+    {
+        if (std::strcmp(text, simdLevelName(candidate)) == 0)
+        {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Dispatch to the widest kernel allowed by level
+void unitOrdersFixedModulus(uint32_t modulus, const uint32_t *bases, size_t count, uint64_t *orders, SimdLevel level)
+{
+    Montgomery32 mont(modulus);
+#ifdef SH_X86_KERNELS
+    if (level >= SIMD_AVX512 && activeSimdLevel() >= SIMD_AVX512)
+    {
+        unitOrdersAvx512(mont, bases, count, orders);
+        return;
+    }
+    if (level >= SIMD_AVX2 && activeSimdLevel() >= SIMD_AVX2)
+    {
+        unitOrdersAvx2(mont, bases, count, orders);
+        return;
+    }
+#else
+    (void)level;
+#endif
+    unitOrdersScalar(mont, bases, count, orders);
+}
+
+// Dispatch to the widest kernel allowed by level
+void powEqualsOneAcrossModuli(const uint32_t *bases, const uint32_t *moduli, const uint32_t *exponents, size_t count,
+                              uint8_t *results, SimdLevel level)
+{
+#ifdef SH_X86_KERNELS
+    if (level >= SIMD_AVX512 && activeSimdLevel() >= SIMD_AVX512)
+    {
+        powEqualsOneAvx512(bases, moduli, exponents, count, results);
+        return;
+    }
+    if (level >= SIMD_AVX2 && activeSimdLevel() >= SIMD_AVX2)
+    {
+        powEqualsOneAvx2(bases, moduli, exponents, count, results);
+        return;
+    }
+#else
+    (void)level;
+#endif
+    powEqualsOneScalar(bases, moduli, exponents, count, results);
+}
+
+// Dispatch to the widest kernel allowed by level
+void powerRunFixedModulus(uint32_t modulus, uint32_t start, uint32_t multiplier, uint32_t *terms, size_t count, SimdLevel level)
+{
+    Montgomery32 mont(modulus);
+#ifdef SH_X86_KERNELS
+    if (level >= SIMD_AVX512 && activeSimdLevel() >= SIMD_AVX512)
+    {
+        powerRunAvx512(mont, start, multiplier, terms, count);
+        return;
+    }
+    if (level >= SIMD_AVX2 && activeSimdLevel() >= SIMD_AVX2)
+    {
+        powerRunAvx2(mont, start, multiplier, terms, count);
+        return;
+    }
+#else
+    (void)level;
+#endif
+    powerRunScalar(mont, start, multiplier, terms, count);
+}
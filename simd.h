@@ -0,0 +1,44 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+#include "modarith.h"
+
+// Vectorized Montgomery kernels for moduli below 2^32, with runtime CPU dispatch.
+// Each 32-bit lane holds an independent running value; one Montgomery multiplication
+// advances 8 (AVX2) or 16 (AVX-512) sequences. Builds for other targets keep only the
+// scalar kernels.
+
+enum SimdLevel
+{
+    SIMD_SCALAR,
+    SIMD_AVX2,
+    SIMD_AVX512
+};
+
+SimdLevel detectSimdLevel();
+const char *simdLevelName(SimdLevel level);
+
+// Best level this CPU supports, lowered by setSimdLevelLimit() (e.g. from --simd=)
+SimdLevel activeSimdLevel();
+void setSimdLevelLimit(SimdLevel limit);
+bool parseSimdLevel(const char *text, SimdLevel &level);
+
+// Lane-per-modulus check of bases[i]^exponents[i] == 1 (mod moduli[i]). Each lane carries
+// its own Montgomery constants, so 8 or 16 different odd moduli in [3, 2^32) are verified
+// at once. Bases must already be reduced; results[i] is 1 when the congruence holds.
+void powEqualsOneAcrossModuli(const uint32_t *bases, const uint32_t *moduli, const uint32_t *exponents, size_t count,
+                              uint8_t *results, SimdLevel level);
+
+// Multiplicative orders of bases[i] modulo an odd modulus in [3, 2^32). Every base must
+// already be reduced and coprime to the modulus.
+void unitOrdersFixedModulus(uint32_t modulus, const uint32_t *bases, size_t count, uint64_t *orders, SimdLevel level);
+
+// terms[i] = start * multiplier^i (mod modulus) for i < count, for an odd modulus in
+// [3, 2^32) with start and multiplier already reduced. Lane j produces terms j, j + 8, ...
+// (j + 16 for AVX-512) by multiplying with multiplier^8, so the otherwise serial chain
+// advances a whole vector per Montgomery multiplication.
+void powerRunFixedModulus(uint32_t modulus, uint32_t start, uint32_t multiplier, uint32_t *terms, size_t count, SimdLevel level);
+
+#endif
@@ -0,0 +1,368 @@
+#include "sonify.h"
+#include "engine.h"
+#include "metrics.h"
+#include "modarith.h"
+#include "simd.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SH_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const unsigned maxPartials = 16;
+    const size_t chunkSamples = 16;      // Samples per oscillator step; block and note lengths are multiples of it
+    const size_t blockSamples = 4096;    // Samples synthesized before the envelope and conversion pass
+    const size_t termBatch = 4096;       // Terms stepped at a time
+    const size_t outputBufferBytes = 1 << 20;
+    const double lowestHz = 110.0;
+    const double octaves = 4.0;
+    const double pi = 3.14159265358979323846;
+
+    MetricCounter &termsMetric = metricCounter("sh_terms", "Sequence terms produced.");
+
+    // One sinusoid as a unit phasor z advanced by rotations: sample j of a chunk is
+    // Im(z * w^j), then z moves on by w^16. The powers are float so a whole chunk is one
+    // vector multiply-add; z stays in double and is renormalized every block.
+    struct Partial
+    {
+        alignas(64) float powerRe[chunkSamples];
+        alignas(64) float powerIm[chunkSamples];
+        double stepRe = 1, stepIm = 0;
+        double zRe = 1, zIm = 0;
+        float amplitude = 0;
+
+        void setFrequency(double hz, uint32_t sampleRate, float gain)
+        {
+            if (hz >= 0.45 * sampleRate) // Drop partials near Nyquist instead of aliasing them
+            {
+                amplitude = 0;
+                return;
+            }
+            amplitude = gain;
+            double theta = 2 * pi * hz / sampleRate;
+            double wRe = std::cos(theta), wIm = std::sin(theta), re = 1, im = 0;
+            for (size_t j = 0; j < chunkSamples; ++j)
+            {
+                powerRe[j] = static_cast<float>(re);
+                powerIm[j] = static_cast<float>(im);
+                double next = re * wRe - im * wIm;
+                im = re * wIm + im * wRe;
+                re = next;
+            }
+            stepRe = re;
+            stepIm = im;
+        }
+
+        void advance()
+        {
+            double next = zRe * stepRe - zIm * stepIm;
+            zIm = zRe * stepIm + zIm * stepRe;
+            zRe = next;
+        }
+
+        void renormalize()
+        {
+            double scale = 1.0 / std::sqrt(zRe * zRe + zIm * zIm);
+            zRe *= scale;
+            zIm *= scale;
+        }
+    };
+
+    void addPartialScalar(Partial &partial, float *out, size_t count)
+    {
+        for (size_t i = 0; i < count; i += chunkSamples)
+        {
+            float zRe = static_cast<float>(partial.zRe), zIm = static_cast<float>(partial.zIm);
+            for (size_t j = 0; j < chunkSamples; ++j)
+                out[i + j] += partial.amplitude * (zRe * partial.powerIm[j] + zIm * partial.powerRe[j]);
+            partial.advance();
+        }
+    }
+
+#ifdef SH_X86_KERNELS
+    __attribute__((target("avx2"))) void addPartialAvx2(Partial &partial, float *out, size_t count)
+    {
+        __m256 amplitude = _mm256_set1_ps(partial.amplitude);
+        __m256 re0 = _mm256_load_ps(partial.powerRe), re1 = _mm256_load_ps(partial.powerRe + 8);
+        __m256 im0 = _mm256_load_ps(partial.powerIm), im1 = _mm256_load_ps(partial.powerIm + 8);
+        for (size_t i = 0; i < count; i += chunkSamples)
+        {
+            __m256 zRe = _mm256_set1_ps(static_cast<float>(partial.zRe)), zIm = _mm256_set1_ps(static_cast<float>(partial.zIm));
+            __m256 s0 = _mm256_add_ps(_mm256_mul_ps(zRe, im0), _mm256_mul_ps(zIm, re0));
+            __m256 s1 = _mm256_add_ps(_mm256_mul_ps(zRe, im1), _mm256_mul_ps(zIm, re1));
+            _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(amplitude, s0)));
+            _mm256_storeu_ps(out + i + 8, _mm256_add_ps(_mm256_loadu_ps(out + i + 8), _mm256_mul_ps(amplitude, s1)));
+            partial.advance();
+        }
+    }
+
+    __attribute__((target("avx512f"))) void addPartialAvx512(Partial &partial, float *out, size_t count)
+    {
+        __m512 amplitude = _mm512_set1_ps(partial.amplitude);
+        __m512 re = _mm512_load_ps(partial.powerRe), im = _mm512_load_ps(partial.powerIm);
+        for (size_t i = 0; i < count; i += chunkSamples)
+        {
+            __m512 zRe = _mm512_set1_ps(static_cast<float>(partial.zRe)), zIm = _mm512_set1_ps(static_cast<float>(partial.zIm));
+            __m512 sample = _mm512_fmadd_ps(zRe, im, _mm512_mul_ps(zIm, re));
+            _mm512_storeu_ps(out + i, _mm512_fmadd_ps(amplitude, sample, _mm512_loadu_ps(out + i)));
+            partial.advance();
+        }
+    }
+#endif
+
+    typedef void (*PartialKernel)(Partial &, float *, size_t);
+
+    PartialKernel choosePartialKernel()
+    {
+#ifdef SH_X86_KERNELS
+        if (activeSimdLevel() >= SIMD_AVX512)
+            return addPartialAvx512;
+        if (activeSimdLevel() >= SIMD_AVX2)
+            return addPartialAvx2;
+#endif
+        return addPartialScalar;
+    }
+
+    void appendU16(std::string &out, uint16_t value)
+    {
+        out += static_cast<char>(value & 0xFF);
+        out += static_cast<char>(value >> 8);
+    }
+
+    void appendU32(std::string &out, uint32_t value)
+    {
+        appendU16(out, static_cast<uint16_t>(value));
+        appendU16(out, static_cast<uint16_t>(value >> 16));
+    }
+
+    // Canonical 44-byte header of a 16-bit mono PCM file
+    std::string wavHeader(uint32_t sampleRate, uint32_t dataBytes)
+    {
+        std::string header = "RIFF";
+        appendU32(header, 36 + dataBytes);
+        header += "WAVEfmt ";
+        appendU32(header, 16);
+        appendU16(header, 1); // PCM
+        appendU16(header, 1); // Mono
+        appendU32(header, sampleRate);
+        appendU32(header, sampleRate * 2);
+        appendU16(header, 2);
+        appendU16(header, 16);
+        header += "data";
+        appendU32(header, dataBytes);
+        return header;
+    }
+
+    // Oscillator bank, note envelope and sample output for a whole render
+    class Synthesizer
+    {
+    public:
+        Synthesizer(const SonifyOptions &options, size_t noteSamples, std::ofstream &file)
+            : options(options), noteSamples(noteSamples), file(file), kernel(choosePartialKernel()), partials(options.partials),
+              block(blockSamples), envelope(noteSamples)
+        {
+            double harmonic = 0;
+            for (unsigned k = 1; k <= options.partials; ++k)
+                harmonic += 1.0 / k;
+            gain = static_cast<float>(0.8 / harmonic);
+
+            // Raised-cosine fade in and out (5 ms, or a quarter of a short note) against clicks
+            size_t fade = std::max<size_t>(1, std::min<size_t>(noteSamples / 4, options.sampleRate / 200));
+            for (size_t i = 0; i < noteSamples; ++i)
+            {
+                size_t edge = std::min(i, noteSamples - 1 - i);
+                envelope[i] = edge >= fade ? 1.0f : static_cast<float>(0.5 - 0.5 * std::cos(pi * (edge + 0.5) / fade));
+            }
+            buffer.reserve(outputBufferBytes + blockSamples * 2);
+        }
+
+        // One note per scaled term in [0, 1)
+        bool playNotes(const float *terms, size_t count)
+        {
+            TraceSpan span("synthesize", "audio");
+            for (size_t t = 0; t < count; ++t)
+            {
+                double hz = lowestHz * std::exp2(octaves * terms[t]);
+                for (unsigned k = 0; k < options.partials; ++k)
+                    partials[k].setFrequency(hz * (k + 1), options.sampleRate, gain / (k + 1));
+
+                for (size_t offset = 0; offset < noteSamples; offset += blockSamples)
+                {
+                    size_t length = std::min(blockSamples, noteSamples - offset);
+                    std::fill(block.begin(), block.begin() + length, 0.0f);
+                    for (Partial &partial : partials)
+                    {
+                        if (partial.amplitude != 0)
+                        {
+                            kernel(partial, block.data(), length);
+                            partial.renormalize();
+                        }
+                    }
+                    size_t start = buffer.size();
+                    buffer.resize(start + length * 2);
+                    char *out = &buffer[start];
+                    for (size_t i = 0; i < length; ++i)
+                    {
+                        float sample = std::min(std::max(block[i] * envelope[offset + i], -1.0f), 1.0f);
+                        uint16_t pcm = static_cast<uint16_t>(static_cast<int16_t>(std::lrint(sample * 32767.0f)));
+                        out[2 * i] = static_cast<char>(pcm & 0xFF);
+                        out[2 * i + 1] = static_cast<char>(pcm >> 8);
+                    }
+                    if (buffer.size() >= outputBufferBytes && !flush())
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        bool flush()
+        {
+            TraceSpan span("write", "io");
+            file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            statAdd(STAT_BYTES_WRITTEN, buffer.size());
+            buffer.clear();
+            return static_cast<bool>(file);
+        }
+
+    private:
+        const SonifyOptions &options;
+        size_t noteSamples;
+        std::ofstream &file;
+        PartialKernel kernel;
+        std::vector<Partial> partials;
+        std::vector<float> block;
+        std::vector<float> envelope;
+        std::string buffer;
+        float gain = 1;
+    };
+
+    // Scaled terms of a multi-limb sequence; Reducer is BarrettMpz or GmpReducer. Values drop
+    // their low bits before the division so the quotient fits a double.
+    template <class Reducer>
+    void stepTermsMpz(Reducer &reducer, mpz_class &value, const mpz_class &step, size_t shift, double divisor, float *terms, size_t count)
+    {
+        mpz_class scaled;
+        for (size_t i = 0; i < count; ++i)
+        {
+            mpz_fdiv_q_2exp(scaled.get_mpz_t(), value.get_mpz_t(), shift);
+            terms[i] = static_cast<float>(scaled.get_d() / divisor);
+            reducer.multiply(value, value, step);
+        }
+    }
+}
+
+// Terms are stepped with the kernel the cost model picks, in batches that are synthesized
+// before the next batch is stepped
+int runSonify(const SonifyOptions &options)
+{
+    if (options.partials == 0 || options.partials > maxPartials || options.sampleRate < 8000 || options.sampleRate > 192000 ||
+        options.noteMicros == 0)
+    {
+        std::cout << "\033[31mInvalid audio settings (1 to " << maxPartials << " partials, 8000 to 192000 Hz).\033[0m\n";
+        return 1;
+    }
+
+    SequenceShape shape;
+    {
+        TraceSpan span("order", "sequence");
+        shape = computeSequenceShape(options.base, options.modulo);
+    }
+    uint64_t total = shape.tail + shape.period;
+    size_t noteSamples = static_cast<size_t>(static_cast<double>(options.sampleRate) * options.noteMicros / 1e6 / chunkSamples + 0.5) * chunkSamples;
+    noteSamples = std::max(noteSamples, chunkSamples);
+    double dataBytes = static_cast<double>(total) * noteSamples * 2;
+    if (dataBytes > 4294967295.0 - 36)
+    {
+        std::cout << "\033[31mThe render would exceed the 4 GiB WAV limit (" << total << " terms); use shorter notes.\033[0m\n";
+        return 1;
+    }
+
+    std::ofstream file(options.outputPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cout << "\033[31mCannot open output file " << options.outputPath << ".\033[0m\n";
+        return 1;
+    }
+    std::string header = wavHeader(options.sampleRate, static_cast<uint32_t>(dataBytes));
+    file.write(header.data(), header.size());
+
+    auto started = std::chrono::steady_clock::now();
+    Synthesizer synthesizer(options, noteSamples, file);
+    std::vector<float> terms(termBatch);
+    mpz_class step = options.base % options.modulo;
+    if (step < 0)
+        step += options.modulo;
+
+    size_t bits = mpz_sizeinbase(options.modulo.get_mpz_t(), 2);
+    ReductionKernel kernel = chooseReduction(bits, mpz_odd_p(options.modulo.get_mpz_t()), total);
+    bool small = bits <= 64;
+    uint64_t modulo64 = small ? mpzToUint64(options.modulo) : 0;
+    uint64_t value64 = small ? mpzToUint64(step) : 0;
+    size_t shift = bits > 53 ? bits - 53 : 0;
+    mpz_class divisorScaled = options.modulo >> shift;
+    double divisor = divisorScaled.get_d();
+    mpz_class value = step;
+    BarrettMpz barrett(small ? mpz_class(3) : options.modulo);
+    GmpReducer gmp(options.modulo);
+
+    for (uint64_t done = 0; done < total;)
+    {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(termBatch, total - done));
+        {
+            TraceSpan span("chunk", "sequence");
+            if (small && modulo64 == 1)
+                std::fill(terms.begin(), terms.begin() + count, 0.0f);
+            else if (small)
+            {
+                withReduction64(modulo64, kernel, [&](const auto &arithmetic)
+                {
+                    auto current = arithmetic.convertIn(value64);
+                    auto multiplier = arithmetic.convertIn(mpzToUint64(step));
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        terms[i] = static_cast<float>(static_cast<double>(arithmetic.convertOut(current)) / static_cast<double>(modulo64));
+                        current = arithmetic.multiply(current, multiplier);
+                    }
+                    value64 = arithmetic.convertOut(current);
+                });
+            }
+            else if (kernel == REDUCE_BARRETT)
+                stepTermsMpz(barrett, value, step, shift, divisor, terms.data(), count);
+            else
+                stepTermsMpz(gmp, value, step, shift, divisor, terms.data(), count);
+            statAdd(STAT_TERMS, count);
+            statAdd(STAT_MOD_MULS, count);
+            statAdd(STAT_REDUCTIONS, count);
+            termsMetric.add(count);
+        }
+
+        if (!synthesizer.playNotes(terms.data(), count))
+        {
+            std::cout << "\033[31mWrite failed.\033[0m\n";
+            return 1;
+        }
+        done += count;
+    }
+
+    if (!synthesizer.flush())
+    {
+        std::cout << "\033[31mWrite failed.\033[0m\n";
+        return 1;
+    }
+    double audioSeconds = static_cast<double>(total) * noteSamples / options.sampleRate;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "Wrote " << total << " notes (" << audioSeconds << " s of audio) to " << options.outputPath << " in " << seconds
+              << " s (" << audioSeconds / std::max(seconds, 1e-9) << "x real time).\n";
+    return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef SONIFY_H
+#define SONIFY_H
+
+#include <cstdint>
+#include <string>
+#include <gmpxx.h>
+
+// Render the sequence base^1, base^2, ... (mod modulo) as audio: every distinct term (the
+// terms the menu prints) becomes one note whose pitch rises with term / modulo over four
+// octaves from 110 Hz, voiced as a bank of harmonic partials with amplitudes 1/k. Terms are
+// stepped and synthesized in blocks and the samples streamed to a 16-bit mono WAV file, so
+// memory does not grow with the length of the cycle.
+struct SonifyOptions
+{
+    mpz_class base = 2;
+    mpz_class modulo = 9;
+    std::string outputPath;
+    uint32_t sampleRate = 44100;
+    uint32_t noteMicros = 100000; // Length of one term
+    unsigned partials = 8;        // 1..16
+};
+
+int runSonify(const SonifyOptions &options);
+
+#endif
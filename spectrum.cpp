@@ -0,0 +1,188 @@
+#include "spectrum.h"
+#include "engine.h"
+#include "fft.h"
+#include "metrics.h"
+#include "modarith.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+    const uint64_t maxPeriod = 1ull << 30; // The transform needs up to 64 bytes per term
+    const size_t outputBufferBytes = 1 << 20;
+
+    MetricCounter &termsMetric = metricCounter("sh_terms", "Sequence terms produced.");
+
+    // Scaled terms of a multi-limb sequence; Reducer is BarrettMpz or GmpReducer
+    template <class Reducer>
+    void stepTermsMpz(Reducer &reducer, mpz_class value, const mpz_class &step, size_t shift, double divisor, std::vector<double> &terms)
+    {
+        mpz_class scaled;
+        for (double &term : terms)
+        {
+            mpz_fdiv_q_2exp(scaled.get_mpz_t(), value.get_mpz_t(), shift);
+            term = scaled.get_d() / divisor;
+            reducer.multiply(value, value, step);
+        }
+    }
+
+    // One cycle of term / modulo, starting at base^(tail + 1)
+    void cycleTerms(const SpectrumOptions &options, const SequenceShape &shape, std::vector<double> &terms)
+    {
+        ScopedStatTimer timer(STAT_TIME_GENERATE);
+        TraceSpan span("cycle", "sequence");
+        mpz_class step = options.base % options.modulo;
+        if (step < 0)
+            step += options.modulo;
+        mpz_class start;
+        mpz_class exponent = uint64ToMpz(shape.tail + 1);
+        mpz_powm(start.get_mpz_t(), step.get_mpz_t(), exponent.get_mpz_t(), options.modulo.get_mpz_t());
+
+        terms.resize(shape.period);
+        size_t bits = mpz_sizeinbase(options.modulo.get_mpz_t(), 2);
+        ReductionKernel kernel = chooseReduction(bits, mpz_odd_p(options.modulo.get_mpz_t()), shape.period);
+        if (bits <= 64)
+        {
+            uint64_t modulo64 = mpzToUint64(options.modulo);
+            if (modulo64 == 1)
+                std::fill(terms.begin(), terms.end(), 0.0);
+            else
+            {
+                withReduction64(modulo64, kernel, [&](const auto &arithmetic)
+                {
+                    auto current = arithmetic.convertIn(mpzToUint64(start));
+                    auto multiplier = arithmetic.convertIn(mpzToUint64(step));
+                    for (double &term : terms)
+                    {
+                        term = static_cast<double>(arithmetic.convertOut(current)) / static_cast<double>(modulo64);
+                        current = arithmetic.multiply(current, multiplier);
+                    }
+                });
+            }
+        }
+        else
+        {
+            size_t shift = bits - 53;
+            mpz_class divisorScaled = options.modulo >> shift;
+            if (kernel == REDUCE_BARRETT)
+            {
+                BarrettMpz barrett(options.modulo);
+                stepTermsMpz(barrett, start, step, shift, divisorScaled.get_d(), terms);
+            }
+            else
+            {
+                GmpReducer gmp(options.modulo);
+                stepTermsMpz(gmp, start, step, shift, divisorScaled.get_d(), terms);
+            }
+        }
+        statAdd(STAT_TERMS, shape.period);
+        statAdd(STAT_MOD_MULS, shape.period);
+        statAdd(STAT_REDUCTIONS, shape.period);
+        termsMetric.add(shape.period);
+    }
+
+    bool exportSpectrum(const std::string &path, const std::vector<double> &power, uint64_t period)
+    {
+        TraceSpan span("write", "io");
+        std::ofstream file(path, std::ios::out | std::ios::trunc);
+        if (!file)
+            return false;
+        std::string buffer;
+        buffer.reserve(outputBufferBytes + 128);
+        char line[96];
+        for (uint64_t k = 0; k < power.size(); ++k)
+        {
+            int length = std::snprintf(line, sizeof(line), "%llu %.12g %.9g\n", static_cast<unsigned long long>(k),
+                                       static_cast<double>(k) / static_cast<double>(period), power[k]);
+            buffer.append(line, length);
+            if (buffer.size() >= outputBufferBytes)
+            {
+                file.write(buffer.data(), buffer.size());
+                statAdd(STAT_BYTES_WRITTEN, buffer.size());
+                buffer.clear();
+            }
+        }
+        file.write(buffer.data(), buffer.size());
+        statAdd(STAT_BYTES_WRITTEN, buffer.size());
+        return static_cast<bool>(file.flush());
+    }
+}
+
+int runSpectrum(const SpectrumOptions &options)
+{
+    SequenceShape shape;
+    {
+        TraceSpan span("order", "sequence");
+        shape = computeSequenceShape(options.base, options.modulo);
+    }
+    uint64_t period = shape.period;
+    if (period > maxPeriod)
+    {
+        std::cout << "\033[31mThe cycle is too long for a spectrum (" << period << " terms; at most " << maxPeriod << ").\033[0m\n";
+        return 1;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<double> terms;
+    cycleTerms(options, shape, terms);
+
+    // Remove the mean so the DC bin does not swamp the others; it is reported separately
+    double mean = std::accumulate(terms.begin(), terms.end(), 0.0) / static_cast<double>(period);
+    for (double &term : terms)
+        term -= mean;
+    std::vector<double> power;
+    realPowerSpectrum(terms, power);
+
+    // Parseval over the full two-sided spectrum: bins 1 .. p/2 count twice except Nyquist
+    double total = 0;
+    for (uint64_t k = 1; k < power.size(); ++k)
+        total += (2 * k == period ? 1.0 : 2.0) * power[k];
+
+    std::vector<uint64_t> bins(power.size() > 1 ? power.size() - 1 : 0);
+    std::iota(bins.begin(), bins.end(), 1);
+    size_t shown = std::min<size_t>(options.top, bins.size());
+    std::partial_sort(bins.begin(), bins.begin() + shown, bins.end(), [&power](uint64_t a, uint64_t b)
+    {
+        return power[a] > power[b] || (power[a] == power[b] && a < b);
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::cout << "Cycle of " << period << " terms after a tail of " << shape.tail << "; mean term / modulo " << mean << ".\n";
+    if (shown == 0)
+        std::cout << "The cycle is constant: no harmonics.\n";
+    else
+    {
+        std::cout << std::left << std::setw(6) << "Rank" << std::setw(12) << "Bin" << std::setw(16) << "Frequency" << std::setw(16)
+                  << "Period" << std::setw(16) << "Power" << "Share" << "\n";
+        for (size_t r = 0; r < shown; ++r)
+        {
+            uint64_t k = bins[r];
+            double share = total > 0 ? (2 * k == period ? 100.0 : 200.0) * power[k] / total : 0.0;
+            std::cout << std::left << std::setw(6) << r + 1 << std::setw(12) << k << std::setw(16)
+                      << static_cast<double>(k) / static_cast<double>(period) << std::setw(16)
+                      << static_cast<double>(period) / static_cast<double>(k) << std::setw(16) << power[k] << std::setprecision(3)
+                      << share << "%" << std::setprecision(6) << "\n";
+        }
+    }
+    std::cout << "Spectrum computed in " << seconds << " s.\n";
+
+    if (!options.outputPath.empty())
+    {
+        if (!exportSpectrum(options.outputPath, power, period))
+        {
+            std::cout << "\033[31mCannot write " << options.outputPath << ".\033[0m\n";
+            return 1;
+        }
+        std::cout << "Wrote " << power.size() << " bins to " << options.outputPath << ".\n";
+    }
+    return 0;
+}
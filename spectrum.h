@@ -0,0 +1,21 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <string>
+#include <gmpxx.h>
+
+// Power spectrum of one cycle of base^1, base^2, ... (mod modulo): the period terms after
+// the tail, scaled to term / modulo, with the mean removed, through a real-input FFT of the
+// cycle's own length (so a cycle of length p has bins k / p, k = 0 .. p/2). Prints the mean
+// and the strongest bins; outputPath, if set, receives every bin as "k frequency power".
+struct SpectrumOptions
+{
+    mpz_class base = 2;
+    mpz_class modulo = 9;
+    std::string outputPath;
+    unsigned top = 10; // Bins listed on the console
+};
+
+int runSpectrum(const SpectrumOptions &options);
+
+#endif
@@ -0,0 +1,180 @@
+#include "stats.h"
+
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> statsEnabled{false};
+
+namespace
+{
+    const char *counterNames[STAT_COUNTER_COUNT] = {
+        "mod_muls",
+        "reductions",
+        "seen_probes",
+        "seen_collisions",
+        "allocations",
+        "terms",
+        "bytes_written",
+        "frames",
+        "tiles",
+    };
+
+    const char *timerNames[STAT_TIMER_COUNT] = {
+        "generate",
+        "frame",
+        "tile",
+    };
+
+    struct StatsSnapshot
+    {
+        uint64_t counters[STAT_COUNTER_COUNT] = {};
+        uint64_t timerNanos[STAT_TIMER_COUNT] = {};
+        uint64_t timerCalls[STAT_TIMER_COUNT] = {};
+        uint64_t timerMaxNanos[STAT_TIMER_COUNT] = {};
+    };
+
+    // Blocks of live threads plus the folded totals of threads that already exited
+    std::mutex registryMutex;
+    std::vector<ThreadStats *> liveBlocks;
+    StatsSnapshot retired;
+    std::map<std::string, std::string> notes;
+
+    void accumulate(StatsSnapshot &into, const ThreadStats &block)
+    {
+        for (int c = 0; c < STAT_COUNTER_COUNT; ++c)
+            into.counters[c] += block.counters[c].load(std::memory_order_relaxed);
+        for (int t = 0; t < STAT_TIMER_COUNT; ++t)
+        {
+            into.timerNanos[t] += block.timerNanos[t].load(std::memory_order_relaxed);
+            into.timerCalls[t] += block.timerCalls[t].load(std::memory_order_relaxed);
+            uint64_t maxNanos = block.timerMaxNanos[t].load(std::memory_order_relaxed);
+            if (maxNanos > into.timerMaxNanos[t])
+                into.timerMaxNanos[t] = maxNanos;
+        }
+    }
+
+    // Owns the calling thread's block; folds it into the retired totals on thread exit
+    struct ThreadStatsHolder
+    {
+        ThreadStats block;
+
+        ThreadStatsHolder()
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            liveBlocks.push_back(&block);
+        }
+
+        ~ThreadStatsHolder()
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            accumulate(retired, block);
+            for (size_t i = 0; i < liveBlocks.size(); ++i)
+            {
+                if (liveBlocks[i] == &block)
+                {
+                    liveBlocks[i] = liveBlocks.back();
+                    liveBlocks.pop_back();
+                    break;
+                }
+            }
+        }
+    };
+
+    StatsSnapshot snapshot()
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        StatsSnapshot total = retired;
+        for (const ThreadStats *block : liveBlocks)
+            accumulate(total, *block);
+        return total;
+    }
+}
+
+ThreadStats &threadStats()
+{
+    thread_local ThreadStatsHolder holder;
+    return holder.block;
+}
+
+// Clear all counters and timers (threads keep their registered blocks)
+void resetStats()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    retired = StatsSnapshot();
+    for (ThreadStats *block : liveBlocks)
+    {
+        for (auto &c : block->counters)
+            c.store(0, std::memory_order_relaxed);
+        for (int t = 0; t < STAT_TIMER_COUNT; ++t)
+        {
+            block->timerNanos[t].store(0, std::memory_order_relaxed);
+            block->timerCalls[t].store(0, std::memory_order_relaxed);
+            block->timerMaxNanos[t].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void statNote(const std::string &key, const std::string &value)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    notes[key] = value;
+}
+
+// Print the summed counters and timers as an aligned table
+void printStatsTable(std::ostream &out)
+{
+    StatsSnapshot total = snapshot();
+
+    out << "\n--- Statistics" << (statsEnabled ? "" : " (collection OFF)") << " ---\n";
+    for (int c = 0; c < STAT_COUNTER_COUNT; ++c)
+        out << std::left << std::setw(18) << counterNames[c] << std::right << std::setw(16) << total.counters[c] << "\n";
+
+    out << "\n"
+        << std::left << std::setw(18) << "timer" << std::right << std::setw(10) << "calls"
+        << std::setw(14) << "total ms" << std::setw(12) << "avg us" << std::setw(12) << "max us" << "\n";
+    for (int t = 0; t < STAT_TIMER_COUNT; ++t)
+    {
+        double totalMs = total.timerNanos[t] / 1e6;
+        double avgUs = total.timerCalls[t] ? total.timerNanos[t] / 1e3 / total.timerCalls[t] : 0.0;
+        out << std::left << std::setw(18) << timerNames[t] << std::right << std::setw(10) << total.timerCalls[t]
+            << std::fixed << std::setprecision(3) << std::setw(14) << totalMs << std::setw(12) << avgUs
+            << std::setw(12) << total.timerMaxNanos[t] / 1e3 << "\n";
+    }
+    out << std::defaultfloat;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (!notes.empty())
+    {
+        out << "\n";
+        for (const auto &note : notes)
+            out << std::left << std::setw(18) << note.first << std::right << std::setw(16) << note.second << "\n";
+    }
+}
+
+// Print the summed counters and timers as a single JSON object
+void printStatsJson(std::ostream &out)
+{
+    StatsSnapshot total = snapshot();
+
+    out << "{\"counters\":{";
+    for (int c = 0; c < STAT_COUNTER_COUNT; ++c)
+        out << (c ? "," : "") << "\"" << counterNames[c] << "\":" << total.counters[c];
+    out << "},\"timers\":{";
+    for (int t = 0; t < STAT_TIMER_COUNT; ++t)
+    {
+        out << (t ? "," : "") << "\"" << timerNames[t] << "\":{\"calls\":" << total.timerCalls[t]
+            << ",\"total_ns\":" << total.timerNanos[t] << ",\"max_ns\":" << total.timerMaxNanos[t] << "}";
+    }
+    out << "},\"notes\":{";
+    std::lock_guard<std::mutex> lock(registryMutex);
+    bool first = true;
+    for (const auto &note : notes)
+    {
+        out << (first ? "" : ",") << "\"" << note.first << "\":\"" << note.second << "\"";
+        first = false;
+    }
+    out << "}}\n";
+}
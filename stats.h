@@ -0,0 +1,116 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Hot-path counters for the sequence engine and the renderer.
+// Every thread increments its own block, so the hot path never touches a shared
+// cache line. Build with -DSH_NO_STATS to compile all instrumentation out.
+
+enum StatCounter
+{
+    STAT_MOD_MULS,
+    STAT_REDUCTIONS,
+    STAT_SEEN_PROBES,
+    STAT_SEEN_COLLISIONS,
+    STAT_ALLOCATIONS,
+    STAT_TERMS,
+    STAT_BYTES_WRITTEN,
+    STAT_FRAMES,
+    STAT_TILES,
+    STAT_COUNTER_COUNT
+};
+
+enum StatTimer
+{
+    STAT_TIME_GENERATE,
+    STAT_TIME_FRAME,
+    STAT_TIME_TILE,
+    STAT_TIMER_COUNT
+};
+
+struct ThreadStats
+{
+    std::atomic<uint64_t> counters[STAT_COUNTER_COUNT] = {};
+    std::atomic<uint64_t> timerNanos[STAT_TIMER_COUNT] = {};
+    std::atomic<uint64_t> timerCalls[STAT_TIMER_COUNT] = {};
+    std::atomic<uint64_t> timerMaxNanos[STAT_TIMER_COUNT] = {};
+};
+
+// Runtime switch; counters cost a single predictable branch while it is off
+extern std::atomic<bool> statsEnabled;
+
+ThreadStats &threadStats();
+void resetStats();
+void printStatsTable(std::ostream &out);
+void printStatsJson(std::ostream &out);
+
+// Named runtime decisions (such as the arithmetic kernel picked for the current modulus),
+// printed with the counters. The latest value for a key wins; resetStats() keeps them.
+void statNote(const std::string &key, const std::string &value);
+
+// Add to a counter of the calling thread (single writer, so no read-modify-write atomics)
+inline void statAdd(StatCounter counter, uint64_t amount = 1)
+{
+#ifndef SH_NO_STATS
+    if (statsEnabled.load(std::memory_order_relaxed))
+    {
+        std::atomic<uint64_t> &slot = threadStats().counters[counter];
+        slot.store(slot.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+#else
+    (void)counter;
+    (void)amount;
+#endif
+}
+
+// Record one timed interval for the calling thread
+inline void statRecordTime(StatTimer timer, uint64_t nanos)
+{
+#ifndef SH_NO_STATS
+    ThreadStats &stats = threadStats();
+    stats.timerNanos[timer].store(stats.timerNanos[timer].load(std::memory_order_relaxed) + nanos, std::memory_order_relaxed);
+    stats.timerCalls[timer].store(stats.timerCalls[timer].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (nanos > stats.timerMaxNanos[timer].load(std::memory_order_relaxed))
+        stats.timerMaxNanos[timer].store(nanos, std::memory_order_relaxed);
+#else
+    (void)timer;
+    (void)nanos;
+#endif
+}
+
+// Scoped timer: measures from construction to destruction when stats are enabled
+class ScopedStatTimer
+{
+public:
+#ifndef SH_NO_STATS
+    explicit ScopedStatTimer(StatTimer timer)
+        : timer(timer), active(statsEnabled.load(std::memory_order_relaxed))
+    {
+        if (active)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedStatTimer()
+    {
+        if (active)
+        {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            statRecordTime(timer, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+private:
+    StatTimer timer;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+#else
+    explicit ScopedStatTimer(StatTimer) {}
+#endif
+};
+
+#endif
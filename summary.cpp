@@ -0,0 +1,436 @@
+#include "summary.h"
+#include "metrics.h"
+#include "modarith.h"
+#include "order.h"
+#include "simd.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+    const uint64_t sliceTerms = 1 << 14; // Exponents per scheduled slice; the block stays in L2
+
+    MetricCounter &termsMetric = metricCounter("sh_terms", "Sequence terms produced.");
+
+    // Running statistics of the slices one worker has folded. Slices carry the gap to the
+    // first term of the next slice, so partials merge in any order.
+    struct Partial
+    {
+        uint64_t count = 0;
+        double mean = 0;
+        double m2 = 0; // Sum of squared deviations from mean
+        mpz_class minimum, maximum, maxGap;
+        double gapSum = 0;
+        uint64_t rises = 0;
+        uint64_t histogram[summaryBins] = {};
+
+        // Chan et al.'s pairwise update of mean and m2
+        void merge(const Partial &other)
+        {
+            if (other.count == 0)
+                return;
+            if (count == 0 || other.minimum < minimum)
+                minimum = other.minimum;
+            if (count == 0 || other.maximum > maximum)
+                maximum = other.maximum;
+            if (other.maxGap > maxGap)
+                maxGap = other.maxGap;
+            double total = static_cast<double>(count + other.count);
+            double delta = other.mean - mean;
+            mean += delta * static_cast<double>(other.count) / total;
+            m2 += other.m2 + delta * delta * static_cast<double>(count) * static_cast<double>(other.count) / total;
+            count += other.count;
+            gapSum += other.gapSum;
+            rises += other.rises;
+            for (unsigned b = 0; b < summaryBins; ++b)
+                histogram[b] += other.histogram[b];
+        }
+    };
+
+    // Histogram slice b of [0, modulo) starts at ceil(b * modulo / summaryBins). A value's
+    // slice is estimated in floating point and corrected against the exact bounds.
+    struct BinBounds
+    {
+        uint64_t lower[summaryBins + 1];
+        double scale;
+
+        explicit BinBounds(uint64_t modulo) : scale(static_cast<double>(summaryBins) / static_cast<double>(modulo))
+        {
+            for (unsigned b = 0; b <= summaryBins; ++b)
+                lower[b] = static_cast<uint64_t>((static_cast<unsigned __int128>(modulo) * b + summaryBins - 1) / summaryBins);
+        }
+
+        unsigned find(uint64_t value) const
+        {
+            unsigned bin = std::min(static_cast<unsigned>(static_cast<double>(value) * scale), summaryBins - 1);
+            while (bin + 1 < summaryBins && value >= lower[bin + 1])
+                ++bin;
+            while (value < lower[bin])
+                --bin;
+            return bin;
+        }
+    };
+
+    // Fold count terms of one slice into partial; terms[count] is the first term of the next
+    // slice when hasNext is set and only contributes the gap. Each loop is a plain pass over
+    // an array in cache that the compiler vectorizes.
+    template <class Value>
+    void foldBlock(const Value *terms, size_t count, bool hasNext, uint64_t modulo, const BinBounds &bounds, Partial &partial)
+    {
+        double inverse = 1.0 / static_cast<double>(modulo);
+        double sum = 0;
+        Value low = terms[0], high = terms[0];
+        for (size_t i = 0; i < count; ++i)
+        {
+            sum += static_cast<double>(terms[i]);
+            low = std::min(low, terms[i]);
+            high = std::max(high, terms[i]);
+        }
+        double mean = sum / static_cast<double>(count) * inverse;
+        double m2 = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            double deviation = static_cast<double>(terms[i]) * inverse - mean;
+            m2 += deviation * deviation;
+        }
+
+        Partial block;
+        size_t gaps = count - 1 + (hasNext ? 1 : 0);
+        double gapSum = 0;
+        Value widest = 0;
+        uint64_t rises = 0;
+        for (size_t i = 0; i < gaps; ++i)
+        {
+            Value gap = terms[i + 1] > terms[i] ? terms[i + 1] - terms[i] : terms[i] - terms[i + 1];
+            gapSum += static_cast<double>(gap);
+            widest = std::max(widest, gap);
+            rises += terms[i + 1] > terms[i];
+        }
+        for (size_t i = 0; i < count; ++i)
+            ++block.histogram[bounds.find(terms[i])];
+
+        block.count = count;
+        block.mean = mean;
+        block.m2 = m2;
+        block.minimum = uint64ToMpz(low);
+        block.maximum = uint64ToMpz(high);
+        block.maxGap = uint64ToMpz(widest);
+        block.gapSum = gapSum * inverse;
+        block.rises = rises;
+        partial.merge(block);
+    }
+
+    // The same for a multi-limb modulus: values are compared exactly and scaled to doubles
+    // (dropping low bits first so the quotient fits)
+    void foldBlockMpz(const std::vector<mpz_class> &terms, size_t count, bool hasNext, const mpz_class &modulo,
+                      const std::vector<mpz_class> &lower, Partial &partial)
+    {
+        size_t bits = mpz_sizeinbase(modulo.get_mpz_t(), 2);
+        size_t shift = bits > 53 ? bits - 53 : 0;
+        mpz_class scaled = modulo >> shift;
+        double divisor = scaled.get_d();
+
+        Partial block;
+        std::vector<double> ratios(count + (hasNext ? 1 : 0));
+        block.minimum = terms[0];
+        block.maximum = terms[0];
+        for (size_t i = 0; i < ratios.size(); ++i)
+        {
+            mpz_fdiv_q_2exp(scaled.get_mpz_t(), terms[i].get_mpz_t(), shift);
+            ratios[i] = scaled.get_d() / divisor;
+        }
+        double sum = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            sum += ratios[i];
+            if (terms[i] < block.minimum)
+                block.minimum = terms[i];
+            if (terms[i] > block.maximum)
+                block.maximum = terms[i];
+            size_t bin = std::upper_bound(lower.begin() + 1, lower.end() - 1, terms[i]) - lower.begin() - 1;
+            ++block.histogram[bin];
+        }
+        block.count = count;
+        block.mean = sum / static_cast<double>(count);
+        for (size_t i = 0; i < count; ++i)
+            block.m2 += (ratios[i] - block.mean) * (ratios[i] - block.mean);
+
+        mpz_class gap;
+        for (size_t i = 0; i + 1 < ratios.size(); ++i)
+        {
+            gap = terms[i + 1] - terms[i];
+            block.rises += sgn(gap) > 0;
+            mpz_abs(gap.get_mpz_t(), gap.get_mpz_t());
+            if (gap > block.maxGap)
+                block.maxGap = gap;
+            block.gapSum += std::fabs(ratios[i + 1] - ratios[i]);
+        }
+        partial.merge(block);
+    }
+
+    // Whether a unit u is a square modulo p^e: a square mod p for odd p (Euler's criterion),
+    // and 1 mod 4 or 1 mod 8 for 2^2 and higher powers of two
+    bool unitIsSquare(uint64_t u, uint64_t p, unsigned e)
+    {
+        if (p == 2)
+            return e == 1 || (e == 2 ? (u & 3) == 1 : (u & 7) == 1);
+        return powMod64(u % p, (p - 1) / 2, p) == 1;
+    }
+
+    // Squares among b^k mod p^e for one prime power of the modulus. Write b = p^v u: for
+    // v * k >= e the term is 0, otherwise p^(vk) u^k is a square iff vk is even and u^k is
+    // a square mod p^(e - vk), and a power of a unit is a square iff the unit is or k is even.
+    struct SquareComponent
+    {
+        uint64_t prime;
+        unsigned exponent;
+        unsigned valuation; // v, capped at exponent
+        uint64_t unit;      // u mod p^e
+
+        bool isSquare(uint64_t k) const
+        {
+            if (valuation > 0 && valuation * k >= exponent)
+                return true;
+            uint64_t zeros = valuation * k;
+            if (zeros & 1)
+                return false;
+            return (k & 1) == 0 || unitIsSquare(unit, prime, exponent - static_cast<unsigned>(zeros));
+        }
+    };
+
+    // Every component is settled once k >= ceil(e / v) for all v > 0 (at most 64 terms in);
+    // past that point a term is a square iff k is even or every unit part is a square
+    int64_t countSquares(uint64_t base, uint64_t modulo, uint64_t terms)
+    {
+        std::vector<SquareComponent> components;
+        uint64_t settled = 1;
+        bool unitsSquare = true;
+        for (const PrimePower &power : factorUint64(modulo))
+        {
+            uint64_t q = 1;
+            for (unsigned i = 0; i < power.exponent; ++i)
+                q *= power.prime;
+            SquareComponent component{power.prime, power.exponent, 0, base % q};
+            while (component.valuation < power.exponent && component.unit % power.prime == 0 && component.unit != 0)
+            {
+                component.unit /= power.prime;
+                ++component.valuation;
+            }
+            if (component.unit == 0)
+                component.valuation = power.exponent;
+            if (component.valuation > 0)
+                settled = std::max<uint64_t>(settled, (power.exponent + component.valuation - 1) / component.valuation);
+            else
+                unitsSquare = unitsSquare && unitIsSquare(component.unit, power.prime, power.exponent);
+            components.push_back(component);
+        }
+
+        int64_t squares = 0;
+        uint64_t k = 1;
+        for (; k < settled && k <= terms; ++k)
+        {
+            bool square = true;
+            for (const SquareComponent &component : components)
+                square = square && component.isSquare(k);
+            squares += square;
+        }
+        if (k <= terms)
+            squares += static_cast<int64_t>(unitsSquare ? terms - k + 1 : terms / 2 - (k - 1) / 2);
+        return squares;
+    }
+
+    int64_t countSquares(const mpz_class &base, const mpz_class &modulo, uint64_t terms)
+    {
+        if (mpz_sizeinbase(modulo.get_mpz_t(), 2) <= 64)
+            return countSquares(mpzToUint64(base), mpzToUint64(modulo), terms);
+        if (mpz_probab_prime_p(modulo.get_mpz_t(), 25) == 0)
+            return -1;
+        int symbol = mpz_legendre(base.get_mpz_t(), modulo.get_mpz_t());
+        return static_cast<int64_t>(symbol >= 0 ? terms : terms / 2);
+    }
+
+    // Slices of a modulus up to 64 bits. Odd moduli below 2^32 take the vector power run;
+    // the rest step with the kernel the cost model picks.
+    void summarizeSlices64(uint64_t base, uint64_t modulo, uint64_t total, std::vector<Partial> &partials)
+    {
+        BinBounds bounds(modulo);
+        size_t bits = 64 - __builtin_clzll(modulo);
+        ReductionKernel kernel = chooseReduction(bits, modulo & 1, total);
+        bool vector = (modulo & 1) && modulo >= 3 && modulo < (1ull << 32);
+        SimdLevel level = activeSimdLevel();
+
+        sharedThreadPool().parallelFor(0, (total - 1) / sliceTerms + 1, 1, [&](uint64_t first, uint64_t last, unsigned worker)
+        {
+            std::vector<uint32_t> narrow(vector ? sliceTerms + 1 : 0);
+            std::vector<uint64_t> wide(vector ? 0 : sliceTerms + 1);
+            for (uint64_t slice = first; slice < last; ++slice)
+            {
+                uint64_t begin = slice * sliceTerms;
+                size_t count = static_cast<size_t>(std::min(sliceTerms, total - begin));
+                bool hasNext = begin + count < total;
+                size_t stepped = count + (hasNext ? 1 : 0);
+                uint64_t start = powMod64(base, begin + 1, modulo);
+                if (vector)
+                {
+                    powerRunFixedModulus(static_cast<uint32_t>(modulo), static_cast<uint32_t>(start), static_cast<uint32_t>(base % modulo),
+                                         narrow.data(), stepped, level);
+                    foldBlock(narrow.data(), count, hasNext, modulo, bounds, partials[worker]);
+                    continue;
+                }
+                if (modulo == 1)
+                    std::fill(wide.begin(), wide.begin() + stepped, 0);
+                else
+                {
+                    withReduction64(modulo, kernel, [&](const auto &arithmetic)
+                    {
+                        auto current = arithmetic.convertIn(start);
+                        auto multiplier = arithmetic.convertIn(base % modulo);
+                        for (size_t i = 0; i < stepped; ++i)
+                        {
+                            wide[i] = arithmetic.convertOut(current);
+                            current = arithmetic.multiply(current, multiplier);
+                        }
+                    });
+                    statAdd(STAT_MOD_MULS, stepped);
+                    statAdd(STAT_REDUCTIONS, stepped);
+                }
+                foldBlock(wide.data(), count, hasNext, modulo, bounds, partials[worker]);
+            }
+        });
+    }
+
+    template <class Reducer>
+    void stepSlice(Reducer &reducer, mpz_class value, const mpz_class &step, std::vector<mpz_class> &terms, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            terms[i] = value;
+            reducer.multiply(value, value, step);
+        }
+    }
+
+    void summarizeSlicesMpz(const mpz_class &base, const mpz_class &modulo, uint64_t total, std::vector<Partial> &partials)
+    {
+        std::vector<mpz_class> lower(summaryBins + 1);
+        for (unsigned b = 0; b <= summaryBins; ++b)
+            mpz_cdiv_q_ui(lower[b].get_mpz_t(), mpz_class(modulo * b).get_mpz_t(), summaryBins);
+        size_t bits = mpz_sizeinbase(modulo.get_mpz_t(), 2);
+        ReductionKernel kernel = chooseReduction(bits, mpz_odd_p(modulo.get_mpz_t()), total);
+        mpz_class step = base % modulo;
+        if (step < 0)
+            step += modulo;
+
+        sharedThreadPool().parallelFor(0, (total - 1) / sliceTerms + 1, 1, [&](uint64_t first, uint64_t last, unsigned worker)
+        {
+            std::vector<mpz_class> terms(sliceTerms + 1);
+            BarrettMpz barrett(modulo);
+            GmpReducer gmp(modulo);
+            mpz_class start;
+            for (uint64_t slice = first; slice < last; ++slice)
+            {
+                uint64_t begin = slice * sliceTerms;
+                size_t count = static_cast<size_t>(std::min(sliceTerms, total - begin));
+                bool hasNext = begin + count < total;
+                size_t stepped = count + (hasNext ? 1 : 0);
+                mpz_class exponent = uint64ToMpz(begin + 1);
+                mpz_powm(start.get_mpz_t(), step.get_mpz_t(), exponent.get_mpz_t(), modulo.get_mpz_t());
+                if (kernel == REDUCE_BARRETT)
+                    stepSlice(barrett, start, step, terms, stepped);
+                else
+                    stepSlice(gmp, start, step, terms, stepped);
+                statAdd(STAT_MOD_MULS, stepped);
+                statAdd(STAT_REDUCTIONS, stepped);
+                foldBlockMpz(terms, count, hasNext, modulo, lower, partials[worker]);
+            }
+        });
+    }
+}
+
+SequenceSummary summarizeSequence(const mpz_class &base, const mpz_class &modulo)
+{
+    TraceSpan span("summary", "sequence");
+    SequenceSummary summary;
+    summary.shape = computeSequenceShape(base, modulo);
+    summary.terms = summary.shape.tail + summary.shape.period;
+
+    std::vector<Partial> partials(sharedThreadPool().size());
+    mpz_class reduced = base % modulo;
+    if (reduced < 0)
+        reduced += modulo;
+    if (mpz_sizeinbase(modulo.get_mpz_t(), 2) <= 64)
+        summarizeSlices64(mpzToUint64(reduced), mpzToUint64(modulo), summary.terms, partials);
+    else
+        summarizeSlicesMpz(reduced, modulo, summary.terms, partials);
+
+    Partial all;
+    for (const Partial &partial : partials)
+        all.merge(partial);
+    summary.minimum = all.minimum;
+    summary.maximum = all.maximum;
+    summary.mean = all.mean;
+    summary.variance = all.m2 / static_cast<double>(all.count);
+    summary.meanGap = summary.terms > 1 ? all.gapSum / static_cast<double>(summary.terms - 1) : 0.0;
+    summary.maxGap = all.maxGap;
+    summary.rises = all.rises;
+    std::copy(all.histogram, all.histogram + summaryBins, summary.histogram);
+    summary.quadraticResidues = countSquares(reduced, modulo, summary.terms);
+
+    statAdd(STAT_TERMS, summary.terms);
+    termsMetric.add(summary.terms);
+    return summary;
+}
+
+std::string summaryJson(const mpz_class &base, const mpz_class &modulo, const SequenceSummary &summary)
+{
+    std::ostringstream out;
+    out << std::setprecision(17);
+    out << "{\"base\":\"" << base.get_str() << "\",\"modulo\":\"" << modulo.get_str() << "\",\"tail\":" << summary.shape.tail
+        << ",\"period\":" << summary.shape.period << ",\"terms\":" << summary.terms << ",\"min\":\"" << summary.minimum.get_str()
+        << "\",\"max\":\"" << summary.maximum.get_str() << "\",\"mean\":" << summary.mean << ",\"variance\":" << summary.variance
+        << ",\"mean_gap\":" << summary.meanGap << ",\"max_gap\":\"" << summary.maxGap.get_str() << "\",\"rises\":" << summary.rises
+        << ",\"histogram\":[";
+    for (unsigned b = 0; b < summaryBins; ++b)
+        out << (b ? "," : "") << summary.histogram[b];
+    out << "],\"quadratic_residues\":";
+    if (summary.quadraticResidues < 0)
+        out << "null";
+    else
+        out << summary.quadraticResidues;
+    out << "}";
+    return out.str();
+}
+
+void printSummary(std::ostream &out, const SequenceSummary &summary)
+{
+    const int barWidth = 40;
+    out << "\n--- Sequence Summary ---\n";
+    out << "Terms: " << summary.terms << " (tail " << summary.shape.tail << ", period " << summary.shape.period << ")\n";
+    out << "Minimum: " << summary.minimum << "   Maximum: " << summary.maximum << "\n";
+    out << "Mean / modulo: " << summary.mean << "   Std dev / modulo: " << std::sqrt(summary.variance)
+        << "   (uniform: 0.5 and 0.288675)\n";
+    if (summary.terms > 1)
+        out << "Steps: mean |gap| / modulo " << summary.meanGap << ", largest gap " << summary.maxGap << ", rising "
+            << summary.rises << " of " << summary.terms - 1 << "\n";
+    if (summary.quadraticResidues >= 0)
+        out << "Quadratic residues: " << summary.quadraticResidues << " of " << summary.terms << " ("
+            << 100.0 * static_cast<double>(summary.quadraticResidues) / static_cast<double>(summary.terms) << "%)\n";
+    else
+        out << "Quadratic residues: unknown (modulo is composite and wider than 64 bits)\n";
+
+    out << "Histogram of term / modulo:\n";
+    uint64_t largest = *std::max_element(summary.histogram, summary.histogram + summaryBins);
+    for (unsigned b = 0; b < summaryBins; ++b)
+    {
+        int length = largest ? static_cast<int>((summary.histogram[b] * barWidth + largest - 1) / largest) : 0;
+        out << "  " << std::fixed << std::setprecision(4) << static_cast<double>(b) / summaryBins << "-"
+            << static_cast<double>(b + 1) / summaryBins << std::defaultfloat << std::setprecision(6) << " |"
+            << std::string(length, '#') << std::string(barWidth - length, ' ') << "| " << summary.histogram[b] << "\n";
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <gmpxx.h>
+#include "engine.h"
+
+// Statistics of the distinct terms base^1 .. base^(tail + period) (mod modulo), the terms
+// the menu prints, gathered in one parallel pass over the generator: every worker jumps
+// straight to its own slices of exponents and steps them in cache-sized blocks, so the
+// sequence is never stored. Odd moduli below 2^32 step through the vector kernel of
+// simd.h. Means, variances and gaps are in units of term / modulo (a uniform spread has
+// mean 0.5 and variance 1/12).
+
+const unsigned summaryBins = 16;
+
+struct SequenceSummary
+{
+    SequenceShape shape;
+    uint64_t terms = 0; // tail + period
+    mpz_class minimum, maximum;
+    double mean = 0;
+    double variance = 0;
+    double meanGap = 0;    // Mean |t(i+1) - t(i)| over successive terms
+    mpz_class maxGap;      // Largest |t(i+1) - t(i)|, exact
+    uint64_t rises = 0;    // Successive pairs with t(i+1) > t(i)
+    uint64_t histogram[summaryBins] = {}; // Terms in each of summaryBins equal slices of [0, modulo)
+    int64_t quadraticResidues = -1; // Terms that are squares mod modulo; -1 when unknown
+};
+
+// The square count is exact for moduli up to 64 bits (factored) and for prime moduli;
+// other moduli leave it at -1
+SequenceSummary summarizeSequence(const mpz_class &base, const mpz_class &modulo);
+
+// One JSON object on one line, without the newline
+std::string summaryJson(const mpz_class &base, const mpz_class &modulo, const SequenceSummary &summary);
+
+// Console report with a bar chart of the histogram
+void printSummary(std::ostream &out, const SequenceSummary &summary);
+
+#endif
@@ -0,0 +1,692 @@
+#include "sweep.h"
+#include "checkpoint.h"
+#include "engine.h"
+#include "metrics.h"
+#include "order.h"
+#include "simd.h"
+#include "stats.h"
+#include "summary.h"
+#include "threadpool.h"
+#include "totient.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <gmpxx.h>
+
+namespace
+{
+    const uint64_t sweepChunkSize = 256;  // Moduli per scheduled, formatted and checkpointed chunk
+    const uint64_t sweepGrain = 64;       // Smallest range a pool worker processes at once
+
+    MetricCounter &ordersMetric = metricCounter("sh_orders", "Sequence shapes (orders) computed.");
+    MetricGauge &sweepQueueMetric = metricGauge("sh_queue_depth", "Work items waiting to be started.", "queue=\"sweep\"");
+    MetricGauge &batchQueueMetric = metricGauge("sh_queue_depth", "Work items waiting to be started.", "queue=\"batch\"");
+
+    // Shapes for moduli first + [begin, end), recorded into results
+    void sweepRange(const SweepOptions &options, std::vector<SequenceShape> &results, uint64_t begin, uint64_t end)
+    {
+        TraceSpan span("chunk", "sweep");
+        for (uint64_t i = begin; i < end; ++i)
+            results[i] = computeSequenceShape(options.base, options.first + i);
+        ordersMetric.add(end - begin);
+    }
+
+    // The previous scheduler: one contiguous block per thread (kept as the benchmark baseline)
+    void sweepStaticPartition(const SweepOptions &options, std::vector<SequenceShape> &results, unsigned threadCount)
+    {
+        uint64_t count = results.size();
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threadCount; ++t)
+        {
+            uint64_t begin = count * t / threadCount;
+            uint64_t end = count * (t + 1) / threadCount;
+            workers.emplace_back([&options, &results, begin, end]()
+            {
+                sweepRange(options, results, begin, end);
+            });
+        }
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    // Order-sensitive checksum so the benchmark can confirm both schedulers agree
+    uint64_t shapeChecksum(const std::vector<SequenceShape> &results)
+    {
+        uint64_t checksum = 0;
+        for (const SequenceShape &shape : results)
+            checksum = checksum * 1000003 + shape.tail * 31 + shape.period;
+        return checksum;
+    }
+
+    // The prime powers of a modulus with the factorization of lambda of each, so lambda of any
+    // part of the modulus is an lcm of entries instead of a new factorization
+    struct ModulusFactors
+    {
+        std::vector<PrimePower> powers;
+        std::vector<std::vector<PrimePower>> lambdas;
+
+        explicit ModulusFactors(uint64_t modulus) : powers(factorUint64(modulus))
+        {
+            for (const PrimePower &power : powers)
+                lambdas.push_back(carmichaelFactors({power}));
+        }
+    };
+
+    // Shape of base^i (mod modulus) for base >= 1 without stepping: the primes shared with base
+    // set the tail (see splitCoprime) and the period is the order of base modulo the rest
+    SequenceShape shapeFromFactors(uint64_t base, uint64_t modulus, const ModulusFactors &factors)
+    {
+        CoprimeSplit split = splitCoprime(base, modulus, factors.powers);
+        std::vector<PrimePower> lambda;
+        for (size_t j = 0; j < factors.powers.size(); ++j)
+        {
+            if (base % factors.powers[j].prime == 0)
+                continue;
+            for (const PrimePower &part : factors.lambdas[j])
+                mergeMaxPower(lambda, part.prime, part.exponent);
+        }
+        SequenceShape shape;
+        shape.tail = split.clearing > 0 ? split.clearing - 1 : 0;
+        shape.period = unitOrderFromLambda(base, split.coprime, lambda);
+        return shape;
+    }
+
+    struct BatchJob
+    {
+        mpz_class base;
+        mpz_class modulo;
+        SequenceShape shape;
+    };
+
+    // Write a formatted block to the output file, or to standard output when none is given
+    bool writeBlock(std::ofstream &file, bool toFile, const std::string &text)
+    {
+        TraceSpan span("write", "io");
+        if (toFile)
+            file << text;
+        else
+            std::cout << text;
+        statAdd(STAT_BYTES_WRITTEN, text.size());
+        return toFile ? static_cast<bool>(file) : static_cast<bool>(std::cout);
+    }
+
+    // Output state of a sweep. Chunks finish in any order; each is held in pending until
+    // every chunk before it has been written, so the output is always a clean prefix.
+    struct SweepProgress
+    {
+        std::mutex mutex;
+        std::ofstream file;
+        std::map<uint64_t, std::string> pending; // Completed chunk index -> formatted lines
+        uint64_t flushedChunks = 0;
+        uint64_t outputBytes = 0;
+        bool failed = false;
+        std::chrono::steady_clock::time_point lastCheckpoint;
+    };
+
+    // Write every pending chunk that continues the written prefix; caller holds progress.mutex
+    void flushSweepPrefix(SweepProgress &progress, bool toFile)
+    {
+        auto next = progress.pending.find(progress.flushedChunks);
+        while (next != progress.pending.end())
+        {
+            if (!writeBlock(progress.file, toFile, next->second))
+                progress.failed = true;
+            progress.outputBytes += next->second.size();
+            progress.pending.erase(next);
+            next = progress.pending.find(++progress.flushedChunks);
+        }
+    }
+
+    // Checkpoint layout: sweep axis and parameters, the written prefix (chunks and bytes), then a
+    // bitmap of completed chunks after the prefix followed by their formatted lines
+    void saveSweepCheckpoint(const SweepOptions &options, SweepProgress &progress)
+    {
+        TraceSpan span("checkpoint", "io");
+        progress.file.flush();
+
+        CheckpointWriter writer("sweep");
+        writer.putU64(options.axis);
+        writer.putU64(options.axis == SWEEP_BASES ? options.modulo : options.base);
+        writer.putU64(options.first);
+        writer.putU64(options.last);
+        writer.putU64(sweepChunkSize);
+        writer.putU64(progress.flushedChunks);
+        writer.putU64(progress.outputBytes);
+
+        uint64_t pendingSpan = progress.pending.empty() ? 0 : progress.pending.rbegin()->first - progress.flushedChunks + 1;
+        std::vector<uint64_t> bitmap((pendingSpan + 63) / 64, 0);
+        for (const auto &chunk : progress.pending)
+        {
+            uint64_t bit = chunk.first - progress.flushedChunks;
+            bitmap[bit / 64] |= 1ull << (bit % 64);
+        }
+        writer.putU64(bitmap.size());
+        for (uint64_t word : bitmap)
+            writer.putU64(word);
+        for (const auto &chunk : progress.pending)
+            writer.putBytes(chunk.second);
+
+        if (!writer.commit(options.checkpointPath))
+            std::cout << "\033[31mCannot write checkpoint " << options.checkpointPath << ".\033[0m\n";
+    }
+
+    bool loadSweepCheckpoint(const SweepOptions &options, SweepProgress &progress)
+    {
+        CheckpointReader reader;
+        uint64_t axis, fixed, first, last, chunkSize, words;
+        if (!reader.open(options.checkpointPath, "sweep") || !reader.getU64(axis) || !reader.getU64(fixed) || !reader.getU64(first) ||
+            !reader.getU64(last) || !reader.getU64(chunkSize) || !reader.getU64(progress.flushedChunks) ||
+            !reader.getU64(progress.outputBytes) || !reader.getU64(words))
+            return false;
+        if (axis != static_cast<uint64_t>(options.axis) || fixed != (options.axis == SWEEP_BASES ? options.modulo : options.base) ||
+            first != options.first || last != options.last || chunkSize != sweepChunkSize)
+            return false;
+
+        std::vector<uint64_t> bitmap(words);
+        for (uint64_t &word : bitmap)
+        {
+            if (!reader.getU64(word))
+                return false;
+        }
+        for (uint64_t bit = 0; bit < words * 64; ++bit)
+        {
+            if (bitmap[bit / 64] & (1ull << (bit % 64)))
+            {
+                std::string text;
+                if (!reader.getBytes(text))
+                    return false;
+                progress.pending.emplace(progress.flushedChunks + bit, std::move(text));
+            }
+        }
+        return true;
+    }
+}
+
+// Shapes of base for the moduli firstModulus, firstModulus + 1, ... (one per element of shapes).
+// Every modulus is split into the primes of base, which set the tail, and a part base is a
+// unit of, whose order (the period) divides lambda of the whole modulus. Below 2^32 lambda is
+// sieved for the chunk at once (see totient.h) and the orders checked in vector lanes (see
+// order.h); above, each modulus is factored once and checked with scalar arithmetic.
+void computeSweepShapes(uint64_t base, uint64_t firstModulus, std::vector<SequenceShape> &shapes)
+{
+    TraceSpan span("chunk", "sweep");
+    std::vector<uint32_t> units, unitLambdas, lambdas;
+    std::vector<size_t> unitSlots;
+    std::vector<PrimePower> baseFactors;
+    if (firstModulus < (1ull << 32) && base >= 2)
+    {
+        lambdas.resize(std::min<uint64_t>(shapes.size(), (1ull << 32) - firstModulus));
+        loadTotients(firstModulus, lambdas.size(), nullptr, lambdas.data());
+        baseFactors = factorUint64(base);
+    }
+
+    for (size_t i = 0; i < shapes.size(); ++i)
+    {
+        uint64_t modulus = firstModulus + i;
+        if (i >= lambdas.size())
+        {
+            shapes[i] = base >= 2 ? shapeFromFactors(base, modulus, ModulusFactors(modulus)) : computeSequenceShape(base, modulus);
+            continue;
+        }
+        CoprimeSplit split = splitCoprime(base, modulus, baseFactors);
+        shapes[i].tail = split.clearing > 0 ? split.clearing - 1 : 0;
+        shapes[i].period = 1;
+        if (split.coprime >= 3)
+        {
+            units.push_back(static_cast<uint32_t>(split.coprime));
+            unitLambdas.push_back(lambdas[i]);
+            unitSlots.push_back(i);
+        }
+    }
+
+    if (!units.empty())
+    {
+        std::vector<uint64_t> orders(units.size());
+        unitOrdersFromLambda(base, units.data(), unitLambdas.data(), units.size(), orders.data(), activeSimdLevel());
+        for (size_t u = 0; u < units.size(); ++u)
+            shapes[unitSlots[u]].period = orders[u];
+    }
+    ordersMetric.add(shapes.size());
+}
+
+// Shapes of every base firstBase, firstBase + 1, ... modulo a fixed modulus, factored once per
+// chunk. For a modulus below 2^32 the unit bases get their orders from lambda(modulo) (see
+// order.h); the others, and every base of a wider modulus, are split like the moduli of
+// computeSweepShapes() and take the scalar divisor checks.
+void computeBaseSweepShapes(uint64_t modulo, uint64_t firstBase, std::vector<SequenceShape> &shapes)
+{
+    TraceSpan span("chunk", "sweep");
+    bool vectorizable = modulo >= 3 && modulo < (1ull << 32);
+    uint32_t lambda = 0;
+    if (vectorizable)
+        loadTotients(modulo, 1, nullptr, &lambda);
+    ModulusFactors factors(modulo);
+    std::vector<uint32_t> units;
+    std::vector<size_t> unitSlots;
+
+    for (size_t i = 0; i < shapes.size(); ++i)
+    {
+        uint64_t reduced = (firstBase + i) % modulo;
+        if (reduced == 0)
+        {
+            shapes[i].tail = 0;
+            shapes[i].period = 1;
+        }
+        else if (vectorizable && gcd64(reduced, modulo) == 1)
+        {
+            units.push_back(static_cast<uint32_t>(reduced));
+            unitSlots.push_back(i);
+        }
+        else
+            shapes[i] = shapeFromFactors(reduced, modulo, factors);
+    }
+
+    if (!units.empty())
+    {
+        std::vector<uint64_t> orders(units.size());
+        unitOrdersOfBases(static_cast<uint32_t>(modulo), lambda, units.data(), units.size(), orders.data(), activeSimdLevel());
+        for (size_t u = 0; u < units.size(); ++u)
+        {
+            shapes[unitSlots[u]].tail = 0;
+            shapes[unitSlots[u]].period = orders[u];
+        }
+    }
+    ordersMetric.add(shapes.size());
+}
+
+// Sweep output lines ("modulus tail period", or "base tail period" for a base sweep)
+std::string formatSweepLines(uint64_t firstModulus, const std::vector<SequenceShape> &shapes)
+{
+    TraceSpan span("format", "sweep");
+    std::string text;
+    text.reserve(shapes.size() * 24);
+    for (size_t i = 0; i < shapes.size(); ++i)
+    {
+        text += std::to_string(firstModulus + i);
+        text += ' ';
+        text += std::to_string(shapes[i].tail);
+        text += ' ';
+        text += std::to_string(shapes[i].period);
+        text += '\n';
+    }
+    return text;
+}
+
+// Compute the sequence shape for every modulus (or base) in the range
+int runSweep(const SweepOptions &options)
+{
+    if ((options.axis == SWEEP_MODULI && options.first == 0) || (options.axis == SWEEP_BASES && options.modulo == 0) ||
+        options.last < options.first || options.last == UINT64_MAX)
+    {
+        std::cout << "\033[31mInvalid sweep range.\033[0m\n";
+        return 1;
+    }
+    bool checkpointing = !options.checkpointPath.empty();
+    if ((checkpointing || options.resume) && options.outputPath.empty())
+    {
+        std::cout << "\033[31mCheckpointing a sweep requires --output.\033[0m\n";
+        return 1;
+    }
+
+    uint64_t count = options.last - options.first + 1;
+    uint64_t chunkCount = (count - 1) / sweepChunkSize + 1;
+    SweepProgress progress;
+    progress.lastCheckpoint = std::chrono::steady_clock::now();
+    std::vector<char> completedAtResume;
+
+    if (options.resume)
+    {
+        if (!loadSweepCheckpoint(options, progress) || !truncateOutput(options.outputPath, progress.outputBytes))
+        {
+            std::cout << "\033[31mCannot resume from " << options.checkpointPath
+                      << " (missing, damaged, or written for a different sweep).\033[0m\n";
+            return 1;
+        }
+        completedAtResume.assign(chunkCount, 0);
+        for (const auto &chunk : progress.pending)
+            completedAtResume[chunk.first] = 1;
+        std::cout << "Resuming sweep at chunk " << progress.flushedChunks << " of " << chunkCount << ".\n";
+    }
+
+    bool toFile = !options.outputPath.empty();
+    if (toFile)
+    {
+        progress.file.open(options.outputPath, std::ios::out | std::ios::binary | (options.resume ? std::ios::app : std::ios::trunc));
+        if (!progress.file)
+        {
+            std::cout << "\033[31mCannot open output file " << options.outputPath << ".\033[0m\n";
+            return 1;
+        }
+    }
+
+    // Chunks completed before an interruption already sit in progress.pending
+    flushSweepPrefix(progress, toFile);
+    std::atomic<uint64_t> pendingChunks{chunkCount - progress.flushedChunks - progress.pending.size()};
+    sweepQueueMetric.set(static_cast<double>(pendingChunks.load()));
+
+    sharedThreadPool().parallelFor(progress.flushedChunks, chunkCount, 1, [&](uint64_t begin, uint64_t end, unsigned)
+    {
+        std::vector<SequenceShape> shapes;
+        for (uint64_t chunk = begin; chunk < end; ++chunk)
+        {
+            if (!completedAtResume.empty() && completedAtResume[chunk])
+                continue;
+
+            uint64_t first = chunk * sweepChunkSize;
+            uint64_t last = first + sweepChunkSize < count ? first + sweepChunkSize : count;
+            shapes.resize(last - first);
+            if (options.axis == SWEEP_BASES)
+                computeBaseSweepShapes(options.modulo, options.first + first, shapes);
+            else
+                computeSweepShapes(options.base, options.first + first, shapes);
+            std::string text = formatSweepLines(options.first + first, shapes);
+
+            std::lock_guard<std::mutex> lock(progress.mutex);
+            progress.pending.emplace(chunk, std::move(text));
+            flushSweepPrefix(progress, toFile);
+            sweepQueueMetric.set(static_cast<double>(--pendingChunks));
+
+            if (checkpointing && std::chrono::steady_clock::now() - progress.lastCheckpoint >= std::chrono::seconds(options.checkpointInterval))
+            {
+                saveSweepCheckpoint(options, progress);
+                progress.lastCheckpoint = std::chrono::steady_clock::now();
+            }
+        }
+    });
+
+    if (progress.failed || progress.flushedChunks != chunkCount)
+    {
+        std::cout << "\033[31mWrite failed.\033[0m\n";
+        return 1;
+    }
+    if (toFile)
+        progress.file.close();
+    if (checkpointing)
+        std::remove(options.checkpointPath.c_str());
+    return 0;
+}
+
+// Compute the sequence shape for every job listed in the batch input file
+int runBatch(const BatchOptions &options)
+{
+    std::ifstream input(options.inputPath);
+    if (!input)
+    {
+        std::cout << "\033[31mCannot open batch file " << options.inputPath << ".\033[0m\n";
+        return 1;
+    }
+
+    std::vector<BatchJob> jobs;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(input, line))
+    {
+        ++lineNumber;
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        std::string baseText, moduloText;
+        BatchJob job;
+        if (!(fields >> baseText >> moduloText) || job.base.set_str(baseText, 10) != 0 ||
+            job.modulo.set_str(moduloText, 10) != 0 || job.modulo < 1)
+        {
+            std::cout << "\033[31mInvalid batch line " << lineNumber << ": " << line << "\033[0m\n";
+            return 1;
+        }
+        jobs.push_back(job);
+    }
+
+    std::ofstream file;
+    bool toFile = !options.outputPath.empty();
+    if (toFile)
+    {
+        file.open(options.outputPath, std::ios::out | std::ios::trunc);
+        if (!file)
+        {
+            std::cout << "\033[31mCannot open output file " << options.outputPath << ".\033[0m\n";
+            return 1;
+        }
+    }
+
+    std::atomic<uint64_t> pendingJobs{jobs.size()};
+    batchQueueMetric.set(static_cast<double>(jobs.size()));
+
+    // A summary is itself a parallel pass, so the jobs run one after another
+    if (options.summaries)
+    {
+        std::string text;
+        for (const BatchJob &job : jobs)
+        {
+            batchQueueMetric.set(static_cast<double>(--pendingJobs));
+            text += summaryJson(job.base, job.modulo, summarizeSequence(job.base, job.modulo));
+            text += '\n';
+            ordersMetric.add();
+        }
+        if (!writeBlock(file, toFile, text))
+        {
+            std::cout << "\033[31mWrite failed.\033[0m\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    // Grain of one job: a single large modulus can dominate a whole batch
+    sharedThreadPool().parallelFor(0, jobs.size(), 1, [&](uint64_t begin, uint64_t end, unsigned)
+    {
+        for (uint64_t i = begin; i < end; ++i)
+        {
+            TraceSpan span("order", "batch");
+            batchQueueMetric.set(static_cast<double>(--pendingJobs));
+            jobs[i].shape = computeSequenceShape(jobs[i].base, jobs[i].modulo);
+            ordersMetric.add();
+        }
+    });
+
+    std::string text;
+    {
+        TraceSpan span("format", "batch");
+        for (const BatchJob &job : jobs)
+        {
+            text += job.base.get_str();
+            text += ' ';
+            text += job.modulo.get_str();
+            text += ' ';
+            text += std::to_string(job.shape.tail);
+            text += ' ';
+            text += std::to_string(job.shape.period);
+            text += '\n';
+        }
+    }
+    if (!writeBlock(file, toFile, text))
+    {
+        std::cout << "\033[31mWrite failed.\033[0m\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Time a sweep under static partitioning and under the work-stealing pool for 1..maxThreads threads
+int runPoolBenchmark(const SweepOptions &options, unsigned maxThreads)
+{
+    if (options.first == 0 || options.last < options.first)
+    {
+        std::cout << "\033[31mInvalid benchmark range.\033[0m\n";
+        return 1;
+    }
+
+    uint64_t count = options.last - options.first + 1;
+    std::vector<SequenceShape> results(count);
+    double staticBaseline = 0.0;
+    double stealingBaseline = 0.0;
+    uint64_t expected = 0;
+
+    std::cout << "\nSweep benchmark: base " << options.base << ", moduli " << options.first << ".." << options.last << "\n";
+    std::cout << std::setw(8) << "threads" << std::setw(14) << "static s" << std::setw(10) << "speedup"
+              << std::setw(14) << "stealing s" << std::setw(10) << "speedup" << "\n";
+
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    for (unsigned threads : threadCounts)
+    {
+        auto started = std::chrono::steady_clock::now();
+        sweepStaticPartition(options, results, threads);
+        double staticSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        uint64_t staticChecksum = shapeChecksum(results);
+
+        WorkStealingPool pool(threads);
+        started = std::chrono::steady_clock::now();
+        pool.parallelFor(0, count, sweepGrain, [&](uint64_t begin, uint64_t end, unsigned)
+        {
+            sweepRange(options, results, begin, end);
+        });
+        double stealingSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        uint64_t stealingChecksum = shapeChecksum(results);
+
+        if (threads == 1)
+        {
+            staticBaseline = staticSeconds;
+            stealingBaseline = stealingSeconds;
+            expected = staticChecksum;
+        }
+        if (staticChecksum != expected || stealingChecksum != expected)
+        {
+            std::cout << "\033[31mScheduler results differ at " << threads << " threads.\033[0m\n";
+            return 1;
+        }
+
+        std::cout << std::fixed << std::setprecision(3) << std::setw(8) << threads << std::setw(14) << staticSeconds
+                  << std::setw(9) << staticBaseline / staticSeconds << "x" << std::setw(14) << stealingSeconds
+                  << std::setw(9) << stealingBaseline / stealingSeconds << "x" << "\n"
+                  << std::defaultfloat;
+    }
+    return 0;
+}
+
+// Time a base sweep with each kernel level this CPU supports and check that they agree
+int runSimdBenchmark(const SweepOptions &options)
+{
+    if (options.modulo < 3 || options.modulo >= (1ull << 32) || !(options.modulo & 1) || options.last < options.first)
+    {
+        std::cout << "\033[31mThe vector kernels need an odd --modulo between 3 and 2^32 and a base range.\033[0m\n";
+        return 1;
+    }
+
+    std::vector<uint32_t> units;
+    for (uint64_t base = options.first; base <= options.last; ++base)
+    {
+        uint64_t reduced = base % options.modulo;
+        if (reduced != 0 && gcd64(reduced, options.modulo) == 1)
+            units.push_back(static_cast<uint32_t>(reduced));
+    }
+    if (units.empty())
+    {
+        std::cout << "\033[31mNo bases in the range are units modulo " << options.modulo << ".\033[0m\n";
+        return 1;
+    }
+
+    std::cout << "\nKernel benchmark: modulo " << options.modulo << ", " << units.size() << " unit bases, CPU supports "
+              << simdLevelName(detectSimdLevel()) << "\n";
+    std::cout << std::setw(8) << "kernel" << std::setw(14) << "seconds" << std::setw(16) << "Mmul/s" << std::setw(10) << "speedup" << "\n";
+
+    std::vector<uint64_t> expected(units.size()), orders(units.size());
+    double scalarSeconds = 0.0;
+    for (SimdLevel level : {SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512})
+    {
+        if (level > activeSimdLevel())
+            break;
+        auto started = std::chrono::steady_clock::now();
+        unitOrdersFixedModulus(static_cast<uint32_t>(options.modulo), units.data(), units.size(), orders.data(), level);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        uint64_t multiplications = 0;
+        for (uint64_t order : orders)
+            multiplications += order;
+        if (level == SIMD_SCALAR)
+        {
+            scalarSeconds = seconds;
+            expected = orders;
+        }
+        else if (orders != expected)
+        {
+            std::cout << "\033[31m" << simdLevelName(level) << " results differ from the scalar kernel.\033[0m\n";
+            return 1;
+        }
+
+        std::cout << std::fixed << std::setprecision(3) << std::setw(8) << simdLevelName(level) << std::setw(14) << seconds
+                  << std::setw(16) << multiplications / seconds / 1e6 << std::setw(9) << scalarSeconds / seconds << "x\n"
+                  << std::defaultfloat;
+    }
+    return 0;
+}
+
+// Time the order of options.base over a modulus range: stepping each cycle versus the
+// lambda(n) divisor checks on every kernel level
+int runOrderBenchmark(const SweepOptions &options)
+{
+    if (options.first == 0 || options.last < options.first || options.last >= (1ull << 32))
+    {
+        std::cout << "\033[31mThe order benchmark needs a modulus range below 2^32.\033[0m\n";
+        return 1;
+    }
+
+    std::vector<uint32_t> units;
+    for (uint64_t modulus = options.first; modulus <= options.last; ++modulus)
+    {
+        uint64_t reduced = options.base % modulus;
+        if (modulus >= 3 && reduced > 1 && gcd64(reduced, modulus) == 1)
+            units.push_back(static_cast<uint32_t>(modulus));
+    }
+    if (units.empty())
+    {
+        std::cout << "\033[31mNo moduli in the range have " << options.base << " as a unit.\033[0m\n";
+        return 1;
+    }
+
+    std::cout << "\nOrder benchmark: base " << options.base << ", " << units.size() << " moduli, CPU supports "
+              << simdLevelName(detectSimdLevel()) << "\n";
+    std::cout << std::setw(8) << "method" << std::setw(14) << "seconds" << std::setw(16) << "orders/s" << std::setw(10) << "speedup" << "\n";
+
+    std::vector<uint64_t> expected(units.size()), orders(units.size());
+    auto report = [&](const char *name, double seconds, double baseline)
+    {
+        std::cout << std::fixed << std::setprecision(3) << std::setw(8) << name << std::setw(14) << seconds << std::setw(16)
+                  << std::setprecision(0) << units.size() / seconds << std::setprecision(3) << std::setw(9) << baseline / seconds
+                  << "x\n" << std::defaultfloat;
+    };
+
+    auto started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < units.size(); ++i)
+        expected[i] = computeSequenceShape(options.base, units[i]).period;
+    double steppingSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    report("stepping", steppingSeconds, steppingSeconds);
+
+    for (SimdLevel level : {SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512})
+    {
+        if (level > activeSimdLevel())
+            break;
+        started = std::chrono::steady_clock::now();
+        unitOrdersAcrossModuli(options.base, units.data(), units.size(), orders.data(), level);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        if (orders != expected)
+        {
+            std::cout << "\033[31m" << simdLevelName(level) << " orders differ from stepping.\033[0m\n";
+            return 1;
+        }
+        report(simdLevelName(level), seconds, steppingSeconds);
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "engine.h"
+
+// Non-interactive parallel modes built on the sequence engine; all of them run on
+// sharedThreadPool() (see threadpool.h)
+
+enum SweepAxis
+{
+    SWEEP_MODULI, // Fixed base, one line per modulus
+    SWEEP_BASES   // Fixed modulo, one line per base
+};
+
+// Sequence shape of one fixed base for every modulus in [first, last], or of every base
+// in [first, last] for one fixed modulo
+struct SweepOptions
+{
+    SweepAxis axis = SWEEP_MODULI;
+    uint64_t base = 2;
+    uint64_t modulo = 9;
+    uint64_t first = 1;
+    uint64_t last = 1;
+    std::string outputPath; // Empty = standard output
+    std::string checkpointPath; // Empty = no checkpoints
+    bool resume = false;
+    unsigned checkpointInterval = 30; // Seconds between checkpoints
+};
+
+// Sequence shape for every "base modulo" line of an input file, or with summaries one
+// JSON object of summarizeSequence() statistics per line (see summary.h)
+struct BatchOptions
+{
+    std::string inputPath;
+    std::string outputPath;
+    bool summaries = false;
+};
+
+void computeSweepShapes(uint64_t base, uint64_t firstModulus, std::vector<SequenceShape> &shapes);
+void computeBaseSweepShapes(uint64_t modulo, uint64_t firstBase, std::vector<SequenceShape> &shapes);
+std::string formatSweepLines(uint64_t first, const std::vector<SequenceShape> &shapes);
+
+int runSweep(const SweepOptions &options);
+int runBatch(const BatchOptions &options);
+
+// Compare static partitioning with the work-stealing pool on the sweep workload
+int runPoolBenchmark(const SweepOptions &options, unsigned maxThreads);
+
+// Compare the scalar and vector kernels on a base sweep of options.modulo
+int runSimdBenchmark(const SweepOptions &options);
+
+// Compare stepping with the lambda(n) order kernels on a modulus sweep of options.base
+int runOrderBenchmark(const SweepOptions &options);
+
+#endif
@@ -0,0 +1,192 @@
+#include "threadpool.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <chrono>
+#include <string>
+
+namespace
+{
+    MetricCounter &stealsMetric = metricCounter("sh_pool_steals", "Ranges taken from another worker's deque.");
+    MetricGauge &poolQueueMetric = metricGauge("sh_queue_depth", "Work items waiting to be started.", "queue=\"pool\"");
+
+    unsigned configuredPoolSize = 0;
+
+    // xorshift64 for picking steal victims without shared state
+    uint64_t nextRandom(uint64_t &state)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+}
+
+WorkStealingPool::WorkStealingPool(unsigned threads)
+{
+    if (threads == 0)
+        threads = 1;
+    for (unsigned i = 0; i < threads; ++i)
+        queues.emplace_back(new WorkerQueue());
+    for (unsigned i = 0; i < threads; ++i)
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+    }
+    jobWake.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+// Run body over [begin, end) and wait until every index has been processed
+void WorkStealingPool::parallelFor(uint64_t begin, uint64_t end, uint64_t grainSize, const RangeBody &rangeBody)
+{
+    if (begin >= end)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        body = &rangeBody;
+        grain = grainSize > 0 ? grainSize : 1;
+        {
+            std::lock_guard<std::mutex> queueLock(queues[0]->mutex);
+            queues[0]->ranges.push_back({begin, end});
+        }
+        queuedRanges = 1;
+        remaining = end - begin;
+        ++generation;
+    }
+    jobWake.notify_all();
+
+    std::unique_lock<std::mutex> lock(jobMutex);
+    jobDone.wait(lock, [this]() { return remaining.load() == 0; });
+    body = nullptr;
+}
+
+bool WorkStealingPool::popLocal(unsigned id, Range &range)
+{
+    WorkerQueue &queue = *queues[id];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.ranges.empty())
+        return false;
+    range = queue.ranges.back();
+    queue.ranges.pop_back();
+    poolQueueMetric.set(static_cast<double>(--queuedRanges));
+    return true;
+}
+
+// Try every other worker once, starting from a random victim; take the oldest (largest) range
+bool WorkStealingPool::steal(unsigned id, Range &range, uint64_t &seed)
+{
+    unsigned count = size();
+    unsigned start = static_cast<unsigned>(nextRandom(seed) % count);
+    for (unsigned offset = 0; offset < count; ++offset)
+    {
+        unsigned victim = (start + offset) % count;
+        if (victim == id)
+            continue;
+        WorkerQueue &queue = *queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.ranges.empty())
+            continue;
+        range = queue.ranges.front();
+        queue.ranges.pop_front();
+        poolQueueMetric.set(static_cast<double>(--queuedRanges));
+        stealsMetric.add();
+        return true;
+    }
+    return false;
+}
+
+// Process a range grain by grain, handing off its upper half whenever someone is idle
+void WorkStealingPool::execute(unsigned id, Range range)
+{
+    while (range.first < range.last)
+    {
+        if (range.last - range.first > grain && idleWorkers.load(std::memory_order_relaxed) > 0)
+        {
+            uint64_t middle = range.first + (range.last - range.first) / 2;
+            {
+                std::lock_guard<std::mutex> lock(queues[id]->mutex);
+                queues[id]->ranges.push_back({middle, range.last});
+            }
+            poolQueueMetric.set(static_cast<double>(++queuedRanges));
+            range.last = middle;
+            continue;
+        }
+
+        uint64_t pieceEnd = range.last - range.first > grain ? range.first + grain : range.last;
+        (*body)(range.first, pieceEnd, id);
+        uint64_t done = pieceEnd - range.first;
+        range.first = pieceEnd;
+        if (remaining.fetch_sub(done) == done)
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            jobDone.notify_all();
+        }
+    }
+}
+
+void WorkStealingPool::workerLoop(unsigned id)
+{
+    traceSetThreadName("pool worker " + std::to_string(id));
+    uint64_t seed = 0x9E3779B97F4A7C15ull * (id + 1);
+    uint64_t seenGeneration = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobWake.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+            if (stopping)
+                return;
+            seenGeneration = generation;
+        }
+
+        int failedAttempts = 0;
+        while (remaining.load() > 0)
+        {
+            Range range;
+            if (popLocal(id, range) || steal(id, range, seed))
+            {
+                failedAttempts = 0;
+                execute(id, range);
+                continue;
+            }
+
+            // Advertise idleness so busy workers split their ranges, then back off
+            idleWorkers.fetch_add(1);
+            if (++failedAttempts < 64)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            idleWorkers.fetch_sub(1);
+        }
+    }
+}
+
+void setThreadPoolSize(unsigned threads)
+{
+    configuredPoolSize = threads;
+}
+
+// Number of worker threads to use when the user asked for `requested` (0 = automatic)
+unsigned resolveThreadCount(unsigned requested)
+{
+    if (requested > 0)
+        return requested;
+    unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+// Pool used by all parallel modes, created on first use
+WorkStealingPool &sharedThreadPool()
+{
+    static WorkStealingPool pool(resolveThreadCount(configuredPoolSize));
+    return pool;
+}
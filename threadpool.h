@@ -0,0 +1,73 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing scheduler shared by every parallel mode.
+// Each worker owns a deque of index ranges: it pops from the back of its own deque and
+// steals from the front of a random victim's. A worker splits its current range in half
+// only while another worker is idle, so uniform work runs as a few long ranges and
+// skewed work (one expensive modulus among cheap ones) spreads across all cores.
+
+typedef std::function<void(uint64_t first, uint64_t last, unsigned worker)> RangeBody;
+
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(unsigned threads);
+    ~WorkStealingPool();
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    // Run body over [begin, end) in pieces of at most grain indices; returns when all are done.
+    // Not reentrant: body must not call parallelFor on the same pool.
+    void parallelFor(uint64_t begin, uint64_t end, uint64_t grain, const RangeBody &body);
+
+private:
+    struct Range
+    {
+        uint64_t first;
+        uint64_t last;
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    void workerLoop(unsigned id);
+    bool popLocal(unsigned id, Range &range);
+    bool steal(unsigned id, Range &range, uint64_t &seed);
+    void execute(unsigned id, Range range);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    std::mutex jobMutex;
+    std::condition_variable jobWake;
+    std::condition_variable jobDone;
+    const RangeBody *body = nullptr;
+    uint64_t grain = 1;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    std::atomic<uint64_t> remaining{0};
+    std::atomic<unsigned> idleWorkers{0};
+    std::atomic<uint64_t> queuedRanges{0};
+};
+
+// Thread count for the shared pool (0 = one per hardware thread); call before first use
+void setThreadPoolSize(unsigned threads);
+unsigned resolveThreadCount(unsigned requested);
+WorkStealingPool &sharedThreadPool();
+
+#endif
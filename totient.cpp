@@ -0,0 +1,489 @@
+#include "totient.h"
+#include "metrics.h"
+#include "order.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    const char cacheMagic[] = "SHTOTN1";
+    const uint64_t cacheStride = 4096; // Numbers per entry of the cache's block index
+
+    MetricCounter &totientsMetric = metricCounter("sh_totients", "Totient table entries computed.");
+    MetricCache cacheMetric = metricCache("totient");
+
+    // An odd prime with its inverse mod 2^32: n * inverse is n / prime whenever prime | n,
+    // and prime | n exactly when that product is at most maxQuotient
+    struct PrimeInverse
+    {
+        uint32_t prime;
+        uint32_t inverse;
+        uint32_t maxQuotient;
+    };
+
+    struct OddPower
+    {
+        uint16_t index; // In SieveTables::primes
+        uint8_t exponent;
+    };
+
+    // The odd primes below 2^16 with their inverses, the factorization of every prime - 1
+    // (its power of two, then odd prime powers from factors[first[j]] to factors[first[j + 1]])
+    // and the smallest odd prime of every odd number below 2^16. lambda is then grown by
+    // lcm steps that only multiply: no gcd, no division.
+    struct SieveTables
+    {
+        std::vector<PrimeInverse> primes;
+        std::vector<uint8_t> twos;
+        std::vector<uint32_t> first;
+        std::vector<OddPower> factors;
+        std::vector<uint16_t> smallestFactor;
+    };
+
+    const SieveTables &sieveTables()
+    {
+        static const SieveTables tables = []()
+        {
+            SieveTables built;
+            built.smallestFactor.assign(1 << 16, 0);
+            std::vector<uint8_t> seen(1 << 16, 0);
+            for (uint32_t p : smallPrimes())
+            {
+                if (p == 2)
+                    continue;
+                uint32_t inverse = p; // Newton's iteration doubles the correct low bits each step
+                for (int i = 0; i < 4; ++i)
+                    inverse *= 2 - p * inverse;
+                uint16_t index = static_cast<uint16_t>(built.primes.size());
+                built.primes.push_back(PrimeInverse{p, inverse, UINT32_MAX / p});
+                for (uint32_t v = p; v < (1u << 16); v += 2 * p)
+                {
+                    if (!seen[v])
+                    {
+                        seen[v] = 1;
+                        built.smallestFactor[v] = index;
+                    }
+                }
+            }
+            for (const PrimeInverse &q : built.primes)
+            {
+                uint32_t even = q.prime - 1;
+                unsigned twos = __builtin_ctz(even);
+                built.twos.push_back(static_cast<uint8_t>(twos));
+                built.first.push_back(static_cast<uint32_t>(built.factors.size()));
+                for (uint32_t odd = even >> twos; odd > 1;)
+                {
+                    uint16_t index = built.smallestFactor[odd];
+                    uint8_t exponent = 0;
+                    for (; odd % built.primes[index].prime == 0; odd /= built.primes[index].prime)
+                        ++exponent;
+                    built.factors.push_back(OddPower{index, exponent});
+                }
+            }
+            built.first.push_back(static_cast<uint32_t>(built.factors.size()));
+            return built;
+        }();
+        return tables;
+    }
+
+    // Divide p out of value up to limit times; the number of times it went
+    unsigned divideOut(uint32_t &value, const PrimeInverse &p, unsigned limit)
+    {
+        unsigned count = 0;
+        for (uint32_t next; count < limit && (next = value * p.inverse) <= p.maxQuotient; value = next)
+            ++count;
+        return count;
+    }
+
+    void putVarint(std::string &bytes, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            bytes += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        bytes += static_cast<char>(value);
+    }
+
+    void putU64(std::string &bytes, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+            bytes += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+
+    uint64_t getU64(const char *bytes)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i)
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+        return value;
+    }
+
+    // Cache layout: magic, limit, the offsets of entries 0 .. entries (entry k holds the
+    // numbers from k * cacheStride; the last offset is the end of the data), then the data
+    class TotientCache
+    {
+    public:
+        bool open(const std::string &path)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            file.close();
+            file.clear();
+            offsets.clear();
+            file.open(path, std::ios::in | std::ios::binary);
+            char header[sizeof(cacheMagic) + 8];
+            if (!file || !file.read(header, sizeof(header)) ||
+                std::string(header, sizeof(cacheMagic)) != std::string(cacheMagic, sizeof(cacheMagic)))
+                return false;
+            limit = getU64(header + sizeof(cacheMagic));
+            if (limit > maxTotientLimit)
+                return false;
+            std::string index((limit / cacheStride + 2) * 8, '\0');
+            if (!file.read(&index[0], index.size()))
+                return false;
+            for (size_t k = 0; k < index.size() / 8; ++k)
+                offsets.push_back(getU64(index.data() + 8 * k));
+            for (size_t k = 1; k < offsets.size(); ++k)
+            {
+                if (offsets[k] < offsets[k - 1])
+                    return false;
+            }
+            return true;
+        }
+
+        bool isOpen() const { return !offsets.empty(); }
+
+        bool read(uint64_t first, uint64_t count, uint32_t *phi, uint32_t *lambda)
+        {
+            if (offsets.empty() || count == 0 || first + count - 1 > limit)
+                return false;
+            uint64_t firstEntry = first / cacheStride, lastEntry = (first + count - 1) / cacheStride;
+            std::string bytes(offsets[lastEntry + 1] - offsets[firstEntry], '\0');
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                file.clear();
+                file.seekg(static_cast<std::streamoff>(offsets[firstEntry]));
+                if (!file.read(&bytes[0], bytes.size()))
+                    return false;
+            }
+
+            size_t position = 0;
+            auto varint = [&bytes, &position](uint32_t &value)
+            {
+                value = 0;
+                for (unsigned shift = 0; position < bytes.size() && shift < 35; shift += 7)
+                {
+                    unsigned char byte = static_cast<unsigned char>(bytes[position++]);
+                    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+                    if (!(byte & 0x80))
+                        return true;
+                }
+                return false;
+            };
+            uint64_t end = first + count;
+            for (uint64_t n = firstEntry * cacheStride; n < end; ++n)
+            {
+                uint32_t missing, ratio;
+                if (!varint(missing) || !varint(ratio) || missing > n)
+                    return false;
+                if (n < first)
+                    continue;
+                uint32_t totient = static_cast<uint32_t>(n - missing);
+                if (phi)
+                    phi[n - first] = totient;
+                if (lambda)
+                    lambda[n - first] = ratio ? totient / ratio : 0;
+            }
+            return true;
+        }
+
+    private:
+        std::mutex mutex;
+        std::ifstream file;
+        uint64_t limit = 0;
+        std::vector<uint64_t> offsets;
+    };
+
+    TotientCache &sharedCache()
+    {
+        static TotientCache cache;
+        return cache;
+    }
+
+    // An encoded or formatted block with the offsets of its index entries, waiting for
+    // every earlier block so the output stays in order
+    struct EncodedBlock
+    {
+        std::string bytes;
+        std::vector<uint64_t> marks;
+    };
+
+    struct TableProgress
+    {
+        std::mutex mutex;
+        std::ofstream file;
+        bool toFile = false;
+        bool failed = false;
+        std::map<uint64_t, EncodedBlock> pending;
+        uint64_t flushed = 0;
+        uint64_t written = 0;
+        std::vector<uint64_t> offsets;
+    };
+
+    // Caller holds progress.mutex
+    void flushTablePrefix(TableProgress &progress)
+    {
+        TraceSpan span("write", "io");
+        for (auto found = progress.pending.find(progress.flushed); found != progress.pending.end();
+             found = progress.pending.find(progress.flushed))
+        {
+            const EncodedBlock &block = found->second;
+            for (uint64_t mark : block.marks)
+                progress.offsets.push_back(progress.written + mark);
+            if (progress.toFile)
+                progress.file.write(block.bytes.data(), block.bytes.size());
+            else
+                std::cout << block.bytes;
+            progress.written += block.bytes.size();
+            statAdd(STAT_BYTES_WRITTEN, block.bytes.size());
+            progress.pending.erase(found);
+            ++progress.flushed;
+        }
+        if (progress.toFile ? !progress.file : !std::cout)
+            progress.failed = true;
+    }
+}
+
+void computeTotients(uint64_t first, uint64_t count, uint32_t *phi, uint32_t *lambda)
+{
+    const SieveTables &tables = sieveTables();
+    std::vector<uint32_t> rest(count), phiScratch, lambdaScratch;
+    if (!phi)
+    {
+        phiScratch.resize(count);
+        phi = phiScratch.data();
+    }
+    if (!lambda)
+    {
+        lambdaScratch.resize(count);
+        lambda = lambdaScratch.data();
+    }
+    uint64_t end = first + count;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        rest[i] = static_cast<uint32_t>(first + i);
+        phi[i] = 1;
+        lambda[i] = 1;
+    }
+
+    // lambda(2) = 1 and lambda(4) = 2 like phi, but lambda(2^k) = 2^(k-2) from 8 on
+    for (uint64_t n = std::max<uint64_t>(first + (first & 1), 2); n < end; n += 2)
+    {
+        uint64_t i = n - first;
+        unsigned twos = __builtin_ctz(rest[i]);
+        rest[i] >>= twos;
+        phi[i] = 1u << (twos - 1);
+        lambda[i] = twos >= 3 ? 1u << (twos - 2) : phi[i];
+    }
+
+    // phi(q^k) = lambda(q^k) = q^(k-1) (q - 1) for odd q. lambda so far only has primes
+    // below q, so the lcm takes q^(k-1) whole and whatever part of q - 1 it lacks.
+    for (size_t j = 0; j < tables.primes.size(); ++j)
+    {
+        const PrimeInverse &q = tables.primes[j];
+        if (static_cast<uint64_t>(q.prime) * q.prime >= end)
+            break;
+        unsigned evenTwos = tables.twos[j];
+        uint32_t odd = (q.prime - 1) >> evenTwos;
+        const OddPower *factors = tables.factors.data() + tables.first[j];
+        const OddPower *factorsEnd = tables.factors.data() + tables.first[j + 1];
+        uint64_t n = std::max<uint64_t>((first + q.prime - 1) / q.prime * q.prime, q.prime);
+        for (; n < end; n += q.prime)
+        {
+            uint64_t i = n - first;
+            uint32_t reduced = rest[i] * q.inverse;
+            uint32_t power = 1;
+            for (uint32_t next; (next = reduced * q.inverse) <= q.maxQuotient; reduced = next)
+                power *= q.prime;
+            rest[i] = reduced;
+            phi[i] *= power * (q.prime - 1);
+
+            uint32_t held = lambda[i];
+            unsigned twos = __builtin_ctz(held);
+            uint32_t growth = evenTwos > twos ? power << (evenTwos - twos) : power;
+            if ((held & (held - 1)) == 0)
+            {
+                // No odd prime yet (the first one of n, or only a power of two so far)
+                lambda[i] = held * growth * odd;
+                continue;
+            }
+            for (const OddPower *factor = factors; factor != factorsEnd; ++factor)
+            {
+                const PrimeInverse &r = tables.primes[factor->index];
+                if (factor->exponent == 1)
+                {
+                    growth *= held * r.inverse <= r.maxQuotient ? 1 : r.prime;
+                    continue;
+                }
+                uint32_t remaining = held;
+                for (unsigned e = divideOut(remaining, r, factor->exponent); e < factor->exponent; ++e)
+                    growth *= r.prime;
+            }
+            lambda[i] = held * growth;
+        }
+    }
+
+    // What is left above the square root is a single prime p, and the rest of n is below
+    // 2^16, so is lambda so far: lcm(lambda, p - 1) divides p - 1 by the primes of lambda
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        if (rest[i] <= 1)
+            continue;
+        uint32_t growth = rest[i] - 1;
+        phi[i] *= growth;
+        unsigned twos = __builtin_ctz(lambda[i]);
+        growth >>= std::min<unsigned>(twos, __builtin_ctz(growth));
+        for (uint32_t odd = lambda[i] >> twos; odd > 1;)
+        {
+            const PrimeInverse &r = tables.primes[tables.smallestFactor[odd]];
+            divideOut(growth, r, divideOut(odd, r, 32));
+        }
+        lambda[i] *= growth;
+    }
+    if (first == 0 && count > 0)
+        phi[0] = lambda[0] = 0;
+    totientsMetric.add(count);
+}
+
+void loadTotients(uint64_t first, uint64_t count, uint32_t *phi, uint32_t *lambda)
+{
+    TotientCache &cache = sharedCache();
+    if (cache.read(first, count, phi, lambda))
+    {
+        cacheMetric.hits.add();
+        return;
+    }
+    if (cache.isOpen())
+        cacheMetric.misses.add();
+    computeTotients(first, count, phi, lambda);
+}
+
+void forEachTotientBlock(uint64_t first, uint64_t last, const TotientBlockBody &body)
+{
+    if (first > last)
+        return;
+    uint64_t blocks = last / totientBlockSpan - first / totientBlockSpan + 1;
+    sharedThreadPool().parallelFor(0, blocks, 1, [&](uint64_t begin, uint64_t end, unsigned worker)
+    {
+        std::vector<uint32_t> phi, lambda;
+        for (uint64_t block = begin; block < end; ++block)
+        {
+            TraceSpan span("block", "totient");
+            uint64_t low = std::max(first, (first / totientBlockSpan + block) * totientBlockSpan);
+            uint64_t high = std::min((first / totientBlockSpan + block + 1) * totientBlockSpan, last + 1);
+            phi.resize(high - low);
+            lambda.resize(high - low);
+            computeTotients(low, high - low, phi.data(), lambda.data());
+            body(low, high - low, phi.data(), lambda.data(), worker);
+        }
+    });
+}
+
+int runTotientTable(const TotientOptions &options)
+{
+    if (options.limit == 0 || options.limit > maxTotientLimit)
+    {
+        std::cout << "\033[31mThe table limit must be between 1 and 2^32 - 1.\033[0m\n";
+        return 1;
+    }
+    TableProgress progress;
+    progress.toFile = !options.outputPath.empty();
+    uint64_t entries = options.limit / cacheStride + 1;
+    std::string header(cacheMagic, sizeof(cacheMagic));
+    if (progress.toFile)
+    {
+        progress.file.open(options.outputPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!progress.file)
+        {
+            std::cout << "\033[31mCannot open output file " << options.outputPath << ".\033[0m\n";
+            return 1;
+        }
+        putU64(header, options.limit);
+        header.append((entries + 1) * 8, '\0'); // Index, filled in at the end
+        progress.file.write(header.data(), header.size());
+        progress.written = header.size();
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    uint64_t blocks = options.limit / totientBlockSpan + 1;
+    forEachTotientBlock(0, options.limit, [&](uint64_t first, uint64_t count, const uint32_t *phi, const uint32_t *lambda, unsigned)
+    {
+        EncodedBlock block;
+        if (progress.toFile)
+        {
+            block.bytes.reserve(count * 6);
+            for (uint64_t i = 0; i < count; ++i)
+            {
+                if ((first + i) % cacheStride == 0)
+                    block.marks.push_back(block.bytes.size());
+                putVarint(block.bytes, static_cast<uint32_t>(first + i - phi[i]));
+                putVarint(block.bytes, lambda[i] ? phi[i] / lambda[i] : 0);
+            }
+        }
+        else
+        {
+            block.bytes.reserve(count * 24);
+            for (uint64_t i = first == 0 ? 1 : 0; i < count; ++i)
+            {
+                block.bytes += std::to_string(first + i);
+                block.bytes += ' ';
+                block.bytes += std::to_string(phi[i]);
+                block.bytes += ' ';
+                block.bytes += std::to_string(lambda[i]);
+                block.bytes += '\n';
+            }
+        }
+        std::lock_guard<std::mutex> lock(progress.mutex);
+        progress.pending.emplace(first / totientBlockSpan, std::move(block));
+        flushTablePrefix(progress);
+    });
+
+    if (progress.failed || progress.flushed != blocks)
+    {
+        std::cout << "\033[31mWrite failed.\033[0m\n";
+        return 1;
+    }
+    if (!progress.toFile)
+        return 0;
+
+    std::string index;
+    progress.offsets.push_back(progress.written);
+    for (uint64_t offset : progress.offsets)
+        putU64(index, offset);
+    progress.file.seekp(static_cast<std::streamoff>(sizeof(cacheMagic) + 8));
+    progress.file.write(index.data(), index.size());
+    progress.file.close();
+    if (!progress.file)
+    {
+        std::cout << "\033[31mWrite failed.\033[0m\n";
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "phi and lambda of 0.." << options.limit << " written to " << options.outputPath << " (" << progress.written
+              << " bytes, " << seconds << " s).\n";
+    return 0;
+}
+
+bool useTotientCache(const std::string &path)
+{
+    return sharedCache().open(path);
+}
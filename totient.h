@@ -0,0 +1,51 @@
+#ifndef TOTIENT_H
+#define TOTIENT_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Euler's phi and Carmichael's lambda for every n of a range below 2^32, by a segmented
+// sieve: each block starts with rest = n, every prime up to the square root of the block's
+// end strides over its multiples dividing its power out of rest (exact division by a
+// multiply with the prime's inverse mod 2^32), and whatever rest is left is one last prime.
+// phi is the product and lambda the lcm of the prime powers' values, so nothing is ever
+// factored one number at a time. phi(0) = lambda(0) = 0.
+
+const uint64_t totientBlockSpan = 1 << 16; // Numbers per block (768 KiB of scratch and output)
+
+// phi[i] and lambda[i] for first + i, i < count, first + count <= 2^32. Either output may be
+// null. Runs on the calling thread, so it is safe inside a parallelFor body.
+void computeTotients(uint64_t first, uint64_t count, uint32_t *phi, uint32_t *lambda);
+
+// The same values, read from the cache of useTotientCache() when it covers the range
+void loadTotients(uint64_t first, uint64_t count, uint32_t *phi, uint32_t *lambda);
+
+// Called once per block of [first, last] with the block's first n, its size and its values.
+// Blocks arrive in any order, from any worker.
+typedef std::function<void(uint64_t first, uint64_t count, const uint32_t *phi, const uint32_t *lambda, unsigned worker)>
+    TotientBlockBody;
+
+// Every block of [first, last] (last < 2^32) on the shared thread pool, totientBlockSpan
+// numbers each (the first one ends at the next multiple of the span)
+void forEachTotientBlock(uint64_t first, uint64_t last, const TotientBlockBody &body);
+
+// Tables for 0..limit. With an output path they are written as a cache: a header, a block
+// index, and per n the varints n - phi(n) and phi(n) / lambda(n) (4.8 bytes per n up to
+// 10^8, about 5.7 up to 2^32, against 8 for the raw values); without one they are printed
+// as "n phi lambda" lines from n = 1.
+struct TotientOptions
+{
+    uint64_t limit = 1000000;
+    std::string outputPath; // Empty = standard output, as text
+};
+
+const uint64_t maxTotientLimit = (1ull << 32) - 1;
+
+int runTotientTable(const TotientOptions &options);
+
+// Serve loadTotients() from a cache written by runTotientTable() (false if the file is
+// missing or damaged)
+bool useTotientCache(const std::string &path);
+
+#endif
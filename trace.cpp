@@ -0,0 +1,237 @@
+#include "trace.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<bool> traceEnabled{false};
+
+namespace
+{
+    const size_t ringCapacity = 1 << 14; // Events per thread between drains (power of two)
+
+    struct TraceEvent
+    {
+        const char *name;
+        const char *category;
+        uint64_t startNanos;
+        uint64_t endNanos;
+    };
+
+    // Single-producer/single-consumer ring: the owning thread advances head, the
+    // flusher advances tail. Events that arrive while the ring is full are dropped.
+    struct TraceRing
+    {
+        TraceEvent events[ringCapacity];
+        std::atomic<uint64_t> head{0};
+        std::atomic<uint64_t> tail{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<bool> retired{false};
+        uint32_t tid = 0;
+    };
+
+    std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+    std::mutex ringsMutex;
+    std::vector<std::shared_ptr<TraceRing>> rings;
+    uint32_t nextTid = 1;
+    uint64_t retiredDropped = 0;
+
+    std::mutex outputMutex;
+    std::ofstream output;
+    bool firstEvent = true;
+
+    std::mutex flusherMutex;
+    std::condition_variable flusherWake;
+    std::thread flusherThread;
+    bool flusherStop = false;
+
+    // Keeps the calling thread's ring registered; marks it retired when the thread exits
+    struct TraceRingHolder
+    {
+        std::shared_ptr<TraceRing> ring = std::make_shared<TraceRing>();
+
+        TraceRingHolder()
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            ring->tid = nextTid++;
+            rings.push_back(ring);
+        }
+
+        ~TraceRingHolder()
+        {
+            ring->retired.store(true, std::memory_order_release);
+        }
+    };
+
+    TraceRing &threadRing()
+    {
+        thread_local TraceRingHolder holder;
+        return *holder.ring;
+    }
+
+    void writeEventSeparator()
+    {
+        output << (firstEvent ? "\n" : ",\n");
+        firstEvent = false;
+    }
+
+    // Minimal JSON string escaping for thread names
+    std::string jsonEscape(const std::string &text)
+    {
+        std::string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            if (static_cast<unsigned char>(c) >= 0x20)
+                escaped += c;
+        }
+        return escaped;
+    }
+
+    // Move every pending event from every ring into the output file
+    void drainRings()
+    {
+        std::vector<std::shared_ptr<TraceRing>> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            snapshot = rings;
+        }
+
+        std::lock_guard<std::mutex> lock(outputMutex);
+        if (!output.is_open())
+            return;
+
+        for (const std::shared_ptr<TraceRing> &ring : snapshot)
+        {
+            bool retired = ring->retired.load(std::memory_order_acquire);
+            uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail)
+            {
+                const TraceEvent &event = ring->events[tail & (ringCapacity - 1)];
+                writeEventSeparator();
+                output << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+                       << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->tid
+                       << ",\"ts\":" << event.startNanos / 1000 << "." << (event.startNanos % 1000) / 100
+                       << ",\"dur\":" << (event.endNanos - event.startNanos) / 1000 << "."
+                       << ((event.endNanos - event.startNanos) % 1000) / 100 << "}";
+            }
+            ring->tail.store(tail, std::memory_order_release);
+
+            if (retired)
+            {
+                std::lock_guard<std::mutex> ringsLock(ringsMutex);
+                retiredDropped += ring->dropped.load(std::memory_order_relaxed);
+                for (size_t i = 0; i < rings.size(); ++i)
+                {
+                    if (rings[i] == ring)
+                    {
+                        rings.erase(rings.begin() + i);
+                        break;
+                    }
+                }
+            }
+        }
+        output.flush();
+    }
+
+    void flusherLoop()
+    {
+        std::unique_lock<std::mutex> lock(flusherMutex);
+        while (!flusherStop)
+        {
+            flusherWake.wait_for(lock, std::chrono::milliseconds(100));
+            lock.unlock();
+            drainRings();
+            lock.lock();
+        }
+    }
+}
+
+// Nanoseconds since the trace epoch on the steady clock
+uint64_t traceNowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+// Append one completed span to the calling thread's ring
+void traceRecord(const char *name, const char *category, uint64_t startNanos, uint64_t endNanos)
+{
+    TraceRing &ring = threadRing();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= ringCapacity)
+    {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring.events[head & (ringCapacity - 1)] = {name, category, startNanos, endNanos};
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+// Label the calling thread in the trace viewer
+void traceSetThreadName(const std::string &name)
+{
+    if (!traceEnabled.load(std::memory_order_relaxed))
+        return;
+    TraceRing &ring = threadRing();
+    std::lock_guard<std::mutex> lock(outputMutex);
+    if (!output.is_open())
+        return;
+    writeEventSeparator();
+    output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring.tid
+           << ",\"args\":{\"name\":\"" << jsonEscape(name) << "\"}}";
+}
+
+// Open the trace file and start recording spans
+bool startTracing(const std::string &path)
+{
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        if (output.is_open())
+            return false;
+        output.open(path, std::ios::out | std::ios::trunc);
+        if (!output)
+            return false;
+        output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        firstEvent = true;
+    }
+
+    flusherStop = false;
+    flusherThread = std::thread(flusherLoop);
+    traceEnabled = true;
+    traceSetThreadName("main");
+    return true;
+}
+
+// Stop recording, drain all rings and close the trace file
+void stopTracing()
+{
+    if (!traceEnabled.exchange(false))
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(flusherMutex);
+        flusherStop = true;
+    }
+    flusherWake.notify_all();
+    flusherThread.join();
+    drainRings();
+
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        dropped = retiredDropped;
+        for (const std::shared_ptr<TraceRing> &ring : rings)
+            dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(outputMutex);
+    output << "\n],\"otherData\":{\"dropped_events\":" << dropped << "}}\n";
+    output.close();
+}
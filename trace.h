@@ -0,0 +1,46 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Span tracing in the Chrome trace event format (open the file in chrome://tracing or
+// ui.perfetto.dev). Each thread records into its own single-producer ring buffer; a
+// background thread drains the rings into the output file. Nothing is recorded unless
+// startTracing() succeeded, so spans cost one relaxed load when tracing is off.
+
+extern std::atomic<bool> traceEnabled;
+
+bool startTracing(const std::string &path);
+void stopTracing();
+void traceSetThreadName(const std::string &name);
+uint64_t traceNowNanos();
+void traceRecord(const char *name, const char *category, uint64_t startNanos, uint64_t endNanos);
+
+// Records a complete ("X") event covering its own lifetime. name and category must be
+// string literals (or otherwise outlive the trace session).
+class TraceSpan
+{
+public:
+    TraceSpan(const char *name, const char *category)
+        : name(name), category(category), active(traceEnabled.load(std::memory_order_relaxed))
+    {
+        if (active)
+            startNanos = traceNowNanos();
+    }
+
+    ~TraceSpan()
+    {
+        if (active)
+            traceRecord(name, category, startNanos, traceNowNanos());
+    }
+
+private:
+    const char *name;
+    const char *category;
+    bool active;
+    uint64_t startNanos = 0;
+};
+
+#endif
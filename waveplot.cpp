@@ -0,0 +1,204 @@
+#include "waveplot.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+
+namespace
+{
+    const uint64_t parallelThreshold = 1 << 16; // Levels shorter than this are built on the calling thread
+    const uint64_t buildGrain = 1 << 14;
+
+    // Run body over [0, count) on the shared pool when count is large enough to pay for it
+    template <class Body>
+    void forEachIndex(uint64_t count, Body body)
+    {
+        if (count < parallelThreshold)
+        {
+            body(0, count);
+            return;
+        }
+        sharedThreadPool().parallelFor(0, count, buildGrain, [&body](uint64_t first, uint64_t last, unsigned)
+        {
+            body(first, last);
+        });
+    }
+
+    // Row (0 = top) of a scaled value on a plot height rows tall
+    int rowOf(float value, int height)
+    {
+        int row = height - 1 - static_cast<int>(value * static_cast<float>(height));
+        return std::min(std::max(row, 0), height - 1);
+    }
+
+    // Call draw(x, top, bottom, high) with the vertical extent (and top value) of the terms
+    // under each of width pixel columns. When the window holds fewer terms than there are columns, neighbouring
+    // columns repeat a term.
+    template <class Draw>
+    void traceColumns(const WavePyramid &pyramid, const WaveView &view, int width, int height, Draw draw)
+    {
+        if (pyramid.size() == 0 || view.span == 0)
+            return;
+        uint64_t columns = static_cast<uint64_t>(width);
+        for (uint64_t column = 0; column < columns; ++column)
+        {
+            uint64_t first = view.first + column * view.span / columns;
+            uint64_t last = view.first + (column + 1) * view.span / columns;
+            if (last <= first)
+                last = first + 1;
+
+            float low, high;
+            pyramid.range(first, last, low, high);
+            draw(static_cast<int>(column), rowOf(high, height), rowOf(low, height), high);
+        }
+    }
+}
+
+// Values are divided by the modulus in double precision; wider moduli drop their low bits
+// first so the quotient never overflows a double
+void WavePyramid::build(const std::vector<mpz_class> &terms, const mpz_class &modulo)
+{
+    TraceSpan span("build pyramid", "render");
+    size_t bits = mpz_sizeinbase(modulo.get_mpz_t(), 2);
+    size_t shift = bits > 53 ? bits - 53 : 0;
+    mpz_class divisorScaled = modulo >> shift;
+    double divisor = divisorScaled.get_d();
+
+    values.resize(terms.size());
+    forEachIndex(terms.size(), [&](uint64_t first, uint64_t last)
+    {
+        mpz_class scaled;
+        for (uint64_t i = first; i < last; ++i)
+        {
+            if (shift)
+            {
+                mpz_fdiv_q_2exp(scaled.get_mpz_t(), terms[i].get_mpz_t(), shift);
+                values[i] = static_cast<float>(scaled.get_d() / divisor);
+            }
+            else
+                values[i] = static_cast<float>(terms[i].get_d() / divisor);
+        }
+    });
+
+    // Block j of a level combines blocks 2j and 2j + 1 below it; an odd last block is copied up
+    mins.clear();
+    maxs.clear();
+    for (uint64_t belowCount = values.size(); belowCount > 1; belowCount = (belowCount + 1) / 2)
+    {
+        mins.emplace_back((belowCount + 1) / 2);
+        maxs.emplace_back((belowCount + 1) / 2);
+        size_t level = mins.size();
+        const std::vector<float> &belowMins = level > 1 ? mins[level - 2] : values;
+        const std::vector<float> &belowMaxs = level > 1 ? maxs[level - 2] : values;
+        std::vector<float> &levelMins = mins.back(), &levelMaxs = maxs.back();
+        forEachIndex(levelMins.size(), [&](uint64_t first, uint64_t last)
+        {
+            for (uint64_t j = first; j < last; ++j)
+            {
+                uint64_t left = 2 * j, right = std::min(2 * j + 1, belowCount - 1);
+                levelMins[j] = std::min(belowMins[left], belowMins[right]);
+                levelMaxs[j] = std::max(belowMaxs[left], belowMaxs[right]);
+            }
+        });
+    }
+}
+
+// Bottom-up decomposition: at each level take the unpaired block at either end, then move
+// up with the remaining range halved (two blocks per level at most)
+void WavePyramid::range(uint64_t first, uint64_t last, float &low, float &high) const
+{
+    low = 1.0f;
+    high = 0.0f;
+    for (size_t level = 0; first < last; ++level, first >>= 1, last >>= 1)
+    {
+        const std::vector<float> &levelMins = level ? mins[level - 1] : values;
+        const std::vector<float> &levelMaxs = level ? maxs[level - 1] : values;
+        if (first & 1)
+        {
+            low = std::min(low, levelMins[first]);
+            high = std::max(high, levelMaxs[first]);
+            ++first;
+        }
+        if (last & 1)
+        {
+            --last;
+            low = std::min(low, levelMins[last]);
+            high = std::max(high, levelMaxs[last]);
+        }
+    }
+}
+
+void clampWaveView(WaveView &view, uint64_t terms)
+{
+    if (terms == 0)
+    {
+        view.first = view.span = 0;
+        return;
+    }
+    view.span = std::min(std::max<uint64_t>(view.span, 1), terms);
+    view.first = std::min(view.first, terms - view.span);
+}
+
+const char *waveStyleName(WaveStyle style)
+{
+    switch (style)
+    {
+    case WAVE_CELLS:
+        return "cells";
+    case WAVE_BRAILLE:
+        return "braille";
+    default:
+        return "half-block";
+    }
+}
+
+void WaveRenderer::render(const WavePyramid &pyramid, const WaveView &view, WaveStyle style, int width, int height, std::string &out)
+{
+    TraceSpan span("compose wave", "render");
+    out.clear();
+    out += "\033[H\033[2J"; // Home and clear, so the frame replaces the previous one in place
+    out += "Terms ";
+    out += std::to_string(pyramid.size() ? view.first + 1 : 0);
+    out += "-";
+    out += std::to_string(view.first + view.span);
+    out += " of ";
+    out += std::to_string(pyramid.size());
+    out += " (";
+    out += waveStyleName(style);
+    out += ")\n";
+
+    switch (style)
+    {
+    case WAVE_CELLS:
+        cells.assign(static_cast<size_t>(width) * height, ' ');
+        traceColumns(pyramid, view, width, height, [&](int x, int top, int bottom, float)
+        {
+            for (int row = top; row <= bottom; ++row)
+                cells[static_cast<size_t>(row) * width + x] = '#';
+        });
+        for (int row = 0; row < height; ++row)
+        {
+            out += "\033[32m";
+            out.append(cells.data() + static_cast<size_t>(row) * width, width);
+            out += "\033[0m\n";
+        }
+        break;
+    case WAVE_BRAILLE:
+        braille.resize(width, height);
+        traceColumns(pyramid, view, braille.width(), braille.height(), [&](int x, int top, int bottom, float)
+        {
+            braille.verticalLine(x, top, bottom);
+        });
+        braille.encode(out, "\033[32m");
+        break;
+    default:
+        halfBlock.resize(width, height, 16);
+        traceColumns(pyramid, view, halfBlock.width(), halfBlock.height(), [&](int x, int top, int bottom, float high)
+        {
+            halfBlock.verticalLine(x, top, bottom, heatColour(high));
+        });
+        halfBlock.encode(out);
+        break;
+    }
+    out += "[a/d] pan  [w/s] zoom in/out  [r] whole sequence  [m] style  [q] back to menu\n";
+}
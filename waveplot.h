@@ -0,0 +1,68 @@
+#ifndef WAVEPLOT_H
+#define WAVEPLOT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <gmpxx.h>
+#include "raster.h"
+
+// Terminal wave plot of term value against index. Term values are scaled to [0, 1) by the
+// modulus and summarized in a min/max pyramid: level k holds the minimum and maximum of
+// every block of 2^k terms. A screen column covering any run of terms is answered from a
+// handful of blocks, so a frame costs O(width * log(terms per column)) whatever the zoom,
+// and panning across a 10^8-term cycle never touches the terms themselves.
+
+class WavePyramid
+{
+public:
+    // Rebuild from the terms (on the shared thread pool for long sequences)
+    void build(const std::vector<mpz_class> &terms, const mpz_class &modulo);
+
+    uint64_t size() const { return values.size(); }
+
+    // Minimum and maximum scaled value of terms [first, last); first < last <= size()
+    void range(uint64_t first, uint64_t last, float &low, float &high) const;
+
+private:
+    std::vector<float> values;            // Level 0: one value per term
+    std::vector<std::vector<float>> mins; // mins[k - 1], maxs[k - 1]: blocks of 2^k terms
+    std::vector<std::vector<float>> maxs;
+};
+
+// Visible window: span terms starting at index first (0-based)
+struct WaveView
+{
+    uint64_t first = 0;
+    uint64_t span = 0;
+};
+
+// Keep the window inside the sequence and at least one term wide
+void clampWaveView(WaveView &view, uint64_t terms);
+
+// Character cells ('#'), Braille dots (2 x 4 per cell) or coloured half blocks (1 x 2 per
+// cell, coloured by value)
+enum WaveStyle
+{
+    WAVE_CELLS,
+    WAVE_BRAILLE,
+    WAVE_HALF_BLOCK,
+    WAVE_STYLE_COUNT
+};
+
+const char *waveStyleName(WaveStyle style);
+
+// Composes frames into framebuffers kept between calls, so steady-state frames allocate nothing
+class WaveRenderer
+{
+public:
+    // A plot of width x height cells plus a header and a key line
+    void render(const WavePyramid &pyramid, const WaveView &view, WaveStyle style, int width, int height, std::string &out);
+
+private:
+    std::vector<char> cells;
+    BrailleCanvas braille;
+    HalfBlockCanvas halfBlock;
+};
+
+#endif
@@ -0,0 +1,293 @@
+#include "wieferich.h"
+#include "checkpoint.h"
+#include "metrics.h"
+#include "modarith.h"
+#include "sieve.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+namespace
+{
+    MetricCounter &primesMetric = metricCounter("sh_wieferich_primes", "Primes checked by the Wieferich search.");
+
+    // Primes of one segment by how close their quotient comes to 0: nearer[k] counts those with
+    // 10^-(k+1) < |q / p| <= 10^-k
+    struct SegmentResult
+    {
+        std::string text;
+        uint64_t primes = 0;
+        uint64_t hits = 0;
+        uint64_t nearer[maxNearMissDigits + 1] = {};
+    };
+
+    // base^exponent mod the modulus of arithmetic, for a base below 2^64
+    template <class Arithmetic, class Value>
+    Value power(const Arithmetic &arithmetic, Value base, uint64_t exponent)
+    {
+        Value result = arithmetic.one, square = arithmetic.convertIn(base);
+        for (; exponent; exponent >>= 1)
+        {
+            if (exponent & 1)
+                result = arithmetic.multiply(result, square);
+            square = arithmetic.multiply(square, square);
+        }
+        return arithmetic.convertOut(result);
+    }
+
+    // Fermat quotient (base^(p - 1) - 1) / p mod p of a prime p that does not divide base. The
+    // division is exact, so it is a multiply by p^-1 = p (p^2)^-1, and the Montgomery kernel
+    // already holds (p^2)^-1 mod R.
+    uint64_t fermatQuotient(uint64_t base, uint64_t p)
+    {
+        if (p == 2)
+            return (base % 4 - 1) / 2;
+        if (p < (1ull << 32))
+        {
+            Montgomery64 arithmetic(p * p);
+            uint64_t residue = power(arithmetic, base % (p * p), p - 1);
+            return (residue - 1) * p * arithmetic.inverse;
+        }
+        Montgomery128 arithmetic(static_cast<Montgomery128::Value>(p) * p);
+        Montgomery128::Value residue = power(arithmetic, static_cast<Montgomery128::Value>(base), p - 1);
+        return static_cast<uint64_t>((residue - 1) * p * arithmetic.inverse);
+    }
+
+    void searchSegment(const WieferichOptions &options, const std::vector<uint64_t> &primes, SegmentResult &result)
+    {
+        for (uint64_t p : primes)
+        {
+            if (options.base % p == 0)
+                continue;
+            ++result.primes;
+            uint64_t quotient = fermatQuotient(options.base, p);
+            uint64_t distance = quotient <= p / 2 ? quotient : p - quotient;
+            unsigned digits = maxNearMissDigits + 1;
+            if (distance == 0)
+                ++result.hits;
+            else
+            {
+                digits = 0;
+                for (uint64_t scaled = distance; scaled * 10 <= p; scaled *= 10)
+                    ++digits;
+                ++result.nearer[digits];
+            }
+            if (digits >= options.nearMissDigits)
+            {
+                result.text += std::to_string(p);
+                result.text += quotient <= p / 2 ? " " : " -";
+                result.text += std::to_string(distance);
+                result.text += '\n';
+            }
+        }
+        primesMetric.add(primes.size());
+    }
+
+    // Finished segments waiting for every earlier one, so the stream stays in order
+    struct WieferichProgress
+    {
+        std::mutex mutex;
+        std::ofstream file;
+        bool toFile = false;
+        bool failed = false;
+        std::map<uint64_t, SegmentResult> pending;
+        uint64_t flushed = 0;
+        uint64_t outputBytes = 0;
+        uint64_t primes = 0;
+        uint64_t hits = 0;
+        uint64_t nearer[maxNearMissDigits + 1] = {};
+        std::chrono::steady_clock::time_point lastCheckpoint;
+    };
+
+    bool writeText(WieferichProgress &progress, const std::string &text)
+    {
+        TraceSpan span("write", "io");
+        if (progress.toFile)
+            progress.file << text;
+        else
+            std::cout << text;
+        progress.outputBytes += text.size();
+        statAdd(STAT_BYTES_WRITTEN, text.size());
+        return progress.toFile ? static_cast<bool>(progress.file) : static_cast<bool>(std::cout);
+    }
+
+    // Caller holds progress.mutex
+    void flushWieferichPrefix(WieferichProgress &progress)
+    {
+        std::string text;
+        for (auto found = progress.pending.find(progress.flushed); found != progress.pending.end();
+             found = progress.pending.find(progress.flushed))
+        {
+            const SegmentResult &result = found->second;
+            text += result.text;
+            progress.primes += result.primes;
+            progress.hits += result.hits;
+            for (unsigned k = 0; k <= maxNearMissDigits; ++k)
+                progress.nearer[k] += result.nearer[k];
+            progress.pending.erase(found);
+            ++progress.flushed;
+        }
+        if (!text.empty() && !writeText(progress, text))
+            progress.failed = true;
+    }
+
+    // Closing "#" lines: the totals, then the cumulative near-miss counts down to the deepest
+    // one seen (at least the listing threshold)
+    std::string formatSummary(const WieferichOptions &options, const WieferichProgress &progress)
+    {
+        std::string text = "# " + std::to_string(progress.primes) + " primes in [" + std::to_string(options.first) + ", " +
+                           std::to_string(options.last) + "] not dividing " + std::to_string(options.base) + ", " +
+                           std::to_string(progress.hits) + " Wieferich primes\n";
+        unsigned deepest = options.nearMissDigits;
+        for (unsigned k = 0; k <= maxNearMissDigits; ++k)
+        {
+            if (progress.nearer[k] != 0)
+                deepest = std::max(deepest, k);
+        }
+        uint64_t within = progress.hits;
+        for (unsigned k = maxNearMissDigits; k > deepest; --k)
+            within += progress.nearer[k];
+        std::string lines;
+        for (unsigned k = deepest; k >= 1; --k)
+        {
+            within += progress.nearer[k];
+            double expected = 2.0 * static_cast<double>(progress.primes) * std::pow(10.0, -static_cast<double>(k));
+            lines = "# |q/p| <= 1e-" + std::to_string(k) + ": " + std::to_string(within) + " primes (expected " +
+                    std::to_string(expected) + ")\n" + lines;
+        }
+        return text + lines;
+    }
+
+    // Checkpoint layout: the search parameters, then the written prefix (segments and bytes)
+    // with its totals. Segments finished beyond the prefix are cheap, so they are recomputed.
+    void saveWieferichCheckpoint(const WieferichOptions &options, WieferichProgress &progress)
+    {
+        TraceSpan span("checkpoint", "io");
+        progress.file.flush();
+
+        CheckpointWriter writer("wieferich");
+        writer.putU64(options.base);
+        writer.putU64(options.first);
+        writer.putU64(options.last);
+        writer.putU64(options.nearMissDigits);
+        writer.putU64(sieveSegmentSpan);
+        writer.putU64(progress.flushed);
+        writer.putU64(progress.outputBytes);
+        writer.putU64(progress.primes);
+        writer.putU64(progress.hits);
+        for (uint64_t count : progress.nearer)
+            writer.putU64(count);
+        if (!writer.commit(options.checkpointPath))
+            std::cout << "\033[31mCannot write checkpoint " << options.checkpointPath << ".\033[0m\n";
+    }
+
+    bool loadWieferichCheckpoint(const WieferichOptions &options, WieferichProgress &progress)
+    {
+        CheckpointReader reader;
+        uint64_t base, first, last, digits, span;
+        if (!reader.open(options.checkpointPath, "wieferich") || !reader.getU64(base) || !reader.getU64(first) ||
+            !reader.getU64(last) || !reader.getU64(digits) || !reader.getU64(span) || !reader.getU64(progress.flushed) ||
+            !reader.getU64(progress.outputBytes) || !reader.getU64(progress.primes) || !reader.getU64(progress.hits))
+            return false;
+        for (uint64_t &count : progress.nearer)
+        {
+            if (!reader.getU64(count))
+                return false;
+        }
+        return base == options.base && first == options.first && last == options.last && digits == options.nearMissDigits &&
+               span == sieveSegmentSpan;
+    }
+}
+
+int runWieferichSearch(const WieferichOptions &options)
+{
+    if (options.first < 2 || options.first > options.last || options.last > maxWieferichLimit)
+    {
+        std::cout << "\033[31mThe search range must satisfy 2 <= FIRST <= LAST <= 2^50.\033[0m\n";
+        return 1;
+    }
+    if (options.base < 2 || options.nearMissDigits == 0 || options.nearMissDigits > maxNearMissDigits)
+    {
+        std::cout << "\033[31mThe Wieferich search needs a base of at least 2 and 1 to 15 near-miss digits.\033[0m\n";
+        return 1;
+    }
+    bool checkpointing = !options.checkpointPath.empty();
+    if ((checkpointing || options.resume) && options.outputPath.empty())
+    {
+        std::cout << "\033[31mCheckpointing a Wieferich search requires --output.\033[0m\n";
+        return 1;
+    }
+
+    uint64_t segments = (options.last - options.first) / sieveSegmentSpan + 1;
+    WieferichProgress progress;
+    progress.lastCheckpoint = std::chrono::steady_clock::now();
+    if (options.resume)
+    {
+        if (!loadWieferichCheckpoint(options, progress) || progress.flushed > segments ||
+            !truncateOutput(options.outputPath, progress.outputBytes))
+        {
+            std::cout << "\033[31mCannot resume from " << options.checkpointPath
+                      << " (missing, damaged, or written for a different search).\033[0m\n";
+            return 1;
+        }
+        std::cout << "Resuming Wieferich search at segment " << progress.flushed << " of " << segments << ".\n";
+    }
+
+    progress.toFile = !options.outputPath.empty();
+    if (progress.toFile)
+    {
+        progress.file.open(options.outputPath, std::ios::out | std::ios::binary | (options.resume ? std::ios::app : std::ios::trunc));
+        if (!progress.file)
+        {
+            std::cout << "\033[31mCannot open output file " << options.outputPath << ".\033[0m\n";
+            return 1;
+        }
+    }
+
+    // Resuming sieves from the first segment after the written prefix; its index is the offset
+    uint64_t resumed = progress.flushed;
+    if (resumed < segments)
+    {
+        PrimeSieve sieve(options.last);
+        sieve.forEachSegment(options.first + resumed * sieveSegmentSpan, options.last,
+                             [&](uint64_t segment, const std::vector<uint64_t> &primes, unsigned)
+        {
+            TraceSpan span("segment", "wieferich");
+            SegmentResult result;
+            searchSegment(options, primes, result);
+
+            std::lock_guard<std::mutex> lock(progress.mutex);
+            progress.pending.emplace(resumed + segment, std::move(result));
+            flushWieferichPrefix(progress);
+            if (checkpointing && std::chrono::steady_clock::now() - progress.lastCheckpoint >= std::chrono::seconds(options.checkpointInterval))
+            {
+                saveWieferichCheckpoint(options, progress);
+                progress.lastCheckpoint = std::chrono::steady_clock::now();
+            }
+        });
+    }
+
+    if (progress.flushed != segments || !writeText(progress, formatSummary(options, progress)) || progress.failed)
+    {
+        std::cout << "\033[31mWrite failed.\033[0m\n";
+        return 1;
+    }
+    if (progress.toFile)
+    {
+        progress.file.close();
+        std::cout << progress.hits << " Wieferich primes to base " << options.base << " among " << progress.primes
+                  << " primes in [" << options.first << ", " << options.last << "].\n";
+    }
+    if (checkpointing)
+        std::remove(options.checkpointPath.c_str());
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef WIEFERICH_H
+#define WIEFERICH_H
+
+#include <cstdint>
+#include <string>
+
+// Primes p of [first, last] with base^(p - 1) == 1 (mod p^2), the Wieferich primes to base,
+// together with how close every other prime comes. For each prime of the segmented sieve
+// (see sieve.h) the Fermat quotient q = (base^(p - 1) - 1) / p mod p is computed with
+// Montgomery arithmetic mod p^2, 64-bit below 2^32 and the 128-bit kernel above; it is
+// taken in (-p/2, p/2], and a prime is a hit when q = 0 and a near miss when
+// |q / p| <= 10^-nearMissDigits. Hits and near misses are streamed in order as "p q" lines;
+// "#" lines at the end give the number of primes with |q / p| <= 10^-k for every k next to
+// the 2 10^-k primes a uniformly distributed quotient would give. Primes dividing base are
+// skipped.
+struct WieferichOptions
+{
+    uint64_t base = 2;
+    uint64_t first = 2;
+    uint64_t last = 1000000;
+    unsigned nearMissDigits = 4;
+    std::string outputPath;     // Empty = standard output
+    std::string checkpointPath; // Empty = no checkpoints
+    bool resume = false;
+    unsigned checkpointInterval = 30; // Seconds between checkpoints
+};
+
+const uint64_t maxWieferichLimit = 1ull << 50;
+const unsigned maxNearMissDigits = 15; // Any |q / p| of a prime below 2^50 is above 10^-16
+
+int runWieferichSearch(const WieferichOptions &options);
+
+#endif